@@ -0,0 +1,62 @@
+#include "background_executor.h"
+
+#include <stdexcept>
+#include <utility>
+
+namespace tskv {
+
+BackgroundExecutor::BackgroundExecutor(size_t threads_num) {
+  if (threads_num == 0) {
+    throw std::runtime_error("Executor should have at least one thread");
+  }
+  threads_.reserve(threads_num);
+  for (size_t i = 0; i < threads_num; ++i) {
+    threads_.emplace_back([this] { Run(); });
+  }
+}
+
+BackgroundExecutor::~BackgroundExecutor() {
+  {
+    std::lock_guard lock(mutex_);
+    stopped_ = true;
+  }
+  has_tasks_.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+void BackgroundExecutor::Submit(Task task) {
+  {
+    std::lock_guard lock(mutex_);
+    tasks_.push_back(std::move(task));
+  }
+  has_tasks_.notify_one();
+}
+
+void BackgroundExecutor::Wait() {
+  std::unique_lock lock(mutex_);
+  idle_.wait(lock, [this] { return tasks_.empty() && running_ == 0; });
+}
+
+void BackgroundExecutor::Run() {
+  std::unique_lock lock(mutex_);
+  while (true) {
+    has_tasks_.wait(lock, [this] { return stopped_ || !tasks_.empty(); });
+    if (tasks_.empty()) {
+      return;
+    }
+    auto task = std::move(tasks_.front());
+    tasks_.pop_front();
+    ++running_;
+    lock.unlock();
+    task();
+    lock.lock();
+    --running_;
+    if (tasks_.empty() && running_ == 0) {
+      idle_.notify_all();
+    }
+  }
+}
+
+}  // namespace tskv
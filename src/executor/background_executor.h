@@ -0,0 +1,43 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tskv {
+
+// Fixed pool of threads running submitted tasks in submission order. Tasks
+// left in the queue are still run on destruction. Tasks must not throw.
+class BackgroundExecutor {
+ public:
+  using Task = std::function<void()>;
+
+ public:
+  explicit BackgroundExecutor(size_t threads_num = 1);
+  ~BackgroundExecutor();
+
+  BackgroundExecutor(const BackgroundExecutor&) = delete;
+  BackgroundExecutor& operator=(const BackgroundExecutor&) = delete;
+
+  void Submit(Task task);
+  // waits until all submitted tasks are finished
+  void Wait();
+
+ private:
+  void Run();
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable has_tasks_;
+  std::condition_variable idle_;
+  std::deque<Task> tasks_;
+  size_t running_{0};
+  bool stopped_{false};
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace tskv
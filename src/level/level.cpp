@@ -11,120 +11,623 @@
 namespace tskv {
 
 Level::Level(const Options& options,
-             std::shared_ptr<IPersistentStorage> storage)
-    : options_(options), storage_(std::move(storage)) {}
+             std::shared_ptr<IPersistentStorage> storage,
+             std::shared_ptr<PageCache> page_cache)
+    : options_(options),
+      storage_(std::move(storage)),
+      page_cache_(std::move(page_cache)) {}
+
+namespace {
+
+TimeRange GetColumnTimeRange(const SerializableColumn& column) {
+  if (column->GetType() == ColumnType::kRawTimestamps) {
+    return std::static_pointer_cast<RawTimestampsColumn>(column)
+        ->GetTimeRange();
+  }
+  if (auto read_column = std::dynamic_pointer_cast<IReadColumn>(column)) {
+    return read_column->GetTimeRange();
+  }
+  return {};
+}
+
+}  // namespace
 
 Column Level::Read(const TimeRange& time_range,
-                   StoredAggregationType aggregation_type) const {
-  if (page_ids_.empty()) {
-    return {};
+                   StoredAggregationType aggregation_type,
+                   const DecodedPages& decoded_pages) const {
+  auto column_type = ToColumnType(aggregation_type);
+  if (column_type == ColumnType::kRawRead) {
+    return MergeUnordered(ReadRawValues(time_range, decoded_pages),
+                          ReadLateRawValues(time_range, decoded_pages));
   }
+
+  ReadColumn result;
+  // segments of consecutive writes are stitched together
+  for (const auto& page : FindPages(column_type, time_range)) {
+    ReadColumn column;
+    if (!decoded_pages.contains(page.page_id) &&
+        NeedRangedRead(page, time_range)) {
+      column = ReadAggregateRange(page, time_range);
+    } else {
+      column = std::static_pointer_cast<IReadColumn>(
+                   ReadPage(page, decoded_pages))
+                   ->Read(time_range);
+    }
+    result = MergeUnordered(std::move(result), std::move(column));
+  }
+  for (const auto& page : late_pages_) {
+    if (page.column_type != column_type ||
+        !page.time_range.Overlaps(time_range)) {
+      continue;
+    }
+    auto column =
+        std::static_pointer_cast<IReadColumn>(ReadPage(page, decoded_pages));
+    result = MergeUnordered(std::move(result), column->Read(time_range));
+  }
+  return result;
+}
+
+std::vector<Level::PageRef> Level::GetPagesToRead(
+    const TimeRange& time_range,
+    StoredAggregationType aggregation_type) const {
+  std::vector<PageRef> page_refs;
+  auto add_page = [&page_refs](const Page& page) {
+    page_refs.push_back({page.page_id, page.column_type});
+  };
   auto column_type = ToColumnType(aggregation_type);
   if (column_type == ColumnType::kRawRead) {
-    return ReadRawValues(time_range);
+    auto ts_pages = FindPages(ColumnType::kRawTimestamps, time_range);
+    if (!ts_pages.empty()) {
+      const auto& all_ts_pages = pages_.at(ColumnType::kRawTimestamps);
+      const auto& all_vals_pages = pages_.at(ColumnType::kRawValues);
+      size_t offset = ts_pages.data() - all_ts_pages.data();
+      for (size_t i = 0; i < ts_pages.size(); ++i) {
+        const auto& vals_page = all_vals_pages[offset + i];
+        if (!NeedRangedRead(ts_pages[i], vals_page, time_range)) {
+          add_page(ts_pages[i]);
+          add_page(vals_page);
+        }
+      }
+    }
+    bool overlaps = false;
+    for (const auto& page : late_pages_) {
+      if (page.column_type == ColumnType::kRawTimestamps) {
+        overlaps = page.time_range.Overlaps(time_range);
+      }
+      if ((page.column_type == ColumnType::kRawTimestamps ||
+           page.column_type == ColumnType::kRawValues) &&
+          overlaps) {
+        add_page(page);
+      }
+    }
+    return page_refs;
   }
-  auto it = std::ranges::find(page_ids_, column_type,
-                              &std::pair<ColumnType, PageId>::first);
-  assert(it != page_ids_.end());
 
-  auto bytes = storage_->Read(it->second);
-  auto column =
-      std::static_pointer_cast<IReadColumn>(FromBytes(bytes, column_type));
+  for (const auto& page : FindPages(column_type, time_range)) {
+    if (!NeedRangedRead(page, time_range)) {
+      add_page(page);
+    }
+  }
+  for (const auto& page : late_pages_) {
+    if (page.column_type == column_type &&
+        page.time_range.Overlaps(time_range)) {
+      add_page(page);
+    }
+  }
+  return page_refs;
+}
 
-  return column->Read(time_range);
+std::span<const Level::Page> Level::FindPages(
+    ColumnType column_type, const TimeRange& time_range) const {
+  auto it = pages_.find(column_type);
+  if (it == pages_.end()) {
+    return {};
+  }
+  const auto& pages = it->second;
+  auto first = std::ranges::partition_point(pages, [&](const Page& page) {
+    return page.time_range.end <= time_range.start;
+  });
+  auto last = std::ranges::partition_point(
+      first, pages.end(),
+      [&](const Page& page) { return page.time_range.start < time_range.end; });
+  return {first, last};
 }
 
-Column Level::ReadRawValues(const TimeRange& time_range) const {
-  auto ts_it = std::ranges::find(page_ids_, ColumnType::kRawTimestamps,
-                                 &std::pair<ColumnType, PageId>::first);
-  if (ts_it == page_ids_.end()) {
+ReadColumn Level::ReadRawValues(const TimeRange& time_range,
+                                const DecodedPages& decoded_pages) const {
+  auto ts_pages = FindPages(ColumnType::kRawTimestamps, time_range);
+  if (ts_pages.empty()) {
     return {};
   }
-  auto vals_it = std::ranges::find(page_ids_, ColumnType::kRawValues,
-                                   &std::pair<ColumnType, PageId>::first);
-  assert(vals_it != page_ids_.end());
-  auto ts_column = std::static_pointer_cast<RawTimestampsColumn>(
-      FromBytes(storage_->Read(ts_it->second), ColumnType::kRawTimestamps));
-  auto vals_column = std::static_pointer_cast<RawValuesColumn>(
-      FromBytes(storage_->Read(vals_it->second), ColumnType::kRawValues));
-  auto read_column = std::make_shared<ReadRawColumn>(ts_column, vals_column);
+  const auto& all_ts_pages = pages_.at(ColumnType::kRawTimestamps);
+  const auto& all_vals_pages = pages_.at(ColumnType::kRawValues);
+  assert(all_ts_pages.size() == all_vals_pages.size());
+  size_t offset = ts_pages.data() - all_ts_pages.data();
 
-  return read_column->Read(time_range);
+  ReadColumn result;
+  for (size_t i = 0; i < ts_pages.size(); ++i) {
+    const auto& ts_page = ts_pages[i];
+    const auto& vals_page = all_vals_pages[offset + i];
+    ReadColumn column;
+    if (!decoded_pages.contains(ts_page.page_id) &&
+        NeedRangedRead(ts_page, vals_page, time_range)) {
+      column = ReadRawRange(ts_page, vals_page, time_range);
+    } else {
+      auto read_column = std::make_shared<ReadRawColumn>(
+          std::static_pointer_cast<RawTimestampsColumn>(
+              ReadPage(ts_page, decoded_pages)),
+          std::static_pointer_cast<RawValuesColumn>(
+              ReadPage(vals_page, decoded_pages)));
+      column = read_column->Read(time_range);
+    }
+    result = MergeUnordered(std::move(result), std::move(column));
+  }
+  return result;
+}
+
+ReadColumn Level::ReadLateRawValues(const TimeRange& time_range,
+                                    const DecodedPages& decoded_pages) const {
+  // timestamps and values of every late write are stored one after another
+  ReadColumn result;
+  std::shared_ptr<RawTimestampsColumn> ts_column;
+  bool overlaps = false;
+  for (const auto& page : late_pages_) {
+    if (page.column_type == ColumnType::kRawTimestamps) {
+      overlaps = page.time_range.Overlaps(time_range);
+      if (overlaps) {
+        ts_column = std::static_pointer_cast<RawTimestampsColumn>(
+            ReadPage(page, decoded_pages));
+      }
+    } else if (page.column_type == ColumnType::kRawValues && overlaps) {
+      assert(ts_column);
+      auto vals_column = std::static_pointer_cast<RawValuesColumn>(
+          ReadPage(page, decoded_pages));
+      auto read_column = std::make_shared<ReadRawColumn>(
+          std::move(ts_column), std::move(vals_column));
+      result = MergeUnordered(std::move(result),
+                              read_column->Read(time_range));
+    }
+  }
+  return result;
 }
 
 void Level::Write(const SerializableColumn& column) {
-  if (!options_.store_raw &&
-      (column->GetType() == ColumnType::kRawValues ||
-       column->GetType() == ColumnType::kRawTimestamps)) {
-    return;
-  }
-  if (auto read_col = std::dynamic_pointer_cast<IReadColumn>(column)) {
-    auto time_range = read_col->GetTimeRange();
-    time_range_ = time_range_.Merge(time_range);
-  }
-  auto column_type = column->GetType();
-  auto it = std::ranges::find(page_ids_, column_type,
-                              &std::pair<ColumnType, PageId>::first);
-  if (it == page_ids_.end()) {
-    PageId page_id = storage_->CreatePage();
-    page_ids_.emplace_back(column_type, page_id);
-    storage_->Write(page_id, column->ToBytes());
-    return;
-  }
-
-  PageId& page_id = it->second;
-  auto read_column = std::dynamic_pointer_cast<ISerializableColumn>(
-      FromBytes(storage_->Read(page_id), column_type));
-  read_column->Merge(column);
-  storage_->DeletePage(page_id);
-  page_id = storage_->CreatePage();
-  storage_->Write(page_id, read_column->ToBytes());
+  Write(SerializableColumns{column});
+}
+
+void Level::Write(const SerializableColumns& columns) {
+  Apply(PrepareWrite(columns));
+}
+
+Level::PendingWrite Level::PrepareWrite(
+    const SerializableColumns& columns,
+    const SerializableColumns& late_columns) const {
+  PendingWrite write;
+  SerializableColumns stored_columns;
+  for (const auto& column : columns) {
+    if (!IsStored(column->GetType())) {
+      continue;
+    }
+    if (auto read_col = std::dynamic_pointer_cast<IReadColumn>(column)) {
+      write.time_range = write.time_range.Merge(read_col->GetTimeRange());
+    }
+    // there is nothing to read from empty pages
+    if (GetColumnBytesSize(column) == 0) {
+      continue;
+    }
+    stored_columns.push_back(column);
+  }
+  // late records don't extend the time range, otherwise a single old record
+  // would make the level look full to NeedMerge
+  size_t late_begin = stored_columns.size();
+  for (const auto& column : late_columns) {
+    if (IsStored(column->GetType()) && GetColumnBytesSize(column) != 0) {
+      stored_columns.push_back(column);
+    }
+  }
+  write.pages = WritePages(stored_columns);
+  write.late_pages.assign(std::make_move_iterator(write.pages.begin() +
+                                                  late_begin),
+                          std::make_move_iterator(write.pages.end()));
+  write.pages.resize(late_begin);
+  return write;
+}
+
+void Level::Apply(PendingWrite write) {
+  time_range_ = time_range_.Merge(write.time_range);
+  // every write is a new segment, they are merged when pages are moved to
+  // the next level
+  for (auto& page : write.pages) {
+    AddPage(std::move(page));
+  }
+  for (auto& page : write.late_pages) {
+    late_pages_.push_back(std::move(page));
+  }
+}
+
+void Level::WriteLate(const SerializableColumn& column) {
+  Apply(PrepareWrite({}, {column}));
 }
 
 void Level::MovePagesFrom(Level& other) {
   if (options_.bucket_interval == other.options_.bucket_interval &&
       options_.store_raw == other.options_.store_raw) {
-    page_ids_.insert(page_ids_.end(), other.page_ids_.begin(),
-                     other.page_ids_.end());
+    // pages of the other level are newer, so they are appended to the index
+    // as is
+    for (auto& [column_type, pages] : other.pages_) {
+      for (auto& page : pages) {
+        AddPage(std::move(page));
+      }
+    }
   } else {
-    for (auto& [column_type, page_id] : other.page_ids_) {
-      auto it = std::ranges::find(page_ids_, column_type,
-                                  &std::pair<ColumnType, PageId>::first);
-      if (it == page_ids_.end()) {
-        if ((column_type == ColumnType::kRawTimestamps ||
-             column_type == ColumnType::kRawValues) &&
-            !options_.store_raw) {
-          storage_->DeletePage(page_id);
+    // segments of every column type are merged into a single page
+    SerializableColumns columns;
+    for (auto& [column_type, pages] : other.pages_) {
+      if (!IsStored(column_type)) {
+        for (const auto& page : pages) {
+          other.RetirePage(page.page_id);
+        }
+        continue;
+      }
+      SerializableColumn column;
+      for (const auto& page : pages) {
+        auto page_view = other.storage_->ReadView(page.page_id);
+        auto page_column = std::dynamic_pointer_cast<ISerializableColumn>(
+            FromBytes(page_view.bytes, column_type));
+        other.RetirePage(page.page_id);
+        if (!column) {
+          column = std::move(page_column);
         } else {
-          page_ids_.emplace_back(column_type, page_id);
+          column->Merge(std::move(page_column));
         }
+      }
+      if (!column) {
         continue;
       }
-
-      auto bytes = other.storage_->Read(page_id);
-      auto column = std::dynamic_pointer_cast<ISerializableColumn>(
-          FromBytes(bytes, column_type));
-      if (column_type == ColumnType::kRawTimestamps ||
-          column_type == ColumnType::kRawValues) {
-        Write(column);
-      } else {
-        auto aggreagte_column =
-            std::dynamic_pointer_cast<IAggregateColumn>(column);
-        aggreagte_column->ScaleBuckets(options_.bucket_interval);
-        Write(aggreagte_column);
+      if (column_type != ColumnType::kRawTimestamps &&
+          column_type != ColumnType::kRawValues) {
+        std::dynamic_pointer_cast<IAggregateColumn>(column)->ScaleBuckets(
+            options_.bucket_interval);
       }
-      other.storage_->DeletePage(page_id);
+      columns.push_back(std::move(column));
+    }
+    Write(columns);
+  }
+
+  // late pages are merged into the pages they overlap, so they don't pile up
+  std::shared_ptr<RawTimestampsColumn> late_ts_column;
+  for (const auto& page : other.late_pages_) {
+    auto column_type = page.column_type;
+    other.RetirePage(page.page_id);
+    if (!IsStored(column_type)) {
+      continue;
+    }
+    auto column = FromBytes(other.storage_->ReadView(page.page_id).bytes,
+                            column_type);
+    // timestamps and values of every late write are stored one after another
+    if (column_type == ColumnType::kRawTimestamps) {
+      late_ts_column = std::static_pointer_cast<RawTimestampsColumn>(column);
+      continue;
+    }
+    if (column_type == ColumnType::kRawValues) {
+      MergeLate(ColumnType::kRawRead,
+                std::make_shared<ReadRawColumn>(
+                    std::move(late_ts_column),
+                    std::static_pointer_cast<RawValuesColumn>(column)));
+      continue;
     }
+    if (options_.bucket_interval != other.options_.bucket_interval) {
+      std::dynamic_pointer_cast<IAggregateColumn>(
+          std::dynamic_pointer_cast<ISerializableColumn>(column))
+          ->ScaleBuckets(options_.bucket_interval);
+    }
+    MergeLate(column_type, std::static_pointer_cast<IReadColumn>(column));
   }
+  other.late_pages_.clear();
 
   time_range_ = time_range_.Merge(other.time_range_);
 
-  other.page_ids_.clear();
+  other.pages_.clear();
   other.time_range_ = {};
 }
 
+bool Level::IsStored(ColumnType column_type) const {
+  return options_.store_raw || (column_type != ColumnType::kRawTimestamps &&
+                                column_type != ColumnType::kRawValues);
+}
+
+void Level::MergeLate(ColumnType column_type, ReadColumn late_column) {
+  bool is_raw = column_type == ColumnType::kRawRead;
+  // raw values pages follow raw timestamps pages
+  auto& pages = pages_[is_raw ? ColumnType::kRawTimestamps : column_type];
+  auto& vals_pages = pages_[ColumnType::kRawValues];
+  auto read_page = [&](size_t i) -> ReadColumn {
+    auto decode = [this](const Page& page) {
+      return FromBytes(storage_->ReadView(page.page_id).bytes,
+                       page.column_type);
+    };
+    if (!is_raw) {
+      return std::static_pointer_cast<IReadColumn>(decode(pages[i]));
+    }
+    return std::make_shared<ReadRawColumn>(
+        std::static_pointer_cast<RawTimestampsColumn>(decode(pages[i])),
+        std::static_pointer_cast<RawValuesColumn>(decode(vals_pages[i])));
+  };
+  std::vector<Page> new_pages;
+  std::vector<Page> new_vals_pages;
+  auto write_page = [&](const ReadColumn& column) {
+    if (!is_raw) {
+      new_pages.push_back(
+          WritePage(std::dynamic_pointer_cast<ISerializableColumn>(column)));
+      return;
+    }
+    auto read_column = std::static_pointer_cast<ReadRawColumn>(column);
+    auto timestamps = read_column->GetTimestamps();
+    auto values = read_column->GetValues();
+    InputTimeSeries records;
+    records.reserve(timestamps.size());
+    for (size_t i = 0; i < timestamps.size(); ++i) {
+      records.push_back({timestamps[i], values[i]});
+    }
+    SerializableColumns columns;
+    for (auto raw_type :
+         {ColumnType::kRawTimestamps, ColumnType::kRawValues}) {
+      auto raw_column = CreateRawColumn(raw_type);
+      raw_column->Write(records);
+      columns.push_back(
+          std::dynamic_pointer_cast<ISerializableColumn>(raw_column));
+    }
+    auto written = WritePages(columns);
+    new_pages.push_back(std::move(written[0]));
+    new_vals_pages.push_back(std::move(written[1]));
+  };
+  auto write_late_part = [&](TimePoint start, TimePoint end) {
+    if (start >= end) {
+      return;
+    }
+    if (auto part = late_column->Read({start, end})) {
+      write_page(part);
+    }
+  };
+
+  auto late_range = late_column->GetTimeRange();
+  auto overlapping = FindPages(
+      is_raw ? ColumnType::kRawTimestamps : column_type, late_range);
+  size_t first = overlapping.data() - pages.data();
+  size_t last = first + overlapping.size();
+  // every late record goes to exactly one page, ranges of pages may share
+  // only the boundary bucket, it goes to the earlier one
+  auto start = late_range.start;
+  for (size_t i = first; i < last; ++i) {
+    const auto& page_range = pages[i].time_range;
+    write_late_part(start, page_range.start);
+    start = std::max(start, page_range.start);
+    auto part = start < page_range.end
+                    ? late_column->Read({start, page_range.end})
+                    : nullptr;
+    start = std::max(start, page_range.end);
+    if (!part) {
+      new_pages.push_back(std::move(pages[i]));
+      if (is_raw) {
+        new_vals_pages.push_back(std::move(vals_pages[i]));
+      }
+      continue;
+    }
+    write_page(MergeUnordered(read_page(i), std::move(part)));
+    RetirePage(pages[i].page_id);
+    if (is_raw) {
+      RetirePage(vals_pages[i].page_id);
+    }
+  }
+  write_late_part(start, late_range.end);
+
+  pages.erase(pages.begin() + first, pages.begin() + last);
+  pages.insert(pages.begin() + first,
+               std::make_move_iterator(new_pages.begin()),
+               std::make_move_iterator(new_pages.end()));
+  if (is_raw) {
+    vals_pages.erase(vals_pages.begin() + first, vals_pages.begin() + last);
+    vals_pages.insert(vals_pages.begin() + first,
+                      std::make_move_iterator(new_vals_pages.begin()),
+                      std::make_move_iterator(new_vals_pages.end()));
+  }
+}
+
+Column Level::ReadPage(const Page& page,
+                       const DecodedPages& decoded_pages) const {
+  if (auto it = decoded_pages.find(page.page_id); it != decoded_pages.end()) {
+    return it->second;
+  }
+  if (page_cache_) {
+    if (auto column =
+            page_cache_->Get(storage_->GetInstanceId(), page.page_id)) {
+      return column;
+    }
+  }
+  auto column =
+      FromBytes(storage_->ReadView(page.page_id).bytes, page.column_type);
+  if (page_cache_) {
+    page_cache_->Put(storage_->GetInstanceId(), page.page_id, column);
+  }
+  return column;
+}
+
+bool Level::NeedRangedRead(const Page& page,
+                           const TimeRange& time_range) const {
+  if (time_range.Contains(page.time_range)) {
+    return false;
+  }
+  // parts of pages are not cached, so the cache keeps only whole pages which
+  // were read over their whole range
+  if (page_cache_ &&
+      page_cache_->Contains(storage_->GetInstanceId(), page.page_id)) {
+    return false;
+  }
+  if (page.column_type == ColumnType::kRawTimestamps) {
+    return !page.block_index.empty();
+  }
+  // buckets of dense pages follow the header, see ParseAggregateBytes
+  return page.bytes_size % sizeof(Value) == 0 ||
+         page.aggregate_index.has_value();
+}
+
+bool Level::NeedRangedRead(const Page& timestamps_page,
+                           const Page& values_page,
+                           const TimeRange& time_range) const {
+  // blocks of values can be fetched only from plain pages too
+  return NeedRangedRead(timestamps_page, time_range) &&
+         values_page.bytes_size % sizeof(Value) == 0;
+}
+
+ReadColumn Level::ReadAggregateRange(const Page& page,
+                                     const TimeRange& time_range) const {
+  if (page.aggregate_index) {
+    auto bytes = tskv::ReadAggregateRange(
+        *page.aggregate_index, time_range, [&](size_t offset, size_t size) {
+          return storage_->ReadRange(page.page_id, offset, size);
+        });
+    if (bytes.empty()) {
+      return {};
+    }
+    auto column = std::static_pointer_cast<IReadColumn>(
+        FromBytes(bytes, page.column_type));
+    return column->Read(time_range);
+  }
+  // dense pages are the header of the bucket interval and the start followed
+  // by buckets, see AggregateColumnBase::ToBytes
+  constexpr size_t kHeaderSize = sizeof(size_t) + sizeof(TimePoint);
+  size_t bucket_interval = page.bucket_interval;
+  auto start = page.time_range.start;
+  size_t buckets_num = (page.bytes_size - kHeaderSize) / sizeof(Value);
+  size_t first = 0;
+  if (time_range.start > start) {
+    first = (time_range.start - start) / bucket_interval;
+  }
+  size_t last = 0;
+  if (time_range.end > start) {
+    last = std::min(buckets_num,
+                    (time_range.end - start + bucket_interval - 1) /
+                        bucket_interval);
+  }
+  if (first >= last) {
+    return {};
+  }
+
+  // dense page of the fetched buckets
+  CompressedBytes bytes;
+  Append(bytes, bucket_interval);
+  Append(bytes, start + first * bucket_interval);
+  auto buckets =
+      storage_->ReadRange(page.page_id, kHeaderSize + first * sizeof(Value),
+                          (last - first) * sizeof(Value));
+  bytes.insert(bytes.end(), buckets.begin(), buckets.end());
+  auto column = std::static_pointer_cast<IReadColumn>(
+      FromBytes(bytes, page.column_type));
+  return column->Read(time_range);
+}
+
+ReadColumn Level::ReadRawRange(const Page& timestamps_page,
+                               const Page& values_page,
+                               const TimeRange& time_range) const {
+  const auto& index = timestamps_page.block_index;
+  // the block before the first indexed timestamp >= start may end with
+  // timestamps of the range
+  size_t first_block = std::ranges::lower_bound(index, time_range.start) -
+                       index.begin();
+  if (first_block > 0) {
+    --first_block;
+  }
+  size_t last_block =
+      std::ranges::lower_bound(index, time_range.end) - index.begin();
+  size_t timestamps_num = timestamps_page.bytes_size / sizeof(TimePoint);
+  size_t first = first_block * kRawBlockSize;
+  size_t last = std::min(timestamps_num, last_block * kRawBlockSize);
+  if (first >= last) {
+    return {};
+  }
+
+  // parts of plain pages are plain pages too
+  auto ts_column = std::static_pointer_cast<RawTimestampsColumn>(FromBytes(
+      storage_->ReadRange(timestamps_page.page_id, first * sizeof(TimePoint),
+                          (last - first) * sizeof(TimePoint)),
+      ColumnType::kRawTimestamps));
+  auto vals_column = std::static_pointer_cast<RawValuesColumn>(FromBytes(
+      storage_->ReadRange(values_page.page_id, first * sizeof(Value),
+                          (last - first) * sizeof(Value)),
+      ColumnType::kRawValues));
+  auto read_column = std::make_shared<ReadRawColumn>(std::move(ts_column),
+                                                     std::move(vals_column));
+  return read_column->Read(time_range);
+}
+
+Level::Page Level::WritePage(const SerializableColumn& column) {
+  return std::move(WritePages({column}).front());
+}
+
+std::vector<Level::Page> Level::WritePages(
+    const SerializableColumns& columns) const {
+  std::vector<Page> pages;
+  std::vector<PageId> page_ids;
+  std::vector<CompressedBytes> pages_bytes;
+  for (const auto& column : columns) {
+    auto& page = pages.emplace_back(Page{
+        .column_type = column->GetType(),
+        .page_id = storage_->CreatePage(),
+        .time_range = GetColumnTimeRange(column),
+    });
+    const auto& bytes = pages_bytes.emplace_back(ToBytes(column));
+    page.bytes_size = bytes.size();
+    if (auto aggregate_column =
+            std::dynamic_pointer_cast<IAggregateColumn>(column)) {
+      page.bucket_interval = aggregate_column->GetBucketInterval();
+      page.aggregate_index = IndexAggregateBytes(bytes);
+    }
+    // plain pages are arrays of timestamps, see EncodeRawTimestamps
+    if (page.column_type == ColumnType::kRawTimestamps &&
+        bytes.size() % sizeof(TimePoint) == 0) {
+      auto ts_column = std::static_pointer_cast<RawTimestampsColumn>(column);
+      for (size_t i = 0; i < ts_column->TimestampsNum(); i += kRawBlockSize) {
+        page.block_index.push_back(ts_column->At(i));
+      }
+    }
+    page_ids.push_back(page.page_id);
+  }
+  storage_->WriteMany(page_ids, pages_bytes);
+  return pages;
+}
+
+void Level::AddPage(Page page) {
+  auto& pages = pages_[page.column_type];
+  // raw values pages have no time range, their order follows timestamps
+  // pages
+  assert(page.column_type == ColumnType::kRawValues || pages.empty() ||
+         pages.back().time_range.start <= page.time_range.start);
+  pages.push_back(std::move(page));
+}
+
+CompressedBytes Level::ToBytes(const SerializableColumn& column) const {
+  if (column->GetType() == ColumnType::kRawValues) {
+    auto values_column = std::static_pointer_cast<RawValuesColumn>(column);
+    return values_column->ToBytes(options_.raw_values_encoding);
+  }
+  if (column->GetType() == ColumnType::kRawTimestamps) {
+    auto timestamps_column =
+        std::static_pointer_cast<RawTimestampsColumn>(column);
+    return timestamps_column->ToBytes(options_.raw_timestamps_encoding);
+  }
+  return column->ToBytes();
+}
+
 bool Level::NeedMerge() const {
   return time_range_.GetDuration() >= options_.level_duration;
 }
 
+std::vector<PageId> Level::ExtractRetiredPages() {
+  return std::exchange(retired_page_ids_, {});
+}
+
+void Level::RetirePage(const PageId& page_id) {
+  retired_page_ids_.push_back(page_id);
+}
+
 }  // namespace tskv
@@ -2,8 +2,15 @@
 
 #include "model/column.h"
 #include "model/model.h"
+#include "persistent-storage/page_cache.h"
 #include "persistent-storage/persistent_storage.h"
 
+#include <map>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
 namespace tskv {
 
 class Level {
@@ -12,24 +19,130 @@ class Level {
     Duration bucket_interval;
     Duration level_duration;
     bool store_raw{false};
+    RawValuesEncoding raw_values_encoding{RawValuesEncoding::kPlain};
+    RawTimestampsEncoding raw_timestamps_encoding{
+        RawTimestampsEncoding::kPlain};
+  };
+
+  // page which Read fetches whole
+  struct PageRef {
+    PageId page_id;
+    ColumnType column_type;
+  };
+
+  // pages decoded by the caller, they are not fetched again
+  using DecodedPages = std::unordered_map<PageId, Column>;
+
+  // metadata of a stored page
+  struct Page {
+    ColumnType column_type;
+    PageId page_id;
+    // raw values pages have no time range, they are read together with the
+    // timestamps pages
+    TimeRange time_range;
+    size_t bytes_size{0};
+    // bucket interval of aggregate pages
+    Duration bucket_interval{};
+    // first timestamps of blocks of plain raw timestamps pages
+    std::vector<TimePoint> block_index;
+    // offsets of buckets of sparse, bit-packed aggregate pages and pages with
+    // absent buckets
+    std::optional<AggregateIndex> aggregate_index;
+  };
+
+  // pages of a write which are stored but not added to the level yet, so
+  // that they can be written without the lock guarding the level
+  struct PendingWrite {
+    std::vector<Page> pages;
+    // pages of late records
+    std::vector<Page> late_pages;
+    TimeRange time_range{};
   };
 
  public:
-  Level(const Options& options, std::shared_ptr<IPersistentStorage> storage);
+  // reads go through page_cache if it's set
+  Level(const Options& options, std::shared_ptr<IPersistentStorage> storage,
+        std::shared_ptr<PageCache> page_cache = nullptr);
   Column Read(const TimeRange& time_range,
-              StoredAggregationType aggregation_type) const;
+              StoredAggregationType aggregation_type,
+              const DecodedPages& decoded_pages = {}) const;
+  // pages which Read fetches whole for the time range, so that pages of
+  // several levels can be fetched in one batch
+  std::vector<PageRef> GetPagesToRead(
+      const TimeRange& time_range,
+      StoredAggregationType aggregation_type) const;
   void Write(const SerializableColumn& column);
+  // pages of all columns are written in one batch
+  void Write(const SerializableColumns& columns);
+  // stores pages of the columns and of columns of late records in one batch,
+  // the level isn't changed until Apply
+  PendingWrite PrepareWrite(const SerializableColumns& columns,
+                            const SerializableColumns& late_columns = {}) const;
+  void Apply(PendingWrite write);
+  // stores column of late records as a separate page instead of merging it
+  // into the level pages, they are merged on read
+  void WriteLate(const SerializableColumn& column);
+  // late pages of the level are merged into the pages of this one
   void MovePagesFrom(Level& level);
   bool NeedMerge() const;
+  // pages which are not used by the level anymore. They are not deleted right
+  // away, because concurrent reads of the previous state of the level may
+  // still read them
+  std::vector<PageId> ExtractRetiredPages();
+
+  // every kRawBlockSize-th timestamp of plain raw pages is indexed, so that
+  // reads fetch only blocks of the requested range
+  static constexpr size_t kRawBlockSize = 256;
 
  private:
-  Column ReadRawValues(const TimeRange& time_range) const;
+  // pages of the column type overlapping the time range
+  std::span<const Page> FindPages(ColumnType column_type,
+                                  const TimeRange& time_range) const;
+  ReadColumn ReadRawValues(const TimeRange& time_range,
+                           const DecodedPages& decoded_pages) const;
+  ReadColumn ReadLateRawValues(const TimeRange& time_range,
+                               const DecodedPages& decoded_pages) const;
+  // decoded page, it may be shared with the cache, so it must not be modified
+  Column ReadPage(const Page& page, const DecodedPages& decoded_pages) const;
+  // true if only a part of the page should be fetched for the time range
+  bool NeedRangedRead(const Page& page, const TimeRange& time_range) const;
+  bool NeedRangedRead(const Page& timestamps_page, const Page& values_page,
+                      const TimeRange& time_range) const;
+  // fetches buckets of the time range of the aggregate page, their offsets
+  // are computed from the page metadata
+  ReadColumn ReadAggregateRange(const Page& page,
+                                const TimeRange& time_range) const;
+  // fetches blocks of the time range of plain raw pages
+  ReadColumn ReadRawRange(const Page& timestamps_page, const Page& values_page,
+                          const TimeRange& time_range) const;
+  // raw columns are stored only by levels with store_raw
+  bool IsStored(ColumnType column_type) const;
+  // merges late records into the pages of their time ranges, records
+  // between pages get pages of their own. Raw records are merged with
+  // kRawRead
+  void MergeLate(ColumnType column_type, ReadColumn late_column);
+  // writes the column to a new page
+  Page WritePage(const SerializableColumn& column);
+  std::vector<Page> WritePages(const SerializableColumns& columns) const;
+  void AddPage(Page page);
+  CompressedBytes ToBytes(const SerializableColumn& column) const;
+  void RetirePage(const PageId& page_id);
 
  private:
   Options options_;
   std::shared_ptr<IPersistentStorage> storage_;
-  std::vector<std::pair<ColumnType, PageId>> page_ids_;
+  std::shared_ptr<PageCache> page_cache_;
+  // pages of every column type ordered by time. Levels get data in time
+  // order, so ranges of consecutive pages may share only the boundary bucket.
+  // i-th raw timestamps page and i-th raw values page are written from the
+  // same column
+  std::map<ColumnType, std::vector<Page>> pages_;
+  // pages of late records, one per column of every flush. They are merged
+  // into the pages of the next level when this one is moved to it
+  std::vector<Page> late_pages_;
+  // range of in-order writes, late pages are not counted
   TimeRange time_range_{};
+  std::vector<PageId> retired_page_ids_;
 };
 
 }  // namespace tskv
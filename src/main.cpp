@@ -4,9 +4,13 @@
 #include <string>
 #include <vector>
 
+#include "executor/background_executor.h"
 #include "model/column.h"
 #include "model/model.h"
-#include "persistent-storage/disk_storage.h"
+#include "persistent-storage/compaction_scheduler.h"
+#include "persistent-storage/io_ring.h"
+#include "persistent-storage/page_cache.h"
+#include "persistent-storage/segment_storage.h"
 #include "storage/storage.h"
 
 std::vector<std::string> Split(const std::string& s,
@@ -109,16 +113,29 @@ WriteResult Write(tskv::Storage& storage) {
                          .bucket_interval = tskv::Duration::Seconds(10),
                          .level_duration = tskv::Duration::Hours(10),
                          .store_raw = true,
+                         .raw_values_encoding =
+                             tskv::RawValuesEncoding::kGorilla,
+                         .raw_timestamps_encoding =
+                             tskv::RawTimestampsEncoding::kRuns,
                      },
                      {
                          .bucket_interval = tskv::Duration::Seconds(30),
                          .level_duration = tskv::Duration::Weeks(2),
                      }},
-          .storage =
-              std::make_unique<tskv::DiskStorage>(tskv::DiskStorage::Options{
+          .storage = std::make_unique<tskv::SegmentStorage>(
+              tskv::SegmentStorage::Options{
                   .path = "./tmp/tskv",
+                  .reclaim_executor =
+                      std::make_shared<tskv::BackgroundExecutor>(),
+                  .io_ring = std::make_shared<tskv::IoRing>(),
               }),
+          .compaction_scheduler = std::make_shared<tskv::CompactionScheduler>(
+              tskv::CompactionScheduler::Options{}),
+          .page_cache = std::make_shared<tskv::PageCache>(
+              tskv::PageCache::Options{.max_bytes_size = 100 * kMb}),
       },
+      // memtables of all metrics are flushed by one thread
+      std::make_shared<tskv::BackgroundExecutor>(),
   };
 
   std::unordered_map<size_t, tskv::MetricId> metric_ids;
@@ -127,22 +144,24 @@ WriteResult Write(tskv::Storage& storage) {
   }
 
   int idx = 0;
+  tskv::InputBatch batch;
   while (true) {
-    bool wrote = false;
-
+    batch.Clear();
     for (auto& [hash, series] : time_series) {
       if (idx >= series.size()) {
         continue;
       }
-      auto& cur_time_series = series[idx];
-      storage.Write(metric_ids[hash], cur_time_series);
-      wrote = true;
+      auto metric_id = metric_ids[hash];
+      for (const auto& record : series[idx]) {
+        batch.Add(metric_id, record.timestamp, record.value);
+      }
     }
     ++idx;
 
-    if (!wrote) {
+    if (batch.Size() == 0) {
       break;
     }
+    storage.WriteBatch(batch);
   }
 
   storage.Flush();
@@ -1,8 +1,11 @@
 #include "memtable.h"
 
 #include <algorithm>
+#include <iterator>
 #include <memory>
+#include <ranges>
 #include <string>
+#include <utility>
 #include "metric-storage/metric_storage.h"
 #include "model/aggregations.h"
 #include "model/column.h"
@@ -24,47 +27,145 @@ Memtable::Memtable(const Options& options, const MetricOptions& metric_options)
   }
 }
 
+Memtable::Memtable(const Options& options, Columns columns)
+    : columns_(std::move(columns)), options_(options) {}
+
 void Memtable::Write(const InputTimeSeries& time_series) {
-  for (auto& column : columns_) {
-    column->Write(time_series);
+  if (time_series.empty()) {
+    return;
+  }
+  // in-order records without lateness window are written as is
+  if (options_.max_lateness == 0 && pending_.empty() &&
+      (!last_sealed_ || time_series.front().timestamp >= *last_sealed_) &&
+      std::ranges::is_sorted(time_series, {}, &Record::timestamp)) {
+    WriteSealed(time_series);
+    return;
+  }
+
+  auto records = time_series;
+  std::ranges::stable_sort(records, {}, &Record::timestamp);
+  auto behind_begin = records.begin();
+  if (floor_) {
+    behind_begin = std::ranges::lower_bound(records, *floor_, {},
+                                            &Record::timestamp);
   }
+  auto pending_begin = behind_begin;
+  if (last_sealed_) {
+    pending_begin = std::ranges::lower_bound(behind_begin, records.end(),
+                                             *last_sealed_, {},
+                                             &Record::timestamp);
+  }
+  late_.insert(records.begin(), behind_begin);
+  behind_.insert(behind_begin, pending_begin);
+  if (pending_begin == records.end()) {
+    return;
+  }
+
+  InputTimeSeries pending;
+  pending.reserve(pending_.size() + (records.end() - pending_begin));
+  std::ranges::merge(pending_, std::ranges::subrange(pending_begin,
+                                                     records.end()),
+                     std::back_inserter(pending), {}, &Record::timestamp,
+                     &Record::timestamp);
+  pending_ = std::move(pending);
+  watermark_ = std::max(watermark_.value_or(0), pending_.back().timestamp);
+  Seal(*watermark_ - std::min<TimePoint>(*watermark_, options_.max_lateness));
 }
 
 Memtable::ReadResult Memtable::Read(
     const TimeRange& time_range, StoredAggregationType aggregation_type) const {
   auto column_type = ToColumnType(aggregation_type);
-  if (column_type == ColumnType::kRawRead) {
-    return ReadRawValues(time_range);
+  auto late = ReadRecords(late_, time_range, column_type);
+  // behind records may be anywhere in the range of the columns
+  auto column_res = MergeUnordered(ReadColumns(time_range, column_type),
+                                   ReadRecords(behind_, time_range,
+                                               column_type));
+  if (auto pending = ReadRecords(pending_, time_range, column_type)) {
+    // buffered records are never older than the columns
+    if (column_res) {
+      column_res->Merge(pending);
+    } else {
+      column_res = pending;
+    }
   }
-  auto it = std::find_if(columns_.begin(), columns_.end(),
-                         [column_type](const auto& column) {
-                           return column->GetType() == column_type;
-                         });
-  assert(it != columns_.end());
-
-  auto column = std::static_pointer_cast<IReadColumn>(*it);
-  auto column_res = column->Read(time_range);
 
   if (!column_res) {
-    return {.not_found = time_range};
+    return {.not_found = time_range, .late = late};
   }
 
   std::optional<TimeRange> not_found;
 
-  if (column_res->GetTimeRange().start > time_range.start) {
-    not_found = TimeRange{time_range.start, column_res->GetTimeRange().start};
+  auto found_start = column_res->GetTimeRange().start;
+  // the first bucket may also have records that are already in the levels
+  if (persisted_last_) {
+    found_start = std::max(found_start,
+                           std::min(*persisted_last_ + 1, time_range.end));
   }
-  return {.found = column_res, .not_found = not_found};
+  if (found_start > time_range.start) {
+    not_found = TimeRange{time_range.start, found_start};
+  }
+  return {.found = column_res, .not_found = not_found, .late = late};
 }
 
 Columns Memtable::ExtractColumns() {
+  if (watermark_) {
+    Seal(*watermark_);
+  }
+  MergeBehind();
   Columns res;
   for (auto& column : columns_) {
     res.push_back(column->Extract());
   }
+  // flushed data can't be merged with older records anymore
+  floor_ = last_sealed_;
+  if (last_sealed_) {
+    persisted_last_ = std::max(persisted_last_.value_or(0), *last_sealed_);
+  }
   return res;
 }
 
+std::shared_ptr<Memtable> Memtable::Freeze() {
+  auto persisted_last = persisted_last_;
+  auto frozen = std::make_shared<Memtable>(options_, ExtractColumns());
+  frozen->persisted_last_ = persisted_last;
+  frozen->late_ = std::move(late_);
+  late_.clear();
+  return frozen;
+}
+
+SerializableColumns Memtable::GetColumns() const {
+  assert(pending_.empty());
+  SerializableColumns columns;
+  columns.reserve(columns_.size());
+  for (const auto& column : columns_) {
+    auto serializable_column =
+        std::dynamic_pointer_cast<ISerializableColumn>(column);
+    assert(serializable_column);
+    columns.push_back(std::move(serializable_column));
+  }
+  return columns;
+}
+
+bool Memtable::HasLateRecords() const {
+  return !late_.empty();
+}
+
+Columns Memtable::GetLateColumns() const {
+  auto columns = CreateColumns();
+  WriteColumns(columns, InputTimeSeries(late_.begin(), late_.end()));
+  return columns;
+}
+
+Columns Memtable::ExtractLateColumns() {
+  if (!late_.empty()) {
+    persisted_last_ =
+        std::max(persisted_last_.value_or(0), late_.rbegin()->timestamp);
+  }
+  auto columns = GetLateColumns();
+  late_.clear();
+  return columns;
+}
+
 bool Memtable::NeedFlush() const {
   if (options_.max_bytes_size && GetBytesSize() > *options_.max_bytes_size) {
     return true;
@@ -95,74 +196,158 @@ bool Memtable::NeedFlush() const {
   return false;
 }
 
-Memtable::ReadResult Memtable::ReadRawValues(
-    const TimeRange& time_range) const {
+ReadColumn Memtable::ReadColumns(const TimeRange& time_range,
+                                 ColumnType column_type) const {
+  if (column_type == ColumnType::kRawRead) {
+    return ReadRawValues(time_range);
+  }
+  auto it = std::find_if(columns_.begin(), columns_.end(),
+                         [column_type](const auto& column) {
+                           return column->GetType() == column_type;
+                         });
+  assert(it != columns_.end());
+
+  auto column = std::static_pointer_cast<IReadColumn>(*it);
+  return column->Read(time_range);
+}
+
+ReadColumn Memtable::ReadRawValues(const TimeRange& time_range) const {
   auto ts_it = std::ranges::find(columns_, ColumnType::kRawTimestamps,
                                  &IColumn::GetType);
   if (ts_it == columns_.end()) {
-    return {.not_found = time_range};
+    return {};
   }
   auto vals_it =
       std::ranges::find(columns_, ColumnType::kRawValues, &IColumn::GetType);
   if (vals_it == columns_.end()) {
-    return {.not_found = time_range};
+    return {};
   }
-  Memtable::ReadResult result;
 
   auto ts_column = std::static_pointer_cast<RawTimestampsColumn>(*ts_it);
   auto vals_column = std::static_pointer_cast<RawValuesColumn>(*vals_it);
   auto column = std::make_shared<ReadRawColumn>(ts_column, vals_column);
-  auto column_res = column->Read(time_range);
+  return column->Read(time_range);
+}
 
-  if (!column_res) {
-    return {.not_found = time_range};
+ReadColumn Memtable::ReadRecords(const InputTimeSeries& records,
+                                 const TimeRange& time_range,
+                                 ColumnType column_type) const {
+  if (records.empty()) {
+    return {};
+  }
+  ReadColumn column;
+  if (column_type == ColumnType::kRawRead) {
+    if (!options_.store_raw) {
+      return {};
+    }
+    column = std::make_shared<ReadRawColumn>();
+  } else {
+    column = std::static_pointer_cast<IReadColumn>(
+        CreateAggregatedColumn(column_type, options_.bucket_interval));
   }
+  column->Write(records);
+  return column->Read(time_range);
+}
 
-  std::optional<TimeRange> not_found;
-  if (column_res->GetTimeRange().start > time_range.start) {
-    not_found = TimeRange{time_range.start, column_res->GetTimeRange().start};
+ReadColumn Memtable::ReadRecords(const SortedRecords& records,
+                                 const TimeRange& time_range,
+                                 ColumnType column_type) const {
+  auto first = records.lower_bound({time_range.start, 0});
+  auto last = records.lower_bound({time_range.end, 0});
+  return ReadRecords(InputTimeSeries(first, last), time_range, column_type);
+}
+
+void Memtable::Seal(TimePoint boundary) {
+  auto end = std::ranges::upper_bound(pending_, boundary, {},
+                                      &Record::timestamp);
+  if (end == pending_.begin()) {
+    return;
+  }
+  InputTimeSeries sealed;
+  if (end == pending_.end()) {
+    sealed = std::move(pending_);
+    pending_.clear();
+  } else {
+    sealed.assign(pending_.begin(), end);
+    pending_.erase(pending_.begin(), end);
   }
-  return {.found = column_res, .not_found = not_found};
+  WriteSealed(sealed);
 }
 
-size_t Memtable::GetBytesSize() const {
-  size_t size = 0;
+void Memtable::WriteSealed(const InputTimeSeries& time_series) {
+  WriteColumns(columns_, time_series);
+  last_sealed_ = time_series.back().timestamp;
+  watermark_ = std::max(watermark_.value_or(0), *last_sealed_);
+}
+
+void Memtable::MergeBehind() {
+  if (behind_.empty()) {
+    return;
+  }
+  InputTimeSeries behind(behind_.begin(), behind_.end());
+  behind_.clear();
+  for (auto& column : columns_) {
+    auto column_type = column->GetType();
+    if (column_type == ColumnType::kRawTimestamps ||
+        column_type == ColumnType::kRawValues) {
+      continue;
+    }
+    auto behind_column =
+        CreateAggregatedColumn(column_type, options_.bucket_interval);
+    behind_column->Write(behind);
+    column =
+        MergeUnordered(std::static_pointer_cast<IReadColumn>(column),
+                       std::static_pointer_cast<IReadColumn>(behind_column));
+  }
+  if (!options_.store_raw) {
+    return;
+  }
+  auto ts_it = std::ranges::find(columns_, ColumnType::kRawTimestamps,
+                                 &IColumn::GetType);
+  auto vals_it =
+      std::ranges::find(columns_, ColumnType::kRawValues, &IColumn::GetType);
+  assert(ts_it != columns_.end() && vals_it != columns_.end());
+  ReadRawColumn current(std::static_pointer_cast<RawTimestampsColumn>(*ts_it),
+                        std::static_pointer_cast<RawValuesColumn>(*vals_it));
+  auto timestamps = current.GetTimestamps();
+  auto values = current.GetValues();
+  InputTimeSeries records;
+  records.reserve(timestamps.size() + behind.size());
+  auto it = behind.begin();
+  for (size_t i = 0; i < timestamps.size(); ++i) {
+    for (; it != behind.end() && it->timestamp < timestamps[i]; ++it) {
+      records.push_back(*it);
+    }
+    records.push_back({timestamps[i], values[i]});
+  }
+  records.insert(records.end(), it, behind.end());
+  *ts_it = CreateRawColumn(ColumnType::kRawTimestamps);
+  *vals_it = CreateRawColumn(ColumnType::kRawValues);
+  (*ts_it)->Write(records);
+  (*vals_it)->Write(records);
+}
+
+Columns Memtable::CreateColumns() const {
+  Columns columns;
   for (const auto& column : columns_) {
-    switch (column->GetType()) {
-      case ColumnType::kSum:
-      case ColumnType::kCount:
-      case ColumnType::kMin:
-      case ColumnType::kMax:
-      case ColumnType::kLast: {
-        auto agg_column = std::dynamic_pointer_cast<IAggregateColumn>(column);
-        size_t buckets_num =
-            agg_column->GetTimeRange().GetDuration() / options_.bucket_interval;
-        size += buckets_num * sizeof(Value);
-        break;
-      }
-      case ColumnType::kAvg: {
-        auto avg_column = std::dynamic_pointer_cast<AvgColumn>(column);
-        size_t buckets_num =
-            avg_column->GetTimeRange().GetDuration() / options_.bucket_interval;
-        size += buckets_num * sizeof(Value);
-        break;
-      }
-      case ColumnType::kRawTimestamps: {
-        auto raw_ts_column =
-            std::dynamic_pointer_cast<RawTimestampsColumn>(column);
-        size += raw_ts_column->TimestampsNum() * sizeof(TimePoint);
-        break;
-      }
-      case ColumnType::kRawValues: {
-        auto raw_vals_column =
-            std::dynamic_pointer_cast<RawValuesColumn>(column);
-        size += raw_vals_column->ValuesNum() * sizeof(Value);
-        break;
-      }
-      default:
-        assert(false);
+    auto column_type = column->GetType();
+    if (column_type == ColumnType::kRawTimestamps ||
+        column_type == ColumnType::kRawValues) {
+      columns.push_back(CreateRawColumn(column_type));
+    } else {
+      columns.push_back(
+          CreateAggregatedColumn(column_type, options_.bucket_interval));
     }
   }
+  return columns;
+}
+
+size_t Memtable::GetBytesSize() const {
+  size_t size =
+      (pending_.size() + behind_.size() + late_.size()) * sizeof(Record);
+  for (const auto& column : columns_) {
+    size += GetColumnBytesSize(column);
+  }
   return size;
 }
 
@@ -5,6 +5,7 @@
 #include <cstdint>
 #include <memory>
 #include <optional>
+#include <set>
 #include <vector>
 
 #include "model/column.h"
@@ -21,29 +22,95 @@ class Memtable {
     std::optional<size_t> max_bytes_size;
     std::optional<Duration> max_age;
     bool store_raw{false};
+    // records up to max_lateness older than the newest one may come in any
+    // order: they are kept in a sorted buffer until the window passes them
+    Duration max_lateness{0};
   };
 
   struct ReadResult {
     Column found;
     // only <= 1 time range, because memtable stores data suffix
     std::optional<TimeRange> not_found;
+    // late records of the time range, they are older than the found ones and
+    // overlap data of the levels
+    Column late;
   };
 
  public:
   Memtable(const Options& options, const MetricOptions& metric_options);
+  // memtable of already written columns
+  Memtable(const Options& options, Columns columns);
+  // records may be unsorted. Records older than the already flushed ones are
+  // not written to it, see ExtractLateColumns
   void Write(const InputTimeSeries& time_series);
   ReadResult Read(const TimeRange& time_range,
                   StoredAggregationType aggregation_type) const;
+  // buffered records are written to the columns first
   Columns ExtractColumns();
+  // moves all records, late ones too, to a new memtable, which is never
+  // written again, so that it can be read and flushed while this one takes
+  // new writes. For reads and late records this memtable behaves as if it
+  // was flushed
+  std::shared_ptr<Memtable> Freeze();
+  // columns with all records, they must not be modified
+  SerializableColumns GetColumns() const;
   bool NeedFlush() const;
 
+  bool HasLateRecords() const;
+  // columns of records older than everything the memtable has flushed, they
+  // are buffered until the flush and written to the levels as late data
+  Columns GetLateColumns() const;
+  Columns ExtractLateColumns();
+
  private:
-  ReadResult ReadRawValues(const TimeRange& time_range) const;
+  ReadColumn ReadColumns(const TimeRange& time_range,
+                         ColumnType column_type) const;
+  ReadColumn ReadRawValues(const TimeRange& time_range) const;
+  // column of sorted records which are not in columns_
+  ReadColumn ReadRecords(const InputTimeSeries& records,
+                         const TimeRange& time_range,
+                         ColumnType column_type) const;
+  struct TimestampLess {
+    bool operator()(const Record& lhs, const Record& rhs) const {
+      return lhs.timestamp < rhs.timestamp;
+    }
+  };
+  // records in time order, equal timestamps keep the write order
+  using SortedRecords = std::multiset<Record, TimestampLess>;
+  ReadColumn ReadRecords(const SortedRecords& records,
+                         const TimeRange& time_range,
+                         ColumnType column_type) const;
+  // writes buffered records older than `boundary` to the columns
+  void Seal(TimePoint boundary);
+  // writes sorted records that are not older than last_sealed_ to columns_
+  void WriteSealed(const InputTimeSeries& time_series);
+  // writes behind_ to the columns, raw columns are rebuilt, so it's done
+  // once per flush
+  void MergeBehind();
+  // empty columns of the same types as columns_
+  Columns CreateColumns() const;
 
   size_t GetBytesSize() const;
 
   Columns columns_;
   Options options_;
+  // sorted records of the lateness window, not written to columns_ yet
+  InputTimeSeries pending_;
+  // records older than the newest one in columns_, but not older than the
+  // memtable
+  SortedRecords behind_;
+  // records older than floor_
+  SortedRecords late_;
+  // the newest timestamp ever written
+  std::optional<TimePoint> watermark_;
+  // records older than floor_ are late, it's set once records are handed to
+  // the levels
+  std::optional<TimePoint> floor_;
+  // the newest timestamp written to columns_
+  std::optional<TimePoint> last_sealed_;
+  // the newest timestamp handed to the levels by ExtractColumns or
+  // ExtractLateColumns
+  std::optional<TimePoint> persisted_last_;
 };
 
 }  // namespace tskv
@@ -3,15 +3,24 @@
 #include "model/column.h"
 #include "model/model.h"
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
+#include <mutex>
 #include <ranges>
+#include <utility>
 
 namespace tskv {
 
 MetricStorage::MetricStorage(const Options& options)
     : memtable_(options.memtable_options, options.metric_options),
-      persistent_storage_manager_(options.persistent_storage_manager_options) {}
+      persistent_storage_manager_(options.persistent_storage_manager_options),
+      flush_executor_(options.flush_executor) {}
+
+MetricStorage::~MetricStorage() {
+  std::unique_lock lock(mutex_);
+  frozen_flushed_.wait(lock, [this] { return !flushing_; });
+}
 
 Column MetricStorage::Read(const TimeRange& time_range,
                            AggregationType aggregation_type) const {
@@ -28,12 +37,16 @@ Column MetricStorage::Read(const TimeRange& time_range,
   }
 
   auto stored_aggregation = ToStoredAggregationType(aggregation_type);
-  auto [found, not_found] = memtable_.Read(time_range, stored_aggregation);
+  auto [found, not_found, late] =
+      memtable_.Read(time_range, stored_aggregation);
 
   Column column;
   if (not_found) {
-    column = persistent_storage_manager_.Read(*not_found, stored_aggregation);
+    column = ReadStored(*not_found, stored_aggregation);
   }
+  // late records of the memtable are older than the found ones
+  column = MergeUnordered(std::static_pointer_cast<IReadColumn>(column),
+                          std::static_pointer_cast<IReadColumn>(late));
 
   Column result = column;
   if (!result) {
@@ -44,16 +57,26 @@ Column MetricStorage::Read(const TimeRange& time_range,
   return result;
 }
 
-void MetricStorage::Write(const InputTimeSeries& time_series) {
-  memtable_.Write(time_series);
-
-  if (memtable_.NeedFlush()) {
-    Flush();
+Column MetricStorage::ReadStored(
+    const TimeRange& time_range,
+    StoredAggregationType aggregation_type) const {
+  std::shared_lock lock(mutex_);
+  auto column = persistent_storage_manager_.Read(time_range, aggregation_type);
+  if (!frozen_) {
+    return column;
   }
+  // late records may already be in the levels for the time range of the
+  // frozen memtable, so both are read over the whole range
+  auto [frozen_column, _, late] = frozen_->Read(time_range, aggregation_type);
+  column = MergeUnordered(std::static_pointer_cast<IReadColumn>(column),
+                          std::static_pointer_cast<IReadColumn>(late));
+  return MergeUnordered(std::static_pointer_cast<IReadColumn>(column),
+                        std::static_pointer_cast<IReadColumn>(frozen_column));
 }
 
-void MetricStorage::Flush() {
-  auto columns = memtable_.ExtractColumns();
+namespace {
+
+SerializableColumns ToSerializable(Columns columns) {
   SerializableColumns serializable_columns;
   serializable_columns.reserve(columns.size());
   for (auto& column : columns) {
@@ -62,7 +85,124 @@ void MetricStorage::Flush() {
     assert(serializable_column);
     serializable_columns.emplace_back(std::move(serializable_column));
   }
-  persistent_storage_manager_.Write(serializable_columns);
+  return serializable_columns;
+}
+
+}  // namespace
+
+void MetricStorage::Write(const InputTimeSeries& time_series,
+                          std::optional<uint64_t> lsn) {
+  {
+    std::shared_lock lock(mutex_);
+    // the frozen memtable is kept until Flush retries it
+    if (flush_error_) {
+      std::rethrow_exception(flush_error_);
+    }
+  }
+  memtable_.Write(time_series);
+  // concurrent logged writes may come out of lsn order
+  if (lsn && (!memtable_lsn_ || *lsn < *memtable_lsn_)) {
+    memtable_lsn_ = lsn;
+  }
+
+  if (memtable_.NeedFlush()) {
+    if (flush_executor_) {
+      FreezeMemtable();
+    } else {
+      Flush();
+    }
+  }
+}
+
+void MetricStorage::Flush() {
+  {
+    std::unique_lock lock(mutex_);
+    frozen_flushed_.wait(lock, [this] { return !flushing_; });
+    if (frozen_) {
+      // background flush failed, retry it
+      auto write = persistent_storage_manager_.PrepareWrite(
+          frozen_->GetColumns(), ToSerializable(frozen_->GetLateColumns()));
+      persistent_storage_manager_.Write(std::move(write));
+      frozen_.reset();
+      frozen_lsn_.reset();
+      flush_error_ = nullptr;
+    }
+    // late records are buffered by the memtable until the flush, so that
+    // every flush adds at most one late page per column
+    auto write = persistent_storage_manager_.PrepareWrite(
+        ToSerializable(memtable_.ExtractColumns()),
+        ToSerializable(memtable_.ExtractLateColumns()));
+    persistent_storage_manager_.Write(std::move(write));
+    memtable_lsn_.reset();
+  }
+  // without the compaction scheduler levels are merged here, reads don't
+  // wait for it
+  persistent_storage_manager_.Compact();
+}
+
+std::optional<uint64_t> MetricStorage::GetFirstUnflushedLsn() const {
+  std::shared_lock lock(mutex_);
+  if (!frozen_lsn_ || !memtable_lsn_) {
+    return frozen_lsn_ ? frozen_lsn_ : memtable_lsn_;
+  }
+  return std::min(*frozen_lsn_, *memtable_lsn_);
+}
+
+void MetricStorage::FreezeMemtable() {
+  std::unique_lock lock(mutex_);
+  // only one memtable may be frozen, so writes wait for the previous flush
+  WaitFrozen(lock);
+  frozen_ = memtable_.Freeze();
+  frozen_lsn_ = std::exchange(memtable_lsn_, std::nullopt);
+  flushing_ = true;
+  flush_executor_->Submit([this] { FlushFrozen(); });
+}
+
+void MetricStorage::FlushFrozen() {
+  // frozen_ changes only after the flush, so its pages are encoded and
+  // stored without the lock, reads and late writes wait only while they are
+  // added to the level
+  std::optional<Level::PendingWrite> write;
+  std::exception_ptr error;
+  try {
+    write = persistent_storage_manager_.PrepareWrite(
+        frozen_->GetColumns(), ToSerializable(frozen_->GetLateColumns()));
+  } catch (...) {
+    error = std::current_exception();
+  }
+
+  {
+    std::unique_lock lock(mutex_);
+    try {
+      if (error) {
+        std::rethrow_exception(error);
+      }
+      persistent_storage_manager_.Write(std::move(*write));
+      frozen_.reset();
+      frozen_lsn_.reset();
+    } catch (...) {
+      // frozen memtable is kept readable, the error is rethrown by the next
+      // write
+      flush_error_ = std::current_exception();
+      error = flush_error_;
+    }
+  }
+  if (!error) {
+    // without the compaction scheduler levels are merged here, after the
+    // lock is released
+    persistent_storage_manager_.Compact();
+  }
+
+  std::unique_lock lock(mutex_);
+  flushing_ = false;
+  frozen_flushed_.notify_all();
+}
+
+void MetricStorage::WaitFrozen(std::unique_lock<std::shared_mutex>& lock) {
+  frozen_flushed_.wait(lock, [this] { return !flushing_; });
+  if (flush_error_) {
+    std::rethrow_exception(flush_error_);
+  }
 }
 
 }  // namespace tskv
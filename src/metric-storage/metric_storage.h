@@ -1,6 +1,12 @@
 #pragma once
 
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
 #include <memory>
+#include <optional>
+#include <shared_mutex>
+#include "executor/background_executor.h"
 #include "memtable/memtable.h"
 #include "model/aggregations.h"
 #include "model/model.h"
@@ -19,18 +25,56 @@ class MetricStorage {
     Memtable::Options memtable_options;
 
     PersistentStorageManager::Options persistent_storage_manager_options;
+    // if set, full memtables are frozen and flushed by this executor, while a
+    // new memtable takes writes. Otherwise they are flushed inside Write
+    std::shared_ptr<BackgroundExecutor> flush_executor;
   };
 
  public:
   explicit MetricStorage(const Options& options);
+  // waits for the background flush
+  ~MetricStorage();
+  // Write and Flush must not be called concurrently with any other method,
+  // Read may be called concurrently with other reads
   Column Read(const TimeRange& time_range,
               AggregationType aggregation_type) const;
-  void Write(const InputTimeSeries& time_series);
+  // lsn is the sequence number of the write in the write-ahead log, if it
+  // was logged. Rethrows the error of the failed background flush until
+  // Flush retries it
+  void Write(const InputTimeSeries& time_series,
+             std::optional<uint64_t> lsn = std::nullopt);
+  // flushes synchronously, including the frozen memtable
   void Flush();
+  // lsn of the oldest logged write which records are not flushed yet, the
+  // log must be kept from it
+  std::optional<uint64_t> GetFirstUnflushedLsn() const;
+
+ private:
+  // reads the frozen memtable and the levels
+  Column ReadStored(const TimeRange& time_range,
+                    StoredAggregationType aggregation_type) const;
+  void FreezeMemtable();
+  void FlushFrozen();
+  // waits until the background flush is finished, rethrows its error
+  void WaitFrozen(std::unique_lock<std::shared_mutex>& lock);
 
  private:
   Memtable memtable_;
+  std::optional<uint64_t> memtable_lsn_;
   PersistentStorageManager persistent_storage_manager_;
+  std::shared_ptr<BackgroundExecutor> flush_executor_;
+
+  // guards frozen_, frozen_lsn_, flushing_, flush_error_ and writes to
+  // persistent_storage_manager_, frozen memtable is reset in the same
+  // critical section in which its pages are added to the levels, so that
+  // reads see its records exactly once
+  mutable std::shared_mutex mutex_;
+  std::condition_variable_any frozen_flushed_;
+  // the background flush, including the compaction after it, is running
+  bool flushing_{false};
+  std::shared_ptr<const Memtable> frozen_;
+  std::optional<uint64_t> frozen_lsn_;
+  std::exception_ptr flush_error_;
 };
 
 }  // namespace tskv
@@ -0,0 +1,148 @@
+#include "bitmap.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <utility>
+
+namespace tskv {
+
+namespace {
+
+uint64_t LowMask(size_t bits) {
+  return bits >= Bitmap::kWordBits ? ~uint64_t{0} : (uint64_t{1} << bits) - 1;
+}
+
+}  // namespace
+
+Bitmap::Bitmap(size_t size, bool value) {
+  Resize(size, value);
+}
+
+Bitmap::Bitmap(SharedVector<uint64_t> words, size_t size)
+    : words_(std::move(words)), size_(size) {
+  assert(words_.Size() == WordsNum(size));
+}
+
+void Bitmap::Set(size_t idx, bool value) {
+  assert(idx < size_);
+  auto* words = MutableWords();
+  auto mask = uint64_t{1} << (idx % kWordBits);
+  if (value) {
+    words[idx / kWordBits] |= mask;
+  } else {
+    words[idx / kWordBits] &= ~mask;
+  }
+}
+
+size_t Bitmap::Count(size_t begin, size_t end) const {
+  assert(begin <= end && end <= size_);
+  size_t res = 0;
+  for (auto pos = begin; pos < end; pos += kWordBits) {
+    auto bits = std::min(end - pos, kWordBits);
+    res += std::popcount(GetWord(pos) & LowMask(bits));
+  }
+  return res;
+}
+
+Bitmap Bitmap::Slice(size_t begin, size_t end) const {
+  assert(begin <= end && end <= size_);
+  Bitmap res;
+  if (begin == end) {
+    return res;
+  }
+  auto first = offset_ + begin;
+  auto last = offset_ + end;
+  res.words_ = words_.Slice(first / kWordBits, WordsNum(last));
+  res.offset_ = first % kWordBits;
+  res.size_ = end - begin;
+  return res;
+}
+
+void Bitmap::Resize(size_t size, bool value) {
+  if (size <= size_) {
+    Detach();
+    size_ = size;
+    words_.Resize(WordsNum(size));
+    if (size % kWordBits != 0) {
+      words_.MutableData()[size / kWordBits] &= LowMask(size % kWordBits);
+    }
+    return;
+  }
+  auto word = value ? ~uint64_t{0} : 0;
+  while (size_ < size) {
+    AppendBits(word, std::min(size - size_, kWordBits));
+  }
+}
+
+void Bitmap::Append(const Bitmap& other) {
+  if (this == &other) {
+    auto copy = other;
+    Append(copy);
+    return;
+  }
+  for (size_t pos = 0; pos < other.size_; pos += kWordBits) {
+    AppendBits(other.GetWord(pos), std::min(other.size_ - pos, kWordBits));
+  }
+}
+
+std::vector<uint64_t> Bitmap::ToWords() const {
+  if (offset_ == 0) {
+    auto res = words_.ToVector();
+    // slices may have bits of the source after the end
+    if (size_ % kWordBits != 0) {
+      res.back() &= LowMask(size_ % kWordBits);
+    }
+    return res;
+  }
+  std::vector<uint64_t> res;
+  res.reserve(WordsNum(size_));
+  for (size_t pos = 0; pos < size_; pos += kWordBits) {
+    res.push_back(GetWord(pos));
+  }
+  return res;
+}
+
+uint64_t* Bitmap::MutableWords() {
+  Detach();
+  return words_.MutableData();
+}
+
+uint64_t Bitmap::GetWord(size_t pos) const {
+  assert(pos < size_);
+  auto bit = offset_ + pos;
+  auto idx = bit / kWordBits;
+  auto shift = bit % kWordBits;
+  auto word = words_[idx] >> shift;
+  if (shift != 0 && idx + 1 < words_.Size()) {
+    word |= words_[idx + 1] << (kWordBits - shift);
+  }
+  return word & LowMask(size_ - pos);
+}
+
+void Bitmap::AppendBits(uint64_t word, size_t bits) {
+  assert(bits > 0 && bits <= kWordBits);
+  word &= LowMask(bits);
+  Detach();
+  auto shift = size_ % kWordBits;
+  if (shift == 0) {
+    words_.PushBack(word);
+  } else {
+    words_.MutableData()[size_ / kWordBits] |= word << shift;
+    if (shift + bits > kWordBits) {
+      words_.PushBack(word >> (kWordBits - shift));
+    }
+  }
+  size_ += bits;
+}
+
+void Bitmap::Detach() {
+  if (offset_ == 0 && !words_.IsShared()) {
+    return;
+  }
+  auto words = ToWords();
+  words_ = std::move(words);
+  offset_ = 0;
+}
+
+}  // namespace tskv
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "model/shared_vector.h"
+
+namespace tskv {
+
+// Bitset of fixed size, stored in 64-bit words. Like SharedVector, slices
+// share words with the source bitmap (they start at an arbitrary bit of the
+// first word) and are repacked on the first mutation.
+class Bitmap {
+ public:
+  static constexpr size_t kWordBits = 64;
+
+ public:
+  Bitmap() = default;
+  Bitmap(size_t size, bool value);
+  // bits after size in the last word must be zero
+  Bitmap(SharedVector<uint64_t> words, size_t size);
+
+  size_t Size() const { return size_; }
+  bool Empty() const { return size_ == 0; }
+
+  bool Get(size_t idx) const {
+    auto pos = offset_ + idx;
+    return (words_[pos / kWordBits] >> (pos % kWordBits)) & 1;
+  }
+  void Set(size_t idx, bool value = true);
+
+  // number of set bits in [begin, end)
+  size_t Count(size_t begin, size_t end) const;
+  size_t Count() const { return Count(0, size_); }
+  bool All() const { return Count() == size_; }
+  bool None() const { return Count() == 0; }
+
+  // [begin, end), shares words with this bitmap
+  Bitmap Slice(size_t begin, size_t end) const;
+  void Resize(size_t size, bool value = false);
+  void Append(const Bitmap& other);
+
+  // words of bitmap with the first bit at the lowest bit of the first word
+  std::vector<uint64_t> ToWords() const;
+  // repacks bitmap if it's shared, so that bits can be set directly
+  uint64_t* MutableWords();
+
+  static size_t WordsNum(size_t size) {
+    return (size + kWordBits - 1) / kWordBits;
+  }
+
+ private:
+  // bits [pos, pos + 64) of the view, bits after the end are zero
+  uint64_t GetWord(size_t pos) const;
+  // appends lowest `bits` bits of `word`
+  void AppendBits(uint64_t word, size_t bits);
+  void Detach();
+
+ private:
+  SharedVector<uint64_t> words_;
+  // index of the first bit in words_
+  size_t offset_{0};
+  size_t size_{0};
+};
+
+}  // namespace tskv
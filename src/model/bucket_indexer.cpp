@@ -0,0 +1,24 @@
+#include "bucket_indexer.h"
+
+#include <bit>
+#include <cassert>
+
+namespace tskv {
+
+BucketIndexer::BucketIndexer(Duration bucket_interval)
+    : bucket_interval_(bucket_interval) {
+  assert(bucket_interval_ != 0);
+  if (std::has_single_bit(bucket_interval_)) {
+    shift_ = std::countr_zero(bucket_interval_);
+    return;
+  }
+  // l = ceil(log2(d)), m = 2^64 * (2^l - d) / d + 1, so that
+  // n / d = (((n - mulhi(m, n)) >> 1) + mulhi(m, n)) >> (l - 1)
+  uint32_t log = 64 - std::countl_zero(bucket_interval_ - 1);
+  auto power = static_cast<unsigned __int128>(1) << log;
+  multiplier_ = static_cast<uint64_t>(
+      ((power - bucket_interval_) << 64) / bucket_interval_ + 1);
+  shift_ = log - 1;
+}
+
+}  // namespace tskv
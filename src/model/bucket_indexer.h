@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+
+#include "model/model.h"
+
+namespace tskv {
+
+// Maps timestamps to bucket indices without hardware division. Power of two
+// intervals use a shift, others multiply by a precomputed reciprocal
+// (round-up method from Granlund & Montgomery, the one libdivide uses), which
+// is exact for every 64-bit value.
+class BucketIndexer {
+ public:
+  explicit BucketIndexer(Duration bucket_interval);
+
+  Duration GetBucketInterval() const { return bucket_interval_; }
+
+  // value / bucket_interval
+  uint64_t Divide(uint64_t value) const {
+    if (multiplier_ == 0) {
+      return value >> shift_;
+    }
+    auto high = static_cast<uint64_t>(
+        (static_cast<unsigned __int128>(value) * multiplier_) >> 64);
+    return (((value - high) >> 1) + high) >> shift_;
+  }
+
+  // value % bucket_interval
+  uint64_t Mod(uint64_t value) const {
+    return value - Divide(value) * bucket_interval_;
+  }
+
+  // start of the bucket that contains timestamp
+  TimePoint AlignDown(TimePoint timestamp) const {
+    return timestamp - Mod(timestamp);
+  }
+
+  size_t GetBucketIdx(TimePoint start_time, TimePoint timestamp) const {
+    return Divide(timestamp - start_time);
+  }
+
+ private:
+  uint64_t bucket_interval_;
+  // zero for power of two intervals
+  uint64_t multiplier_{0};
+  uint32_t shift_{0};
+};
+
+}  // namespace tskv
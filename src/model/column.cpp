@@ -1,922 +1,907 @@
 #include "column.h"
 
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <cstring>
 #include <cwchar>
+#include <iterator>
 #include <ranges>
+#include <span>
 #include <stdexcept>
+#include <string>
+#include <type_traits>
 #include <utility>
 
 namespace tskv {
 
-AggregateColumn::AggregateColumn(Duration bucket_interval)
-    : bucket_interval_(bucket_interval) {}
+namespace {
 
-AggregateColumn::AggregateColumn(std::vector<double> buckets,
-                                 const TimePoint& start_time,
-                                 Duration bucket_interval)
-    : buckets_(std::move(buckets)),
-      start_time_(start_time),
-      bucket_interval_(bucket_interval) {
-  auto time_range = GetTimeRange();
-  assert(buckets_.size() ==
-         (time_range.end - time_range.start + bucket_interval_ - 1) /
-             bucket_interval_);
-  assert(start_time % bucket_interval_ == 0);
-}
-
-ReadColumn AggregateColumn::Read(const TimeRange& time_range,
-                                 ColumnType column_type) const {
-  if (buckets_.empty()) {
-    return std::shared_ptr<SumColumn>(nullptr);
-  }
-  auto start_bucket = *GetBucketIdx(time_range.start);
-  auto end_bucket = *GetBucketIdx(time_range.end);
-  if (end_bucket < buckets_.size() && time_range.end % bucket_interval_ != 0) {
-    ++end_bucket;
-  }
-  if (start_bucket == end_bucket) {
-    return std::shared_ptr<SumColumn>(nullptr);
-  }
-  auto new_start_time = start_time_;
-  if (time_range.start > start_time_) {
-    new_start_time =
-        time_range.start - (time_range.start - start_time_) % bucket_interval_;
-  }
-  auto data = std::vector<double>(buckets_.begin() + start_bucket,
-                                  buckets_.begin() + end_bucket);
-  switch (column_type) {
-    case ColumnType::kSum: {
-      return std::make_shared<SumColumn>(std::move(data), new_start_time,
-                                         bucket_interval_);
-    }
-    case ColumnType::kCount: {
-      return std::make_shared<CountColumn>(std::move(data), new_start_time,
-                                           bucket_interval_);
-    }
-    case ColumnType::kMin: {
-      return std::make_shared<MinColumn>(std::move(data), new_start_time,
-                                         bucket_interval_);
-    }
-    case ColumnType::kMax: {
-      return std::make_shared<MaxColumn>(std::move(data), new_start_time,
-                                         bucket_interval_);
-    }
-    case ColumnType::kLast: {
-      return std::make_shared<LastColumn>(std::move(data), new_start_time,
-                                          bucket_interval_);
-    }
-    case ColumnType::kAvg: {
-      return std::make_shared<AvgColumn>(std::move(data), new_start_time,
-                                         bucket_interval_);
-    }
-    default:
-      throw std::runtime_error("Unknown column type");
-  }
-}
+// last byte of extended aggregate format, presence bitmaps of runs are stored
+// after buckets
+constexpr uint8_t kHasPresenceFlag = 1;
+// buckets are bit-packed unsigned integers, see BitPackEncode
+constexpr uint8_t kBitPackedFlag = 2;
 
-CompressedBytes AggregateColumn::ToBytes() const {
-  CompressedBytes res;
-  Append(res, bucket_interval_);
-  Append(res, start_time_);
-  Append(res, buckets_.data(), buckets_.size());
-  return res;
-}
+// integers up to it are exact in doubles
+constexpr uint64_t kMaxExactInteger = uint64_t{1} << 53;
 
-std::optional<size_t> AggregateColumn::GetBucketIdx(TimePoint timestamp) const {
-  if (timestamp < start_time_) {
-    return 0;
-  }
+// bit-packed values follow the minimum and the width, see BitPackEncode
+constexpr size_t kBitPackHeaderBits = 64 + 7;
 
-  auto time_range = GetTimeRange();
-  if (timestamp >= time_range.end) {
-    return buckets_.size();
+// buckets that are not bit-packed are stored as doubles
+template <typename Bucket>
+void AppendBuckets(CompressedBytes& bytes,
+                   const SharedVector<Bucket>& buckets) {
+  if constexpr (std::is_same_v<Bucket, Value>) {
+    Append(bytes, buckets.Data(), buckets.Size());
+  } else {
+    std::vector<Value> values(buckets.begin(), buckets.end());
+    Append(bytes, values.data(), values.size());
   }
-
-  return (timestamp - start_time_) / bucket_interval_;
-}
-
-std::vector<Value> AggregateColumn::GetValues() const {
-  return buckets_;
 }
 
-TimeRange AggregateColumn::GetTimeRange() const {
-  return {start_time_, start_time_ + buckets_.size() * bucket_interval_};
-}
-
-Column AggregateColumn::Extract(ColumnType column_type) {
-  std::shared_ptr<IAggregateColumn> col;
-  switch (column_type) {
-    case ColumnType::kSum: {
-      col = std::make_shared<SumColumn>(std::move(buckets_), start_time_,
-                                        bucket_interval_);
-      break;
-    }
-    case ColumnType::kCount: {
-      col = std::make_shared<CountColumn>(std::move(buckets_), start_time_,
-                                          bucket_interval_);
-      break;
-    }
-    case ColumnType::kMin: {
-      col = std::make_shared<MinColumn>(std::move(buckets_), start_time_,
-                                        bucket_interval_);
-      break;
-    }
-    case ColumnType::kMax: {
-      col = std::make_shared<MaxColumn>(std::move(buckets_), start_time_,
-                                        bucket_interval_);
-      break;
-    }
-    case ColumnType::kLast: {
-      col = std::make_shared<LastColumn>(std::move(buckets_), start_time_,
-                                         bucket_interval_);
-      break;
-    }
-    default:
-      throw std::runtime_error("Type " +
-                               std::to_string(static_cast<int>(column_type)) +
-                               " is not to extract");
+template <typename Bucket>
+std::vector<Bucket> ToBuckets(std::vector<Value> values) {
+  if constexpr (std::is_same_v<Bucket, Value>) {
+    return values;
+  } else {
+    return {values.begin(), values.end()};
   }
-  buckets_ = {};
-  start_time_ = 0;
-  auto read_column = std::static_pointer_cast<IReadColumn>(col);
-  return std::static_pointer_cast<IColumn>(read_column);
 }
 
-SumColumn::SumColumn(Duration bucket_interval)
-    : column_(bucket_interval),
-      buckets_(column_.buckets_),
-      start_time_(column_.start_time_),
-      bucket_interval_(column_.bucket_interval_) {}
+}  // namespace
 
-SumColumn::SumColumn(std::vector<double> buckets, const TimePoint& start_time,
-                     Duration bucket_interval)
-    : column_(std::move(buckets), start_time, bucket_interval),
-      buckets_(column_.buckets_),
-      start_time_(column_.start_time_),
-      bucket_interval_(column_.bucket_interval_) {}
-
-ColumnType SumColumn::GetType() const {
-  return ColumnType::kSum;
-}
+template <typename Bucket>
+AggregateColumnBase<Bucket>::AggregateColumnBase(Duration bucket_interval,
+                                                 Bucket identity)
+    : bucket_interval_(bucket_interval),
+      bucket_indexer_(bucket_interval),
+      identity_(identity) {}
 
-void SumColumn::ScaleBuckets(Duration bucket_interval) {
-  if (bucket_interval == bucket_interval_) {
-    return;
+template <typename Bucket>
+AggregateColumnBase<Bucket>::AggregateColumnBase(SharedVector<Bucket> buckets,
+                                                 const TimePoint& start_time,
+                                                 Duration bucket_interval,
+                                                 Bucket identity)
+    : AggregateColumnBase(bucket_interval, identity) {
+  assert(start_time % bucket_interval_ == 0);
+  if (!buckets.Empty()) {
+    // presence of such buckets is unknown, so they are considered present
+    Bitmap presence(buckets.Size(), true);
+    runs_.push_back({start_time, std::move(buckets), std::move(presence)});
+  }
+}
+
+template <typename Bucket>
+AggregateColumnBase<Bucket>::AggregateColumnBase(
+    std::vector<BucketsRun<Bucket>> runs, Duration bucket_interval,
+    Bucket identity)
+    : runs_(std::move(runs)),
+      bucket_interval_(bucket_interval),
+      bucket_indexer_(bucket_interval),
+      identity_(identity) {
+  assert(std::ranges::all_of(runs_, [this](const auto& run) {
+    return run.start % bucket_interval_ == 0 && !run.buckets.Empty() &&
+           run.presence.Size() == run.buckets.Size();
+  }));
+  assert(std::ranges::is_sorted(runs_, {}, &BucketsRun<Bucket>::start));
+}
+
+template <typename Bucket>
+std::optional<std::pair<size_t, size_t>>
+AggregateColumnBase<Bucket>::GetBucketsRange(
+    const TimeRange& time_range) const {
+  if (runs_.empty()) {
+    return std::nullopt;
   }
-  assert(bucket_interval % bucket_interval_ == 0);
-  auto scale = bucket_interval / bucket_interval_;
-  auto new_buckets_sz = buckets_.size() / scale;
-  if (start_time_ % bucket_interval != 0 || buckets_.size() % scale != 0) {
-    ++new_buckets_sz;
-  }
-
-  double sum = 0;
-  bool updated = false;
-  size_t pos = 0;
-  for (size_t i = 0; i < buckets_.size(); ++i) {
-    sum += buckets_[i];
-    updated = true;
-    if ((start_time_ + bucket_interval_ * i) / bucket_interval !=
-        (start_time_ + bucket_interval_ * (i + 1)) / bucket_interval) {
-      buckets_[pos++] = sum;
-      sum = 0;
-      updated = false;
-    }
+  auto start_bucket = *GetBucketIdx(time_range.start);
+  auto end_bucket = *GetBucketIdx(time_range.end);
+  if (end_bucket < GetBucketsNum() &&
+      bucket_indexer_.Mod(time_range.end) != 0) {
+    ++end_bucket;
   }
-
-  if (updated) {
-    buckets_[pos++] = sum;
+  if (start_bucket == end_bucket) {
+    return std::nullopt;
   }
+  return std::make_pair(start_bucket, end_bucket);
+}
 
-  assert(pos == new_buckets_sz);
+template <typename Bucket>
+TimePoint AggregateColumnBase<Bucket>::GetBucketStart(
+    size_t bucket_idx) const {
+  return GetTimeRange().start + bucket_idx * bucket_interval_;
+}
 
-  start_time_ = start_time_ - start_time_ % bucket_interval;
-  bucket_interval_ = bucket_interval;
-  buckets_.resize(new_buckets_sz);
+template <typename Bucket>
+TimePoint AggregateColumnBase<Bucket>::GetRunEnd(
+    const BucketsRun<Bucket>& run) const {
+  return run.start + run.buckets.Size() * bucket_interval_;
 }
 
-void SumColumn::Merge(Column column) {
-  if (!column) {
-    return;
-  }
-  auto sum_column = std::dynamic_pointer_cast<SumColumn>(column);
-  if (!sum_column) {
-    throw std::runtime_error("Can't merge columns of different types");
+template <typename Bucket>
+std::vector<BucketsRun<Bucket>> AggregateColumnBase<Bucket>::SliceRuns(
+    size_t start_bucket, size_t end_bucket) const {
+  auto from = GetBucketStart(start_bucket);
+  auto to = GetBucketStart(end_bucket);
+  std::vector<BucketsRun<Bucket>> res;
+  auto it = std::ranges::partition_point(
+      runs_, [this, from](const auto& run) { return GetRunEnd(run) <= from; });
+  for (; it != runs_.end() && it->start < to; ++it) {
+    auto run_from = std::max(from, it->start);
+    auto run_to = std::min(to, GetRunEnd(*it));
+    auto begin = bucket_indexer_.Divide(run_from - it->start);
+    auto end = bucket_indexer_.Divide(run_to - it->start);
+    res.push_back({run_from, it->buckets.Slice(begin, end),
+                   it->presence.Slice(begin, end)});
   }
-  if (this == sum_column.get()) {
+  return res;
+}
+
+template <typename Bucket>
+void AggregateColumnBase<Bucket>::AppendRun(BucketsRun<Bucket> run) {
+  if (run.buckets.Empty()) {
     return;
   }
-  if (sum_column->bucket_interval_ != bucket_interval_) {
-    if (sum_column->bucket_interval_ < bucket_interval_) {
-      sum_column->ScaleBuckets(bucket_interval_);
-    } else {
-      ScaleBuckets(sum_column->bucket_interval_);
-    }
-  }
-  if (buckets_.empty()) {
-    buckets_ = sum_column->buckets_;
-    start_time_ = sum_column->start_time_;
+  if (runs_.empty()) {
+    runs_.push_back(std::move(run));
     return;
   }
-  if (sum_column->buckets_.empty()) {
+  auto& last = runs_.back();
+  auto last_end = GetRunEnd(last);
+  assert(run.start >= last_end);
+  auto gap = bucket_indexer_.Divide(run.start - last_end);
+  if (gap >= kMinSparseGap) {
+    runs_.push_back(std::move(run));
     return;
   }
-  if (sum_column->start_time_ < start_time_) {
-    throw std::runtime_error("Wrong merge order");
-  }
-
-  auto sum_column_time_range = sum_column->GetTimeRange();
-  auto intersection_start_opt =
-      column_.GetBucketIdx(sum_column_time_range.start);
-  auto intersection_end_opt = column_.GetBucketIdx(sum_column_time_range.end);
-  auto intersection_end =
-      intersection_end_opt ? *intersection_end_opt : buckets_.size();
-  auto intersection_start =
-      intersection_end_opt ? *intersection_start_opt : buckets_.size();
-  for (size_t i = intersection_start; i < intersection_end; ++i) {
-    buckets_[i] += sum_column->buckets_[i - intersection_start];
-  }
-
-  auto cur_time_range = GetTimeRange();
-  if (sum_column->start_time_ > cur_time_range.end) {
-    auto to_insert_zeroes =
-        (sum_column->start_time_ - cur_time_range.end) / bucket_interval_;
-    for (size_t i = 0; i < to_insert_zeroes; ++i) {
-      buckets_.push_back(0);
+  last.buckets.Resize(last.buckets.Size() + gap, identity_);
+  last.buckets.Append(run.buckets);
+  last.presence.Resize(last.presence.Size() + gap, false);
+  last.presence.Append(run.presence);
+}
+
+template <typename Bucket>
+BucketsRun<Bucket>& AggregateColumnBase<Bucket>::DensifyRange(TimePoint from,
+                                                              TimePoint to) {
+  assert(from < to && from % bucket_interval_ == 0);
+  auto first = std::ranges::partition_point(
+      runs_, [this, from](const auto& run) { return GetRunEnd(run) <= from; });
+  auto last = std::partition_point(
+      first, runs_.end(), [to](const auto& run) { return run.start < to; });
+  if (last - first == 1 && first->start <= from && GetRunEnd(*first) >= to) {
+    return *first;
+  }
+
+  auto start = first == last ? from : std::min(first->start, from);
+  auto end = first == last ? to : std::max(GetRunEnd(*(last - 1)), to);
+  std::vector<Bucket> buckets(bucket_indexer_.Divide(end - start), identity_);
+  Bitmap presence;
+  for (auto it = first; it != last; ++it) {
+    auto offset = bucket_indexer_.Divide(it->start - start);
+    std::ranges::copy(it->buckets, buckets.begin() + offset);
+    presence.Resize(offset, false);
+    presence.Append(it->presence);
+  }
+  presence.Resize(buckets.size(), false);
+  BucketsRun<Bucket> run{start, std::move(buckets), std::move(presence)};
+  if (first == last) {
+    first = runs_.insert(first, std::move(run));
+  } else {
+    *first = std::move(run);
+    first = runs_.erase(first + 1, last) - 1;
+  }
+  return *first;
+}
+
+template <typename Bucket>
+CompressedBytes AggregateColumnBase<Bucket>::ToBytes() const {
+  CompressedBytes res;
+  Append(res, bucket_interval_);
+  Append(res, GetTimeRange().start);
+  bool all_present = std::ranges::all_of(
+      runs_, [](const auto& run) { return run.presence.All(); });
+  bool plain = !IsSparse() && all_present;
+  bool bit_packed = false;
+  CompressedBytes packed;
+  if constexpr (std::is_integral_v<Bucket>) {
+    if (!runs_.empty()) {
+      std::vector<uint64_t> values;
+      values.reserve(GetStoredBucketsNum());
+      for (const auto& run : runs_) {
+        values.insert(values.end(), run.buckets.begin(), run.buckets.end());
+      }
+      BitWriter writer(packed);
+      BitPackEncode(values, writer);
+      writer.Flush();
+      // keeps presence words and the flags byte at the same offsets modulo 8
+      packed.resize((packed.size() + 7) / 8 * 8, 0);
+      // short columns don't gain from packing because of the longer header,
+      // but buckets that doubles would round are packed anyway
+      bool exact = std::ranges::all_of(
+          values, [](uint64_t value) { return value <= kMaxExactInteger; });
+      bit_packed = !plain || !exact ||
+                   packed.size() + 4 * sizeof(uint64_t) + 1 <
+                       GetStoredBucketsNum() * sizeof(Value);
     }
   }
-
-  auto to_skip = intersection_start ? intersection_end - intersection_start : 0;
-  for (const auto& val : std::views::drop(sum_column->buckets_, to_skip)) {
-    buckets_.push_back(val);
-  }
-}
-
-void SumColumn::Write(const InputTimeSeries& time_series) {
-  assert(std::ranges::is_sorted(time_series, {}, &Record::timestamp));
-  if (buckets_.empty()) {
-    start_time_ = time_series.front().timestamp -
-                  time_series.front().timestamp % bucket_interval_;
-  }
-  assert(start_time_ % bucket_interval_ == 0);
-  assert(time_series.front().timestamp >= start_time_);
-  auto needed_size =
-      (time_series.back().timestamp + 1 - start_time_ + bucket_interval_ - 1) /
-      bucket_interval_;
-  buckets_.resize(needed_size);
-  for (const auto& record : time_series) {
-    auto idx = *column_.GetBucketIdx(record.timestamp);
-    buckets_[idx] += record.value;
-  }
-}
-
-ReadColumn SumColumn::Read(const TimeRange& time_range) const {
-  return column_.Read(time_range, ColumnType::kSum);
-}
-
-std::vector<Value> SumColumn::GetValues() const {
-  return column_.GetValues();
-}
-
-TimeRange SumColumn::GetTimeRange() const {
-  return column_.GetTimeRange();
-}
-
-Column SumColumn::Extract() {
-  return column_.Extract(ColumnType::kSum);
-}
-
-CompressedBytes SumColumn::ToBytes() const {
-  return column_.ToBytes();
-}
-
-size_t SumColumn::GetBucketsNum() const {
-  return buckets_.size();
-}
-
-CountColumn::CountColumn(Duration bucket_interval)
-    : column_(bucket_interval),
-      buckets_(column_.buckets_),
-      start_time_(column_.start_time_),
-      bucket_interval_(column_.bucket_interval_) {}
-
-CountColumn::CountColumn(std::vector<double> buckets,
-                         const TimePoint& start_time, Duration bucket_interval)
-    : column_(std::move(buckets), start_time, bucket_interval),
-      buckets_(column_.buckets_),
-      start_time_(column_.start_time_),
-      bucket_interval_(column_.bucket_interval_) {}
-
-ColumnType CountColumn::GetType() const {
-  return ColumnType::kCount;
-}
-
-void CountColumn::ScaleBuckets(Duration bucket_interval) {
-  if (bucket_interval == bucket_interval_) {
-    return;
-  }
-  assert(bucket_interval % bucket_interval_ == 0);
-  auto scale = bucket_interval / bucket_interval_;
-  auto new_buckets_sz = buckets_.size() / scale;
-  if (start_time_ % bucket_interval != 0 || buckets_.size() % scale != 0) {
-    ++new_buckets_sz;
-  }
-
-  size_t count = 0;
-  bool updated = false;
-  size_t pos = 0;
-  for (size_t i = 0; i < buckets_.size(); ++i) {
-    count += buckets_[i];
-    updated = true;
-    if ((start_time_ + bucket_interval_ * i) / bucket_interval !=
-        (start_time_ + bucket_interval_ * (i + 1)) / bucket_interval) {
-      buckets_[pos++] = count;
-      count = 0;
-      updated = false;
+  if (plain && !bit_packed) {
+    for (const auto& run : runs_) {
+      AppendBuckets(res, run.buckets);
+    }
+    return res;
+  }
+  // sparse, bit-packed columns and columns with absent buckets end with a
+  // flags byte, so their size is never multiple of bucket size, that's how
+  // ParseAggregateBytes distinguishes them
+  Append(res, static_cast<uint64_t>(runs_.size()));
+  for (const auto& run : runs_) {
+    Append(res, static_cast<uint64_t>(
+                    bucket_indexer_.Divide(run.start - GetTimeRange().start)));
+    Append(res, static_cast<uint64_t>(run.buckets.Size()));
+  }
+  uint8_t flags = 0;
+  if (bit_packed) {
+    flags |= kBitPackedFlag;
+    Append(res, static_cast<uint64_t>(packed.size()));
+    res.insert(res.end(), packed.begin(), packed.end());
+  } else {
+    for (const auto& run : runs_) {
+      AppendBuckets(res, run.buckets);
     }
   }
-
-  if (updated) {
-    buckets_[pos++] = count;
+  if (!all_present) {
+    flags |= kHasPresenceFlag;
+    for (const auto& run : runs_) {
+      auto words = run.presence.ToWords();
+      Append(res, words.data(), words.size());
+    }
   }
-
-  assert(pos == new_buckets_sz);
-
-  start_time_ = start_time_ - start_time_ % bucket_interval;
-  bucket_interval_ = bucket_interval;
-  buckets_.resize(new_buckets_sz);
+  res.push_back(flags);
+  return res;
 }
 
-void CountColumn::Merge(Column column) {
-  if (!column) {
-    return;
-  }
-  auto count_column = std::dynamic_pointer_cast<CountColumn>(column);
-  if (!count_column) {
-    throw std::runtime_error("Can't merge columns of different types");
-  }
-  if (this == count_column.get()) {
-    return;
-  }
-  if (count_column->bucket_interval_ != bucket_interval_) {
-    if (count_column->bucket_interval_ < bucket_interval_) {
-      count_column->ScaleBuckets(bucket_interval_);
+template <typename Bucket>
+std::pair<Duration, std::vector<BucketsRun<Bucket>>> ParseAggregateBytes(
+    BytesView bytes) {
+  auto reader = CompressedBytesReader(bytes);
+  auto bucket_interval = reader.Read<size_t>();
+  auto start = reader.Read<TimePoint>();
+  std::vector<BucketsRun<Bucket>> runs;
+  if (bytes.size() % sizeof(Value) == 0) {
+    auto buckets = ToBuckets<Bucket>(reader.ReadAll<Value>());
+    if (!buckets.empty()) {
+      Bitmap presence(buckets.size(), true);
+      runs.push_back({start, std::move(buckets), std::move(presence)});
+    }
+    return {bucket_interval, std::move(runs)};
+  }
+  auto runs_num = reader.Read<uint64_t>();
+  std::vector<std::pair<uint64_t, uint64_t>> offsets;
+  for (uint64_t i = 0; i < runs_num; ++i) {
+    auto offset = reader.Read<uint64_t>();
+    auto size = reader.Read<uint64_t>();
+    offsets.emplace_back(offset, size);
+  }
+  auto flags = bytes.back();
+  std::vector<uint64_t> values;
+  if (flags & kBitPackedFlag) {
+    auto packed = reader.ReadBytes(reader.Read<uint64_t>());
+    BitReader bit_reader(packed.data(), packed.size());
+    uint64_t values_num = 0;
+    for (auto [offset, size] : offsets) {
+      values_num += size;
+    }
+    BitPackDecode(bit_reader, values_num, values);
+  }
+  auto value = values.begin();
+  for (auto [offset, size] : offsets) {
+    std::vector<Bucket> buckets;
+    if (flags & kBitPackedFlag) {
+      buckets.assign(value, value + size);
+      value += size;
     } else {
-      ScaleBuckets(count_column->bucket_interval_);
+      buckets = ToBuckets<Bucket>(reader.Read<Value>(size));
+    }
+    runs.push_back({start + offset * bucket_interval, std::move(buckets),
+                    Bitmap(size, true)});
+  }
+  if (flags & kHasPresenceFlag) {
+    for (auto& run : runs) {
+      auto size = run.buckets.Size();
+      run.presence = Bitmap(reader.Read<uint64_t>(Bitmap::WordsNum(size)),
+                            size);
     }
   }
-  if (buckets_.empty()) {
-    buckets_ = count_column->buckets_;
-    start_time_ = count_column->start_time_;
-    return;
-  }
-  if (count_column->buckets_.empty()) {
-    return;
+  return {bucket_interval, std::move(runs)};
+}
+
+template std::pair<Duration, std::vector<BucketsRun<double>>>
+ParseAggregateBytes<double>(BytesView bytes);
+template std::pair<Duration, std::vector<BucketsRun<uint64_t>>>
+ParseAggregateBytes<uint64_t>(BytesView bytes);
+
+std::optional<AggregateIndex> IndexAggregateBytes(BytesView bytes) {
+  if (bytes.size() % sizeof(Value) == 0) {
+    return std::nullopt;
+  }
+  auto reader = CompressedBytesReader(bytes);
+  AggregateIndex index;
+  index.bucket_interval = reader.Read<size_t>();
+  index.start = reader.Read<TimePoint>();
+  auto runs_num = reader.Read<uint64_t>();
+  uint64_t buckets_num = 0;
+  for (uint64_t i = 0; i < runs_num; ++i) {
+    auto offset = reader.Read<uint64_t>();
+    auto size = reader.Read<uint64_t>();
+    index.runs.push_back({offset, size});
+    buckets_num += size;
+  }
+  auto flags = bytes.back();
+  index.bit_packed = flags & kBitPackedFlag;
+  if (index.bit_packed) {
+    auto packed_size = reader.Read<uint64_t>();
+    index.buckets_offset = bytes.size() - reader.Remaining();
+    auto packed = reader.ReadBytes(packed_size);
+    if (buckets_num > 0) {
+      BitReader bit_reader(packed.data(), packed.size());
+      index.packed_min = bit_reader.Read(64);
+      index.packed_width = static_cast<int>(bit_reader.Read(7));
+    }
+  } else {
+    index.buckets_offset = bytes.size() - reader.Remaining();
+    reader.ReadBytes(buckets_num * sizeof(Value));
+  }
+  if (flags & kHasPresenceFlag) {
+    index.presence_offset = bytes.size() - reader.Remaining();
+  }
+  return index;
+}
+
+CompressedBytes ReadAggregateRange(const AggregateIndex& index,
+                                   const TimeRange& time_range,
+                                   const ReadBytesRange& read_range) {
+  // stored buckets [begin, end) of the run which intersect the time range
+  struct Part {
+    size_t run;
+    uint64_t begin;
+    uint64_t end;
+  };
+  size_t bucket_interval = index.bucket_interval;
+  std::vector<Part> parts;
+  // indexes of the first bucket and of the first presence word of every run
+  std::vector<uint64_t> first_buckets;
+  std::vector<uint64_t> first_words;
+  uint64_t buckets_num = 0;
+  uint64_t words_num = 0;
+  for (size_t i = 0; i < index.runs.size(); ++i) {
+    auto [offset, size] = index.runs[i];
+    first_buckets.push_back(buckets_num);
+    first_words.push_back(words_num);
+    buckets_num += size;
+    words_num += Bitmap::WordsNum(size);
+    auto run_start = index.start + offset * bucket_interval;
+    uint64_t begin = 0;
+    if (time_range.start > run_start) {
+      begin = (time_range.start - run_start) / bucket_interval;
+    }
+    uint64_t end = 0;
+    if (time_range.end > run_start) {
+      end = std::min<uint64_t>(
+          size, (time_range.end - run_start + bucket_interval - 1) /
+                    bucket_interval);
+    }
+    if (begin < end) {
+      parts.push_back({i, begin, end});
+    }
   }
-  if (count_column->start_time_ < start_time_) {
-    throw std::runtime_error("Wrong merge order");
+  if (parts.empty()) {
+    return {};
   }
 
-  auto count_column_time_range = count_column->GetTimeRange();
-  auto intersection_start_opt =
-      column_.GetBucketIdx(count_column_time_range.start);
-  auto intersection_end_opt = column_.GetBucketIdx(count_column_time_range.end);
-  auto intersection_end =
-      intersection_end_opt ? *intersection_end_opt : buckets_.size();
-  auto intersection_start =
-      intersection_end_opt ? *intersection_start_opt : buckets_.size();
-  for (size_t i = intersection_start; i < intersection_end; ++i) {
-    buckets_[i] += count_column->buckets_[i - intersection_start];
-  }
-
-  auto cur_time_range = GetTimeRange();
-  if (count_column->start_time_ > cur_time_range.end) {
-    auto to_insert_zeroes =
-        (count_column->start_time_ - cur_time_range.end) / bucket_interval_;
-    for (size_t i = 0; i < to_insert_zeroes; ++i) {
-      buckets_.push_back(0);
+  // only the first and the last parts may be cut, so stored buckets of the
+  // parts are consecutive
+  const auto& front = parts.front();
+  const auto& back = parts.back();
+  auto first = first_buckets[front.run] + front.begin;
+  auto last = first_buckets[back.run] + back.end;
+  std::vector<uint64_t> packed;
+  std::vector<Value> values;
+  if (index.bit_packed) {
+    packed.assign(last - first, index.packed_min);
+    auto width = index.packed_width;
+    if (width > 0) {
+      auto first_bit = kBitPackHeaderBits + first * width;
+      auto last_bit = kBitPackHeaderBits + last * width;
+      auto bytes = read_range(index.buckets_offset + first_bit / 8,
+                              (last_bit + 7) / 8 - first_bit / 8);
+      BitReader bit_reader(bytes.data(), bytes.size());
+      bit_reader.Read(static_cast<int>(first_bit % 8));
+      for (auto& value : packed) {
+        value += bit_reader.Read(width);
+      }
     }
+  } else {
+    auto bytes = read_range(index.buckets_offset + first * sizeof(Value),
+                            (last - first) * sizeof(Value));
+    values = CompressedBytesReader(bytes).ReadAll<Value>();
   }
 
-  auto to_skip = intersection_start ? intersection_end - intersection_start : 0;
-  for (const auto& val : std::views::drop(count_column->buckets_, to_skip)) {
-    buckets_.push_back(val);
-  }
-}
-
-void CountColumn::Write(const InputTimeSeries& time_series) {
-  assert(std::ranges::is_sorted(time_series, {}, &Record::timestamp));
-  if (buckets_.empty()) {
-    start_time_ = time_series.front().timestamp -
-                  time_series.front().timestamp % bucket_interval_;
-  }
-  assert(start_time_ % bucket_interval_ == 0);
-  assert(time_series.front().timestamp >= start_time_);
-  auto needed_size =
-      (time_series.back().timestamp + 1 - start_time_ + bucket_interval_ - 1) /
-      bucket_interval_;
-  buckets_.resize(needed_size);
-  for (const auto& record : time_series) {
-    auto idx = *column_.GetBucketIdx(record.timestamp);
-    ++buckets_[idx];
+  CompressedBytes res;
+  auto start_bucket = index.runs[front.run].offset + front.begin;
+  Append(res, index.bucket_interval);
+  Append(res, index.start + start_bucket * bucket_interval);
+  Append(res, static_cast<uint64_t>(parts.size()));
+  for (const auto& part : parts) {
+    Append(res, index.runs[part.run].offset + part.begin - start_bucket);
+    Append(res, part.end - part.begin);
+  }
+  uint8_t flags = 0;
+  if (index.bit_packed) {
+    flags |= kBitPackedFlag;
+    CompressedBytes packed_bytes;
+    BitWriter writer(packed_bytes);
+    BitPackEncode(packed, writer);
+    writer.Flush();
+    packed_bytes.resize((packed_bytes.size() + 7) / 8 * 8, 0);
+    Append(res, static_cast<uint64_t>(packed_bytes.size()));
+    res.insert(res.end(), packed_bytes.begin(), packed_bytes.end());
+  } else {
+    Append(res, values.data(), values.size());
+  }
+  if (index.presence_offset) {
+    flags |= kHasPresenceFlag;
+    auto first_word = first_words[front.run] + front.begin / Bitmap::kWordBits;
+    auto last_word = first_words[back.run] + Bitmap::WordsNum(back.end);
+    auto words = CompressedBytesReader(
+                     read_range(*index.presence_offset +
+                                    first_word * sizeof(uint64_t),
+                                (last_word - first_word) * sizeof(uint64_t)))
+                     .ReadAll<uint64_t>();
+    for (const auto& part : parts) {
+      // fetched words of the run start at the word of the first bucket of
+      // the part, bits after the end of the run are zero
+      auto skipped = part.begin / Bitmap::kWordBits * Bitmap::kWordBits;
+      auto size = std::min<uint64_t>(
+                      index.runs[part.run].size,
+                      Bitmap::WordsNum(part.end) * Bitmap::kWordBits) -
+                  skipped;
+      auto from = words.begin() + first_words[part.run] +
+                  skipped / Bitmap::kWordBits - first_word;
+      Bitmap presence(
+          std::vector<uint64_t>(from, from + Bitmap::WordsNum(size)), size);
+      auto part_words =
+          presence.Slice(part.begin - skipped, part.end - skipped).ToWords();
+      Append(res, part_words.data(), part_words.size());
+    }
   }
+  res.push_back(flags);
+  return res;
 }
 
-ReadColumn CountColumn::Read(const TimeRange& time_range) const {
-  return column_.Read(time_range, ColumnType::kCount);
+template <typename Bucket>
+size_t AggregateColumnBase<Bucket>::GetBucketsNum() const {
+  auto time_range = GetTimeRange();
+  return bucket_indexer_.Divide(time_range.end - time_range.start);
 }
 
-std::vector<Value> CountColumn::GetValues() const {
-  return column_.GetValues();
+template <typename Bucket>
+size_t AggregateColumnBase<Bucket>::GetStoredBucketsNum() const {
+  size_t res = 0;
+  for (const auto& run : runs_) {
+    res += run.buckets.Size();
+  }
+  return res;
 }
 
-TimeRange CountColumn::GetTimeRange() const {
-  return column_.GetTimeRange();
+template <typename Bucket>
+bool AggregateColumnBase<Bucket>::IsSparse() const {
+  return runs_.size() > 1;
 }
 
-Column CountColumn::Extract() {
-  return column_.Extract(ColumnType::kCount);
+template <typename Bucket>
+const std::vector<BucketsRun<Bucket>>& AggregateColumnBase<Bucket>::GetRuns()
+    const {
+  return runs_;
 }
 
-CompressedBytes CountColumn::ToBytes() const {
-  return column_.ToBytes();
+template <typename Bucket>
+Duration AggregateColumnBase<Bucket>::GetBucketInterval() const {
+  return bucket_interval_;
 }
 
-size_t CountColumn::GetBucketsNum() const {
-  return buckets_.size();
+template <typename Bucket>
+const BucketIndexer& AggregateColumnBase<Bucket>::GetBucketIndexer() const {
+  return bucket_indexer_;
 }
 
-MinColumn::MinColumn(Duration bucket_interval)
-    : column_(bucket_interval),
-      buckets_(column_.buckets_),
-      start_time_(column_.start_time_),
-      bucket_interval_(column_.bucket_interval_) {}
-
-MinColumn::MinColumn(std::vector<double> buckets, const TimePoint& start_time,
-                     Duration bucket_interval)
-    : column_(std::move(buckets), start_time, bucket_interval),
-      buckets_(column_.buckets_),
-      start_time_(column_.start_time_),
-      bucket_interval_(column_.bucket_interval_) {}
-
-ColumnType MinColumn::GetType() const {
-  return ColumnType::kMin;
-}
-
-void MinColumn::ScaleBuckets(Duration bucket_interval) {
-  if (bucket_interval == bucket_interval_) {
-    return;
+template <typename Bucket>
+Bitmap AggregateColumnBase<Bucket>::GetPresence() const {
+  if (!IsSparse()) {
+    return runs_.empty() ? Bitmap{} : runs_.front().presence;
   }
-  assert(bucket_interval % bucket_interval_ == 0);
-  auto scale = bucket_interval / bucket_interval_;
-  auto new_buckets_sz = buckets_.size() / scale;
-  if (start_time_ % bucket_interval != 0 || buckets_.size() % scale != 0) {
-    ++new_buckets_sz;
-  }
-
-  double min = std::numeric_limits<double>::max();
-  bool updated = false;
-  size_t pos = 0;
-  for (size_t i = 0; i < buckets_.size(); ++i) {
-    min = std::min(min, buckets_[i]);
-    updated = true;
-    if ((start_time_ + bucket_interval_ * i) / bucket_interval !=
-        (start_time_ + bucket_interval_ * (i + 1)) / bucket_interval) {
-      buckets_[pos++] = min;
-      min = std::numeric_limits<double>::max();
-      updated = false;
-    }
+  Bitmap res;
+  auto start = GetTimeRange().start;
+  for (const auto& run : runs_) {
+    res.Resize(bucket_indexer_.Divide(run.start - start), false);
+    res.Append(run.presence);
   }
-
-  if (updated) {
-    buckets_[pos++] = min;
-  }
-
-  assert(pos == new_buckets_sz);
-
-  start_time_ = start_time_ - start_time_ % bucket_interval;
-  bucket_interval_ = bucket_interval;
-  buckets_.resize(new_buckets_sz);
+  return res;
 }
 
-void MinColumn::Merge(Column column) {
-  if (!column) {
-    return;
-  }
-  auto min_column = std::dynamic_pointer_cast<MinColumn>(column);
-  if (!min_column) {
-    throw std::runtime_error("Can't merge columns of different types");
-  }
-  if (this == min_column.get()) {
-    return;
-  }
-  if (min_column->bucket_interval_ != bucket_interval_) {
-    if (min_column->bucket_interval_ < bucket_interval_) {
-      min_column->ScaleBuckets(bucket_interval_);
-    } else {
-      ScaleBuckets(min_column->bucket_interval_);
-    }
-  }
-  if (buckets_.empty()) {
-    buckets_ = min_column->buckets_;
-    start_time_ = min_column->start_time_;
-    return;
-  }
-  if (min_column->buckets_.empty()) {
-    return;
-  }
-  if (min_column->start_time_ < start_time_) {
-    throw std::runtime_error("Wrong merge order");
-  }
-
-  auto min_column_time_range = min_column->GetTimeRange();
-  auto intersection_start_opt =
-      column_.GetBucketIdx(min_column_time_range.start);
-  auto intersection_end_opt = column_.GetBucketIdx(min_column_time_range.end);
-  auto intersection_end =
-      intersection_end_opt ? *intersection_end_opt : buckets_.size();
-  auto intersection_start =
-      intersection_end_opt ? *intersection_start_opt : buckets_.size();
-  for (size_t i = intersection_start; i < intersection_end; ++i) {
-    buckets_[i] =
-        std::min(buckets_[i], min_column->buckets_[i - intersection_start]);
-  }
-
-  auto cur_time_range = GetTimeRange();
-  if (min_column->start_time_ > cur_time_range.end) {
-    auto to_insert_max =
-        (min_column->start_time_ - cur_time_range.end) / bucket_interval_;
-    for (size_t i = 0; i < to_insert_max; ++i) {
-      buckets_.push_back(std::numeric_limits<double>::max());
-    }
+template <typename Bucket>
+bool AggregateColumnBase<Bucket>::IsPresent(size_t bucket_idx) const {
+  auto bucket_start = GetTimeRange().start + bucket_idx * bucket_interval_;
+  auto it = std::ranges::upper_bound(runs_, bucket_start, std::less{},
+                                     &BucketsRun<Bucket>::start);
+  if (it == runs_.begin()) {
+    return false;
   }
-
-  auto to_skip = intersection_start ? intersection_end - intersection_start : 0;
-  for (const auto& val : std::views::drop(min_column->buckets_, to_skip)) {
-    buckets_.push_back(val);
+  --it;
+  if (bucket_start >= GetRunEnd(*it)) {
+    return false;
   }
+  return it->presence.Get(bucket_indexer_.Divide(bucket_start - it->start));
 }
 
-void MinColumn::Write(const InputTimeSeries& time_series) {
-  assert(std::ranges::is_sorted(time_series, {}, &Record::timestamp));
-  if (buckets_.empty()) {
-    start_time_ = time_series.front().timestamp -
-                  time_series.front().timestamp % bucket_interval_;
+template <typename Bucket>
+WritableRun<Bucket> AggregateColumnBase<Bucket>::ReserveBuckets(
+    const InputTimeSeries& time_series) {
+  assert(!time_series.empty());
+  auto start = bucket_indexer_.AlignDown(time_series.front().timestamp);
+  if (runs_.empty() ||
+      start >= GetRunEnd(runs_.back()) + kMinSparseGap * bucket_interval_) {
+    runs_.push_back({start, {}});
   }
-  assert(start_time_ % bucket_interval_ == 0);
-  assert(time_series.front().timestamp >= start_time_);
+  auto& run = runs_.back();
+  assert(time_series.front().timestamp >= run.start);
   auto needed_size =
-      (time_series.back().timestamp + 1 - start_time_ + bucket_interval_ - 1) /
-      bucket_interval_;
-  buckets_.resize(needed_size, std::numeric_limits<double>::max());
-  for (const auto& record : time_series) {
-    auto idx = *column_.GetBucketIdx(record.timestamp);
-    buckets_[idx] = std::min(buckets_[idx], record.value);
-  }
-}
-
-ReadColumn MinColumn::Read(const TimeRange& time_range) const {
-  return column_.Read(time_range, ColumnType::kMin);
+      bucket_indexer_.GetBucketIdx(run.start, time_series.back().timestamp) +
+      1;
+  needed_size = std::max(run.buckets.Size(), needed_size);
+  run.buckets.Resize(needed_size, identity_);
+  run.presence.Resize(needed_size, false);
+  return {run.start, run.buckets.MutableData(), run.presence.MutableWords()};
 }
 
-std::vector<Value> MinColumn::GetValues() const {
-  return column_.GetValues();
-}
-
-TimeRange MinColumn::GetTimeRange() const {
-  return column_.GetTimeRange();
-}
-
-Column MinColumn::Extract() {
-  return column_.Extract(ColumnType::kMin);
-}
-
-CompressedBytes MinColumn::ToBytes() const {
-  return column_.ToBytes();
-}
-
-size_t MinColumn::GetBucketsNum() const {
-  return buckets_.size();
-}
-
-MaxColumn::MaxColumn(Duration bucket_interval)
-    : column_(bucket_interval),
-      buckets_(column_.buckets_),
-      start_time_(column_.start_time_),
-      bucket_interval_(column_.bucket_interval_) {}
+template <typename Bucket>
+std::optional<size_t> AggregateColumnBase<Bucket>::GetBucketIdx(
+    TimePoint timestamp) const {
+  auto time_range = GetTimeRange();
+  if (timestamp < time_range.start) {
+    return 0;
+  }
 
-MaxColumn::MaxColumn(std::vector<double> buckets, const TimePoint& start_time,
-                     Duration bucket_interval)
-    : column_(std::move(buckets), start_time, bucket_interval),
-      buckets_(column_.buckets_),
-      start_time_(column_.start_time_),
-      bucket_interval_(column_.bucket_interval_) {}
+  if (timestamp >= time_range.end) {
+    return GetBucketsNum();
+  }
 
-ColumnType MaxColumn::GetType() const {
-  return ColumnType::kMax;
+  return bucket_indexer_.GetBucketIdx(time_range.start, timestamp);
 }
 
-void MaxColumn::ScaleBuckets(Duration bucket_interval) {
-  if (bucket_interval == bucket_interval_) {
-    return;
-  }
-  assert(bucket_interval % bucket_interval_ == 0);
-  auto scale = bucket_interval / bucket_interval_;
-  auto new_buckets_sz = buckets_.size() / scale;
-  if (start_time_ % bucket_interval != 0 || buckets_.size() % scale != 0) {
-    ++new_buckets_sz;
-  }
-
-  double max = std::numeric_limits<double>::lowest();
-  bool updated = false;
-  size_t pos = 0;
-  for (size_t i = 0; i < buckets_.size(); ++i) {
-    max = std::max(max, buckets_[i]);
-    updated = true;
-    if ((start_time_ + bucket_interval_ * i) / bucket_interval !=
-        (start_time_ + bucket_interval_ * (i + 1)) / bucket_interval) {
-      buckets_[pos++] = max;
-      max = std::numeric_limits<double>::lowest();
-      updated = false;
+template <typename Bucket>
+std::vector<Value> AggregateColumnBase<Bucket>::GetValues() const {
+  if (!IsSparse()) {
+    if (runs_.empty()) {
+      return {};
     }
+    const auto& buckets = runs_.front().buckets;
+    return {buckets.begin(), buckets.end()};
   }
-
-  if (updated) {
-    buckets_[pos++] = max;
+  std::vector<Value> res(GetBucketsNum(), identity_);
+  auto start = GetTimeRange().start;
+  for (const auto& run : runs_) {
+    auto offset = bucket_indexer_.Divide(run.start - start);
+    std::ranges::copy(run.buckets, res.begin() + offset);
   }
-
-  assert(pos == new_buckets_sz);
-
-  start_time_ = start_time_ - start_time_ % bucket_interval;
-  bucket_interval_ = bucket_interval;
-  buckets_.resize(new_buckets_sz);
+  return res;
 }
 
-void MaxColumn::Merge(Column column) {
-  if (!column) {
-    return;
-  }
-  auto max_column = std::dynamic_pointer_cast<MaxColumn>(column);
-  if (!max_column) {
-    throw std::runtime_error("Can't merge columns of different types");
-  }
-  if (this == max_column.get()) {
-    return;
+template <typename Bucket>
+TimeRange AggregateColumnBase<Bucket>::GetTimeRange() const {
+  if (runs_.empty()) {
+    return {};
   }
-  if (max_column->bucket_interval_ != bucket_interval_) {
-    if (max_column->bucket_interval_ < bucket_interval_) {
-      max_column->ScaleBuckets(bucket_interval_);
-    } else {
-      ScaleBuckets(max_column->bucket_interval_);
+  return {runs_.front().start, GetRunEnd(runs_.back())};
+}
+
+template class AggregateColumnBase<double>;
+template class AggregateColumnBase<uint64_t>;
+
+namespace {
+
+// reduces buckets of the run to bucket_interval
+template <typename Op, typename Bucket>
+void ScaleRun(BucketsRun<Bucket>& run, const BucketIndexer& indexer,
+              Duration bucket_interval) {
+  size_t scale = bucket_interval / indexer.GetBucketInterval();
+  auto& buckets = run.buckets;
+  // buckets are reduced as a ragged head (up to the first new bucket
+  // boundary), aligned groups of `scale` buckets and a ragged tail, so no
+  // per-bucket divisions are needed
+  size_t phase = indexer.Divide(run.start % bucket_interval);
+  size_t head = std::min(phase == 0 ? 0 : scale - phase, buckets.Size());
+  size_t groups = (buckets.Size() - head) / scale;
+  size_t tail = buckets.Size() - head - groups * scale;
+
+  const auto& presence = run.presence;
+  bool all_present = presence.All();
+  // absent buckets are skipped, otherwise e.g. Last would take identity of
+  // an empty bucket
+  auto reduce = [&](const Bucket* data, size_t begin, size_t size) {
+    Bucket acc = Op::kIdentity;
+    for (size_t i = begin; i < begin + size; ++i) {
+      if (all_present || presence.Get(i)) {
+        acc = Op::Combine(acc, data[i]);
+      }
     }
-  }
-  if (buckets_.empty()) {
-    buckets_ = max_column->buckets_;
-    start_time_ = max_column->start_time_;
-    return;
-  }
-  if (max_column->buckets_.empty()) {
-    return;
-  }
-  if (max_column->start_time_ < start_time_) {
-    throw std::runtime_error("Wrong merge order");
-  }
-
-  auto max_column_time_range = max_column->GetTimeRange();
-  auto intersection_start_opt =
-      column_.GetBucketIdx(max_column_time_range.start);
-  auto intersection_end_opt = column_.GetBucketIdx(max_column_time_range.end);
-  auto intersection_end =
-      intersection_end_opt ? *intersection_end_opt : buckets_.size();
-  auto intersection_start =
-      intersection_end_opt ? *intersection_start_opt : buckets_.size();
-  for (size_t i = intersection_start; i < intersection_end; ++i) {
-    buckets_[i] =
-        std::max(buckets_[i], max_column->buckets_[i - intersection_start]);
-  }
-
-  auto cur_time_range = GetTimeRange();
-  if (max_column->start_time_ > cur_time_range.end) {
-    auto to_insert_min =
-        (max_column->start_time_ - cur_time_range.end) / bucket_interval_;
-    for (size_t i = 0; i < to_insert_min; ++i) {
-      buckets_.push_back(std::numeric_limits<double>::lowest());
+    return acc;
+  };
+
+  size_t new_buckets_sz = (head != 0) + groups + (tail != 0);
+  // shared buckets are reduced straight into a new buffer instead of being
+  // copied first; otherwise it is done in place, because new buckets are
+  // never written ahead of the group being reduced
+  std::vector<Bucket> scaled;
+  const Bucket* data = buckets.Data();
+  Bucket* out = nullptr;
+  if (buckets.IsShared()) {
+    scaled.resize(new_buckets_sz);
+    out = scaled.data();
+  } else {
+    out = buckets.MutableData();
+  }
+  Bitmap new_presence(new_buckets_sz, all_present);
+  size_t out_idx = 0;
+  if (head != 0) {
+    new_presence.Set(out_idx, presence.Count(0, head) != 0);
+    out[out_idx++] = reduce(data, 0, head);
+  }
+  if (all_present) {
+    Op::ReduceGroups(data + head, groups, scale, out + out_idx);
+    out_idx += groups;
+  } else {
+    // fully present groups are still reduced by the kernel in stretches,
+    // the rest bucket by bucket
+    size_t stretch = 0;
+    auto flush = [&] {
+      auto begin = head + (out_idx - stretch - (head != 0)) * scale;
+      Op::ReduceGroups(data + begin, stretch, scale, out + out_idx - stretch);
+      stretch = 0;
+    };
+    for (size_t group = 0; group < groups; ++group, ++out_idx) {
+      auto begin = head + group * scale;
+      auto present = presence.Count(begin, begin + scale);
+      if (present == scale) {
+        new_presence.Set(out_idx);
+        ++stretch;
+        continue;
+      }
+      flush();
+      out[out_idx] = reduce(data, begin, scale);
+      new_presence.Set(out_idx, present != 0);
     }
+    flush();
   }
-
-  auto to_skip = intersection_start ? intersection_end - intersection_start : 0;
-  for (const auto& val : std::views::drop(max_column->buckets_, to_skip)) {
-    buckets_.push_back(val);
+  if (tail != 0) {
+    auto begin = head + groups * scale;
+    new_presence.Set(out_idx, presence.Count(begin, begin + tail) != 0);
+    out[out_idx] = reduce(data, begin, tail);
   }
-}
 
-void MaxColumn::Write(const InputTimeSeries& time_series) {
-  assert(std::ranges::is_sorted(time_series, {}, &Record::timestamp));
-  if (buckets_.empty()) {
-    start_time_ = time_series.front().timestamp -
-                  time_series.front().timestamp % bucket_interval_;
-  }
-  assert(start_time_ % bucket_interval_ == 0);
-  assert(time_series.front().timestamp >= start_time_);
-  auto needed_size =
-      (time_series.back().timestamp + 1 - start_time_ + bucket_interval_ - 1) /
-      bucket_interval_;
-  buckets_.resize(needed_size, std::numeric_limits<double>::lowest());
-  for (const auto& record : time_series) {
-    auto idx = *column_.GetBucketIdx(record.timestamp);
-    buckets_[idx] = std::max(buckets_[idx], record.value);
+  run.start = run.start - run.start % bucket_interval;
+  if (buckets.IsShared()) {
+    buckets = std::move(scaled);
+  } else {
+    buckets.Resize(new_buckets_sz);
   }
+  run.presence = std::move(new_presence);
 }
 
-ReadColumn MaxColumn::Read(const TimeRange& time_range) const {
-  return column_.Read(time_range, ColumnType::kMax);
-}
+}  // namespace
 
-std::vector<Value> MaxColumn::GetValues() const {
-  return column_.GetValues();
-}
+template <typename Op, typename Bucket>
+AggregateColumn<Op, Bucket>::AggregateColumn(Duration bucket_interval)
+    : Base(bucket_interval, Op::kIdentity) {}
 
-TimeRange MaxColumn::GetTimeRange() const {
-  return column_.GetTimeRange();
-}
+template <typename Op, typename Bucket>
+AggregateColumn<Op, Bucket>::AggregateColumn(SharedVector<Bucket> buckets,
+                                             const TimePoint& start_time,
+                                             Duration bucket_interval)
+    : Base(std::move(buckets), start_time, bucket_interval, Op::kIdentity) {}
 
-Column MaxColumn::Extract() {
-  return column_.Extract(ColumnType::kMax);
-}
-
-CompressedBytes MaxColumn::ToBytes() const {
-  return column_.ToBytes();
-}
+template <typename Op, typename Bucket>
+AggregateColumn<Op, Bucket>::AggregateColumn(
+    std::vector<BucketsRun<Bucket>> runs, Duration bucket_interval)
+    : Base(std::move(runs), bucket_interval, Op::kIdentity) {}
 
-size_t MaxColumn::GetBucketsNum() const {
-  return buckets_.size();
+template <typename Op, typename Bucket>
+ColumnType AggregateColumn<Op, Bucket>::GetType() const {
+  return Op::kType;
 }
 
-LastColumn::LastColumn(Duration bucket_interval)
-    : column_(bucket_interval),
-      buckets_(column_.buckets_),
-      start_time_(column_.start_time_),
-      bucket_interval_(column_.bucket_interval_) {}
-
-LastColumn::LastColumn(std::vector<double> buckets, const TimePoint& start_time,
-                       Duration bucket_interval)
-    : column_(std::move(buckets), start_time, bucket_interval),
-      buckets_(column_.buckets_),
-      start_time_(column_.start_time_),
-      bucket_interval_(column_.bucket_interval_) {}
-
-ColumnType LastColumn::GetType() const {
-  return ColumnType::kLast;
-}
-
-void LastColumn::ScaleBuckets(Duration bucket_interval) {
+template <typename Op, typename Bucket>
+void AggregateColumn<Op, Bucket>::ScaleBuckets(Duration bucket_interval) {
   if (bucket_interval == bucket_interval_) {
     return;
   }
   assert(bucket_interval % bucket_interval_ == 0);
-  auto scale = bucket_interval / bucket_interval_;
-  auto new_buckets_sz = buckets_.size() / scale;
-  if (start_time_ % bucket_interval != 0 || buckets_.size() % scale != 0) {
-    ++new_buckets_sz;
-  }
-
-  double last = 0;
-  bool updated = false;
-  size_t pos = 0;
-  for (size_t i = 0; i < buckets_.size(); ++i) {
-    last = buckets_[i];
-    updated = true;
-    if ((start_time_ + bucket_interval_ * i) / bucket_interval !=
-        (start_time_ + bucket_interval_ * (i + 1)) / bucket_interval) {
-      buckets_[pos++] = last;
-      last = 0;
-      updated = false;
-    }
-  }
-
-  if (updated) {
-    buckets_[pos++] = last;
+  auto runs = std::move(runs_);
+  runs_.clear();
+  for (auto& run : runs) {
+    ScaleRun<Op>(run, bucket_indexer_, bucket_interval);
   }
-
-  assert(pos == new_buckets_sz);
-
-  start_time_ = start_time_ - start_time_ % bucket_interval;
   bucket_interval_ = bucket_interval;
-  buckets_.resize(new_buckets_sz);
+  bucket_indexer_ = BucketIndexer(bucket_interval);
+
+  for (auto& run : runs) {
+    // neighbour runs may share a bucket after scaling
+    if (!runs_.empty() && run.start < GetRunEnd(runs_.back())) {
+      auto& last = runs_.back();
+      auto last_idx = last.buckets.Size() - 1;
+      if (run.presence.Get(0)) {
+        auto* last_bucket = last.buckets.MutableData() + last_idx;
+        *last_bucket = last.presence.Get(last_idx)
+                           ? Op::Combine(*last_bucket, run.buckets[0])
+                           : run.buckets[0];
+        last.presence.Set(last_idx);
+      }
+      run.start += bucket_interval_;
+      run.buckets = run.buckets.Slice(1, run.buckets.Size());
+      run.presence = run.presence.Slice(1, run.presence.Size());
+    }
+    AppendRun(std::move(run));
+  }
 }
 
-void LastColumn::Merge(Column column) {
+template <typename Op, typename Bucket>
+void AggregateColumn<Op, Bucket>::Merge(Column column) {
   if (!column) {
     return;
   }
-  auto last_column = std::dynamic_pointer_cast<LastColumn>(column);
-  if (!last_column) {
+  auto other = std::dynamic_pointer_cast<AggregateColumn<Op, Bucket>>(column);
+  if (!other) {
     throw std::runtime_error("Can't merge columns of different types");
   }
-  if (this == last_column.get()) {
+  if (this == other.get()) {
     return;
   }
-  if (last_column->bucket_interval_ != bucket_interval_) {
-    if (last_column->bucket_interval_ < bucket_interval_) {
-      last_column->ScaleBuckets(bucket_interval_);
+  if (other->bucket_interval_ != bucket_interval_) {
+    if (other->bucket_interval_ < bucket_interval_) {
+      other->ScaleBuckets(bucket_interval_);
     } else {
-      ScaleBuckets(last_column->bucket_interval_);
+      ScaleBuckets(other->bucket_interval_);
     }
   }
-  if (buckets_.empty()) {
-    buckets_ = last_column->buckets_;
-    start_time_ = last_column->start_time_;
+  if (runs_.empty()) {
+    runs_ = other->runs_;
     return;
   }
-  if (last_column->buckets_.empty()) {
+  if (other->runs_.empty()) {
     return;
   }
-  if (last_column->start_time_ < start_time_) {
+  if (other->GetTimeRange().start < GetTimeRange().start) {
     throw std::runtime_error("Wrong merge order");
   }
 
-  auto last_column_time_range = last_column->GetTimeRange();
-  auto intersection_start_opt =
-      column_.GetBucketIdx(last_column_time_range.start);
-  auto intersection_end_opt = column_.GetBucketIdx(last_column_time_range.end);
-  auto intersection_end =
-      intersection_end_opt ? *intersection_end_opt : buckets_.size();
-  auto intersection_start =
-      intersection_end_opt ? *intersection_start_opt : buckets_.size();
-  for (size_t i = intersection_start; i < intersection_end; ++i) {
-    buckets_[i] = last_column->buckets_[i - intersection_start];
-  }
-
-  auto cur_time_range = GetTimeRange();
-  if (last_column->start_time_ > cur_time_range.end) {
-    auto to_insert_zeroes =
-        (last_column->start_time_ - cur_time_range.end) / bucket_interval_;
-    for (size_t i = 0; i < to_insert_zeroes; ++i) {
-      buckets_.push_back(0);
+  for (const auto& run : other->runs_) {
+    auto end = GetTimeRange().end;
+    if (run.start >= end) {
+      AppendRun(run);
+      continue;
+    }
+    auto overlap_end = std::min(GetRunEnd(run), end);
+    auto overlap = bucket_indexer_.Divide(overlap_end - run.start);
+    auto& dense = DensifyRange(run.start, overlap_end);
+    auto offset = bucket_indexer_.Divide(run.start - dense.start);
+    auto* buckets = dense.buckets.MutableData() + offset;
+    for (size_t i = 0; i < overlap; ++i) {
+      // buckets that are absent in other column are left as is
+      if (run.presence.Get(i)) {
+        buckets[i] = dense.presence.Get(offset + i)
+                         ? Op::Combine(buckets[i], run.buckets[i])
+                         : run.buckets[i];
+        dense.presence.Set(offset + i);
+      }
     }
+    AppendRun({overlap_end, run.buckets.Slice(overlap, run.buckets.Size()),
+               run.presence.Slice(overlap, run.presence.Size())});
   }
+}
 
-  auto to_skip = intersection_start ? intersection_end - intersection_start : 0;
-  for (const auto& val : std::views::drop(last_column->buckets_, to_skip)) {
-    buckets_.push_back(val);
+template <typename Op, typename Bucket>
+void AggregateColumn<Op, Bucket>::Write(const InputTimeSeries& time_series) {
+  assert(std::ranges::is_sorted(time_series, {}, &Record::timestamp));
+  auto run = this->ReserveBuckets(time_series);
+  for (const auto& record : time_series) {
+    auto idx = bucket_indexer_.GetBucketIdx(run.start, record.timestamp);
+    run.buckets[idx] = Op::Update(run.buckets[idx], record.value);
+    run.presence[idx / Bitmap::kWordBits] |= uint64_t{1}
+                                             << (idx % Bitmap::kWordBits);
   }
 }
 
-void LastColumn::Write(const InputTimeSeries& time_series) {
-  assert(std::ranges::is_sorted(time_series, {}, &Record::timestamp));
-  if (buckets_.empty()) {
-    start_time_ = time_series.front().timestamp -
-                  time_series.front().timestamp % bucket_interval_;
+template <typename Op, typename Bucket>
+ReadColumn AggregateColumn<Op, Bucket>::Read(
+    const TimeRange& time_range) const {
+  auto range = GetBucketsRange(time_range);
+  if (!range) {
+    return std::shared_ptr<AggregateColumn<Op, Bucket>>(nullptr);
   }
-  assert(start_time_ % bucket_interval_ == 0);
-  assert(time_series.front().timestamp >= start_time_);
-  auto needed_size =
-      (time_series.back().timestamp + 1 - start_time_ + bucket_interval_ - 1) /
-      bucket_interval_;
-  buckets_.resize(needed_size);
-  for (const auto& record : time_series) {
-    auto idx = *column_.GetBucketIdx(record.timestamp);
-    buckets_[idx] = record.value;
+  auto [start_bucket, end_bucket] = *range;
+  auto runs = SliceRuns(start_bucket, end_bucket);
+  if (runs.empty()) {
+    return std::shared_ptr<AggregateColumn<Op, Bucket>>(nullptr);
   }
+  return std::make_shared<AggregateColumn<Op, Bucket>>(std::move(runs),
+                                                       bucket_interval_);
 }
 
-ReadColumn LastColumn::Read(const TimeRange& time_range) const {
-  return column_.Read(time_range, ColumnType::kLast);
+template <typename Op, typename Bucket>
+std::vector<Value> AggregateColumn<Op, Bucket>::GetValues() const {
+  return Base::GetValues();
 }
 
-std::vector<Value> LastColumn::GetValues() const {
-  return column_.GetValues();
+template <typename Op, typename Bucket>
+TimeRange AggregateColumn<Op, Bucket>::GetTimeRange() const {
+  return Base::GetTimeRange();
 }
 
-TimeRange LastColumn::GetTimeRange() const {
-  return column_.GetTimeRange();
+template <typename Op, typename Bucket>
+Column AggregateColumn<Op, Bucket>::Extract() {
+  auto col = std::make_shared<AggregateColumn<Op, Bucket>>(std::move(runs_),
+                                                           bucket_interval_);
+  runs_.clear();
+  auto read_column = std::static_pointer_cast<IReadColumn>(col);
+  return std::static_pointer_cast<IColumn>(read_column);
 }
 
-Column LastColumn::Extract() {
-  return column_.Extract(ColumnType::kLast);
+template <typename Op, typename Bucket>
+CompressedBytes AggregateColumn<Op, Bucket>::ToBytes() const {
+  return Base::ToBytes();
 }
 
-CompressedBytes LastColumn::ToBytes() const {
-  return column_.ToBytes();
+template <typename Op, typename Bucket>
+size_t AggregateColumn<Op, Bucket>::GetBucketsNum() const {
+  return Base::GetBucketsNum();
 }
 
-size_t LastColumn::GetBucketsNum() const {
-  return buckets_.size();
+template <typename Op, typename Bucket>
+size_t AggregateColumn<Op, Bucket>::GetStoredBucketsNum() const {
+  return Base::GetStoredBucketsNum();
 }
 
+template <typename Op, typename Bucket>
+Duration AggregateColumn<Op, Bucket>::GetBucketInterval() const {
+  return Base::GetBucketInterval();
+}
+
+template class AggregateColumn<SumOp>;
+template class AggregateColumn<CountOp>;
+template class AggregateColumn<MinOp>;
+template class AggregateColumn<MaxOp>;
+template class AggregateColumn<LastOp>;
+
 RawTimestampsColumn::RawTimestampsColumn(std::vector<TimePoint> timestamps)
     : timestamps_(std::move(timestamps)) {}
 
+RawTimestampsColumn::RawTimestampsColumn(TimestampRuns timestamps)
+    : timestamps_(std::move(timestamps)) {}
+
 ColumnType RawTimestampsColumn::GetType() const {
   return ColumnType::kRawTimestamps;
 }
 
 CompressedBytes RawTimestampsColumn::ToBytes() const {
-  CompressedBytes res;
-  Append(res, timestamps_.data(), timestamps_.size());
-  return res;
+  return ToBytes(RawTimestampsEncoding::kPlain);
+}
+
+CompressedBytes RawTimestampsColumn::ToBytes(
+    RawTimestampsEncoding encoding) const {
+  if (encoding == RawTimestampsEncoding::kRuns && timestamps_.IsRegular()) {
+    return EncodeTimestampRuns(timestamps_.GetRuns());
+  }
+  return EncodeRawTimestamps(timestamps_.Materialize(), encoding);
 }
 
 void RawTimestampsColumn::Merge(Column column) {
@@ -931,51 +916,61 @@ void RawTimestampsColumn::Merge(Column column) {
   if (this == raw_timestamps_column.get()) {
     return;
   }
-  if (timestamps_.empty()) {
+  if (timestamps_.Empty()) {
     timestamps_ = raw_timestamps_column->timestamps_;
     return;
   }
-  if (raw_timestamps_column->timestamps_.empty()) {
+  if (raw_timestamps_column->timestamps_.Empty()) {
     return;
   }
-  if (raw_timestamps_column->timestamps_.front() < timestamps_.back()) {
+  if (raw_timestamps_column->timestamps_.Front() < timestamps_.Back()) {
     throw std::runtime_error("Wrong merge order");
   }
-  timestamps_.insert(timestamps_.end(),
-                     raw_timestamps_column->timestamps_.begin(),
-                     raw_timestamps_column->timestamps_.end());
+  timestamps_.Append(raw_timestamps_column->timestamps_);
 }
 
 void RawTimestampsColumn::Write(const InputTimeSeries& time_series) {
   assert(std::ranges::is_sorted(time_series, {}, &Record::timestamp));
-  timestamps_.reserve(timestamps_.size() + time_series.size());
   for (const auto& record : time_series) {
-    timestamps_.push_back(record.timestamp);
+    timestamps_.PushBack(record.timestamp);
   }
 }
 
 std::vector<Value> RawTimestampsColumn::GetValues() const {
-  return {timestamps_.begin(), timestamps_.end()};
+  auto timestamps = timestamps_.Materialize();
+  return {timestamps.begin(), timestamps.end()};
 }
 
 Column RawTimestampsColumn::Extract() {
   auto timestamps = std::move(timestamps_);
   timestamps_ = {};
-  return std::make_shared<RawTimestampsColumn>(timestamps);
+  return std::make_shared<RawTimestampsColumn>(std::move(timestamps));
 }
 
 TimeRange RawTimestampsColumn::GetTimeRange() const {
-  if (timestamps_.empty()) {
+  if (timestamps_.Empty()) {
     return {};
   }
-  return {timestamps_.front(), timestamps_.back() + 1};
+  return {timestamps_.Front(), timestamps_.Back() + 1};
 }
 
 size_t RawTimestampsColumn::TimestampsNum() const {
-  return timestamps_.size();
+  return timestamps_.Size();
 }
 
-RawValuesColumn::RawValuesColumn(std::vector<Value> values)
+TimePoint RawTimestampsColumn::At(size_t idx) const {
+  return timestamps_[idx];
+}
+
+void RawTimestampsColumn::PushBack(TimePoint timestamp) {
+  timestamps_.PushBack(timestamp);
+}
+
+size_t RawTimestampsColumn::GetBytesSize() const {
+  return timestamps_.GetBytesSize();
+}
+
+RawValuesColumn::RawValuesColumn(SharedVector<Value> values)
     : values_(std::move(values)) {}
 
 ColumnType RawValuesColumn::GetType() const {
@@ -983,9 +978,11 @@ ColumnType RawValuesColumn::GetType() const {
 }
 
 CompressedBytes RawValuesColumn::ToBytes() const {
-  CompressedBytes res;
-  Append(res, values_.data(), values_.size());
-  return res;
+  return ToBytes(RawValuesEncoding::kPlain);
+}
+
+CompressedBytes RawValuesColumn::ToBytes(RawValuesEncoding encoding) const {
+  return EncodeRawValues(values_, encoding);
 }
 
 void RawValuesColumn::Merge(Column column) {
@@ -999,37 +996,44 @@ void RawValuesColumn::Merge(Column column) {
   if (this == raw_values_column.get()) {
     return;
   }
-  if (values_.empty()) {
+  if (values_.Empty()) {
     values_ = raw_values_column->values_;
     return;
   }
-  if (raw_values_column->values_.empty()) {
+  if (raw_values_column->values_.Empty()) {
     return;
   }
-  values_.insert(values_.end(), raw_values_column->values_.begin(),
-                 raw_values_column->values_.end());
+  values_.Append(raw_values_column->values_);
 }
 
 void RawValuesColumn::Write(const InputTimeSeries& time_series) {
   assert(std::ranges::is_sorted(time_series, {}, &Record::timestamp));
-  values_.reserve(values_.size() + time_series.size());
+  values_.Reserve(values_.Size() + time_series.size());
   for (const auto& record : time_series) {
-    values_.push_back(record.value);
+    values_.PushBack(record.value);
   }
 }
 
 std::vector<Value> RawValuesColumn::GetValues() const {
-  return values_;
+  return values_.ToVector();
 }
 
 Column RawValuesColumn::Extract() {
   auto values = std::move(values_);
   values_ = {};
-  return std::make_shared<RawValuesColumn>(values);
+  return std::make_shared<RawValuesColumn>(std::move(values));
 }
 
 size_t RawValuesColumn::ValuesNum() const {
-  return values_.size();
+  return values_.Size();
+}
+
+void RawValuesColumn::Reserve(size_t size) {
+  values_.Reserve(size);
+}
+
+void RawValuesColumn::PushBack(Value value) {
+  values_.PushBack(value);
 }
 
 ReadRawColumn::ReadRawColumn(
@@ -1061,19 +1065,17 @@ ReadColumn ReadRawColumn::Read(const TimeRange& time_range) const {
   if (!timestamps_column_ || !values_column_) {
     return std::shared_ptr<ReadRawColumn>(nullptr);
   }
-  auto& timestamps = timestamps_column_->timestamps_;
-  auto& values = values_column_->values_;
-  auto start =
-      std::lower_bound(timestamps.begin(), timestamps.end(), time_range.start);
-  auto end = std::upper_bound(start, timestamps.end(), time_range.end - 1);
-  if (start == timestamps.end()) {
+  const auto& timestamps = timestamps_column_->timestamps_;
+  const auto& values = values_column_->values_;
+  // for regular series bounds are computed arithmetically from runs
+  auto start = timestamps.LowerBound(time_range.start);
+  auto end = std::max(start, timestamps.UpperBound(time_range.end - 1));
+  if (start == timestamps.Size()) {
     return std::shared_ptr<ReadRawColumn>(nullptr);
   }
   return std::make_shared<ReadRawColumn>(
-      std::make_shared<RawTimestampsColumn>(std::vector<TimePoint>(start, end)),
-      std::make_shared<RawValuesColumn>(
-          std::vector<Value>(values.begin() + (start - timestamps.begin()),
-                             values.begin() + (end - timestamps.begin()))));
+      std::make_shared<RawTimestampsColumn>(timestamps.Slice(start, end)),
+      std::make_shared<RawValuesColumn>(values.Slice(start, end)));
 }
 
 void ReadRawColumn::Write(const InputTimeSeries& time_series) {
@@ -1095,8 +1097,7 @@ std::vector<Value> ReadRawColumn::GetValues() const {
 }
 
 TimeRange ReadRawColumn::GetTimeRange() const {
-  return TimeRange{timestamps_column_->timestamps_.front(),
-                   timestamps_column_->timestamps_.back() + 1};
+  return timestamps_column_->GetTimeRange();
 }
 
 Column ReadRawColumn::Extract() {
@@ -1113,44 +1114,74 @@ std::vector<TimePoint> ReadRawColumn::GetTimestamps() const {
   if (!timestamps_column_) {
     return {};
   }
-  auto timestamps = timestamps_column_->GetValues();
-  return {timestamps.begin(), timestamps.end()};
+  return timestamps_column_->timestamps_.Materialize();
 }
 
-AvgColumn::AvgColumn(std::vector<double> buckets, const TimePoint& start_time,
+AvgColumn::AvgColumn(SharedVector<double> buckets, const TimePoint& start_time,
+                     Duration bucket_interval)
+    : AggregateColumnBase(std::move(buckets), start_time, bucket_interval, 0) {}
+
+AvgColumn::AvgColumn(std::vector<BucketsRun<double>> runs,
                      Duration bucket_interval)
-    : column_(std::move(buckets), start_time, bucket_interval) {}
+    : AggregateColumnBase(std::move(runs), bucket_interval, 0) {}
 
-AggregateColumn AvgColumn::CreateAvgAggregateColumn(
+AggregateColumnBase<double> AvgColumn::CreateAvgAggregateColumn(
     std::shared_ptr<SumColumn> sum_column,
     std::shared_ptr<CountColumn> count_column) {
   assert(sum_column && count_column);
-  if (sum_column->bucket_interval_ != count_column->bucket_interval_) {
+  auto bucket_interval = sum_column->GetBucketInterval();
+  if (bucket_interval != count_column->GetBucketInterval()) {
     throw std::runtime_error(
         "Can't get avg of columns with different bucket "
         "intervals");
   }
-  if (sum_column->start_time_ != count_column->start_time_) {
+  if (sum_column->GetTimeRange().start != count_column->GetTimeRange().start) {
     throw std::runtime_error(
         "Can't get avg of columns with different start "
         "times");
   }
-  std::vector<double> buckets;
-  for (size_t i = 0; i < sum_column->buckets_.size(); ++i) {
-    if (count_column->buckets_[i] == 0) {
-      buckets.push_back(0);
-    } else {
-      buckets.push_back(sum_column->buckets_[i] / count_column->buckets_[i]);
+  auto avg = [](std::span<const double> sums, const auto& counts) {
+    std::vector<double> buckets;
+    buckets.reserve(sums.size());
+    for (size_t i = 0; i < sums.size(); ++i) {
+      buckets.push_back(counts[i] == 0 ? 0 : sums[i] / counts[i]);
+    }
+    return buckets;
+  };
+  const auto& sum_runs = sum_column->GetRuns();
+  const auto& count_runs = count_column->GetRuns();
+  auto same_runs = std::ranges::equal(
+      sum_runs, count_runs, [](const auto& lhs, const auto& rhs) {
+        return lhs.start == rhs.start &&
+               lhs.buckets.Size() == rhs.buckets.Size();
+      });
+  std::vector<BucketsRun<double>> runs;
+  if (!same_runs) {
+    auto sums = sum_column->GetValues();
+    auto counts = count_column->GetValues();
+    counts.resize(sums.size(), 0);
+    Bitmap presence(counts.size(), false);
+    for (size_t i = 0; i < counts.size(); ++i) {
+      presence.Set(i, counts[i] != 0);
     }
+    if (!sums.empty()) {
+      runs.push_back({sum_column->GetTimeRange().start, avg(sums, counts),
+                      std::move(presence)});
+    }
+    return {std::move(runs), bucket_interval, 0};
+  }
+  for (size_t i = 0; i < sum_runs.size(); ++i) {
+    runs.push_back({sum_runs[i].start,
+                    avg(sum_runs[i].buckets, count_runs[i].buckets),
+                    sum_runs[i].presence});
   }
-  return {std::move(buckets), sum_column->start_time_,
-          sum_column->bucket_interval_};
+  return {std::move(runs), bucket_interval, 0};
 }
 
 AvgColumn::AvgColumn(std::shared_ptr<SumColumn> sum_column,
                      std::shared_ptr<CountColumn> count_column)
-    : column_(CreateAvgAggregateColumn(std::move(sum_column),
-                                       std::move(count_column))) {}
+    : AggregateColumnBase(CreateAvgAggregateColumn(std::move(sum_column),
+                                                   std::move(count_column))) {}
 
 ColumnType AvgColumn::GetType() const {
   return ColumnType::kAvg;
@@ -1161,7 +1192,16 @@ void AvgColumn::Merge(Column column) {
 }
 
 ReadColumn AvgColumn::Read(const TimeRange& time_range) const {
-  return column_.Read(time_range, ColumnType::kAvg);
+  auto range = GetBucketsRange(time_range);
+  if (!range) {
+    return std::shared_ptr<AvgColumn>(nullptr);
+  }
+  auto [start_bucket, end_bucket] = *range;
+  auto runs = SliceRuns(start_bucket, end_bucket);
+  if (runs.empty()) {
+    return std::shared_ptr<AvgColumn>(nullptr);
+  }
+  return std::make_shared<AvgColumn>(std::move(runs), bucket_interval_);
 }
 
 void AvgColumn::Write(const InputTimeSeries& time_series) {
@@ -1169,15 +1209,17 @@ void AvgColumn::Write(const InputTimeSeries& time_series) {
 }
 
 std::vector<Value> AvgColumn::GetValues() const {
-  return column_.GetValues();
+  return AggregateColumnBase::GetValues();
 }
 
 TimeRange AvgColumn::GetTimeRange() const {
-  return column_.GetTimeRange();
+  return AggregateColumnBase::GetTimeRange();
 }
 
 Column AvgColumn::Extract() {
-  return column_.Extract(ColumnType::kAvg);
+  throw std::runtime_error("Type " +
+                           std::to_string(static_cast<int>(ColumnType::kAvg)) +
+                           " is not to extract");
 }
 
 Column CreateRawColumn(ColumnType column_type) {
@@ -1214,19 +1256,19 @@ Column CreateAggregatedColumn(ColumnType column_type,
   }
 }
 
-Column FromBytes(const CompressedBytes& bytes, ColumnType column_type) {
+Column FromBytes(BytesView bytes, ColumnType column_type) {
   switch (column_type) {
     case ColumnType::kRawValues: {
-      auto data = reinterpret_cast<const Value*>(bytes.data());
-      auto sz = bytes.size() / sizeof(Value);
-      return std::make_shared<RawValuesColumn>(
-          std::vector<Value>(data, data + sz));
+      return std::make_shared<RawValuesColumn>(DecodeRawValues(bytes));
     }
     case ColumnType::kRawTimestamps: {
-      auto data = reinterpret_cast<const TimePoint*>(bytes.data());
-      auto sz = bytes.size() / sizeof(TimePoint);
-      return std::make_shared<RawTimestampsColumn>(
-          std::vector<TimePoint>(data, data + sz));
+      if (IsTimestampRunsPage(bytes)) {
+        return std::make_shared<RawTimestampsColumn>(
+            TimestampRuns(DecodeTimestampRuns(bytes)));
+      }
+      std::vector<TimePoint> timestamps;
+      DecodeRawTimestamps(bytes, timestamps);
+      return std::make_shared<RawTimestampsColumn>(std::move(timestamps));
     }
     case ColumnType::kSum: {
       return AggregateFromBytes<SumColumn>(bytes);
@@ -1248,7 +1290,190 @@ Column FromBytes(const CompressedBytes& bytes, ColumnType column_type) {
   }
 }
 
-CompressedBytesReader::CompressedBytesReader(const CompressedBytes& bytes)
+namespace {
+
+InputTimeSeries ToRecords(const ReadRawColumn& column) {
+  auto timestamps = column.GetTimestamps();
+  auto values = column.GetValues();
+  InputTimeSeries res;
+  res.reserve(timestamps.size());
+  for (size_t i = 0; i < timestamps.size(); ++i) {
+    res.push_back({timestamps[i], values[i]});
+  }
+  return res;
+}
+
+}  // namespace
+
+size_t GetColumnBytesSize(const Column& column) {
+  switch (column->GetType()) {
+    case ColumnType::kSum:
+    case ColumnType::kCount:
+    case ColumnType::kMin:
+    case ColumnType::kMax:
+    case ColumnType::kLast: {
+      // gaps of sparse columns are not stored, buckets of all aggregations
+      // take 8 bytes
+      auto agg_column = std::dynamic_pointer_cast<IAggregateColumn>(column);
+      return agg_column->GetStoredBucketsNum() * sizeof(Value);
+    }
+    case ColumnType::kAvg: {
+      auto avg_column = std::dynamic_pointer_cast<AvgColumn>(column);
+      return avg_column->GetStoredBucketsNum() * sizeof(Value);
+    }
+    case ColumnType::kRawTimestamps: {
+      auto raw_ts_column =
+          std::dynamic_pointer_cast<RawTimestampsColumn>(column);
+      return raw_ts_column->GetBytesSize();
+    }
+    case ColumnType::kRawValues: {
+      auto raw_vals_column = std::dynamic_pointer_cast<RawValuesColumn>(column);
+      return raw_vals_column->ValuesNum() * sizeof(Value);
+    }
+    default:
+      throw std::runtime_error("Unsupported column type");
+  }
+}
+
+ReadColumn MergeUnordered(ReadColumn lhs, ReadColumn rhs) {
+  if (!lhs) {
+    return rhs;
+  }
+  if (!rhs) {
+    return lhs;
+  }
+  if (rhs->GetTimeRange().start < lhs->GetTimeRange().start) {
+    std::swap(lhs, rhs);
+  }
+  if (lhs->GetType() != ColumnType::kRawRead ||
+      lhs->GetTimeRange().end <= rhs->GetTimeRange().start + 1) {
+    // buckets of aggregates are combined wherever they overlap
+    lhs->Merge(rhs);
+    return lhs;
+  }
+  // interleaving raw records are merged by timestamps
+  auto lhs_records = ToRecords(*std::static_pointer_cast<ReadRawColumn>(lhs));
+  auto rhs_records = ToRecords(*std::static_pointer_cast<ReadRawColumn>(rhs));
+  InputTimeSeries records;
+  records.reserve(lhs_records.size() + rhs_records.size());
+  std::ranges::merge(lhs_records, rhs_records, std::back_inserter(records),
+                     {}, &Record::timestamp, &Record::timestamp);
+  auto res = std::make_shared<ReadRawColumn>();
+  res->Write(records);
+  return res;
+}
+
+CompressedBytesReader::CompressedBytesReader(BytesView bytes)
     : bytes_(bytes) {}
 
+namespace {
+
+// bucket grid shared by the fused aggregate columns
+struct BucketsGrid {
+  TimePoint start;
+  BucketIndexer indexer;
+};
+
+template <typename Op>
+void UpdateBucket(const WritableRun<typename Op::Bucket>& run, size_t idx,
+                  Value value) {
+  if (run.buckets) {
+    run.buckets[idx] = Op::Update(run.buckets[idx], value);
+    run.presence[idx / Bitmap::kWordBits] |= uint64_t{1}
+                                             << (idx % Bitmap::kWordBits);
+  }
+}
+
+// reserves buckets of the column to be updated in the fused loop, columns of
+// the same type or on another grid are written on their own
+template <typename Op>
+void ReserveFused(const Column& column, const InputTimeSeries& time_series,
+                  std::optional<BucketsGrid>& grid,
+                  WritableRun<typename Op::Bucket>& fused) {
+  auto* aggregate = dynamic_cast<AggregateColumn<Op>*>(column.get());
+  auto run = aggregate->ReserveBuckets(time_series);
+  if (fused.buckets ||
+      (grid && (grid->start != run.start ||
+                grid->indexer.GetBucketInterval() !=
+                    aggregate->GetBucketInterval()))) {
+    column->Write(time_series);
+    return;
+  }
+  grid = BucketsGrid{run.start, aggregate->GetBucketIndexer()};
+  fused = run;
+}
+
+}  // namespace
+
+void WriteColumns(const Columns& columns, const InputTimeSeries& time_series) {
+  assert(std::ranges::is_sorted(time_series, {}, &Record::timestamp));
+  if (time_series.empty()) {
+    return;
+  }
+
+  // buckets of fused aggregate columns
+  WritableRun<double> sum{};
+  WritableRun<uint64_t> count{};
+  WritableRun<double> min{};
+  WritableRun<double> max{};
+  WritableRun<double> last{};
+  std::optional<BucketsGrid> grid;
+  RawTimestampsColumn* timestamps = nullptr;
+  RawValuesColumn* values = nullptr;
+
+  for (const auto& column : columns) {
+    switch (column->GetType()) {
+      case ColumnType::kSum:
+        ReserveFused<SumOp>(column, time_series, grid, sum);
+        break;
+      case ColumnType::kCount:
+        ReserveFused<CountOp>(column, time_series, grid, count);
+        break;
+      case ColumnType::kMin:
+        ReserveFused<MinOp>(column, time_series, grid, min);
+        break;
+      case ColumnType::kMax:
+        ReserveFused<MaxOp>(column, time_series, grid, max);
+        break;
+      case ColumnType::kLast:
+        ReserveFused<LastOp>(column, time_series, grid, last);
+        break;
+      case ColumnType::kRawTimestamps:
+        if (timestamps) {
+          column->Write(time_series);
+        } else {
+          timestamps = static_cast<RawTimestampsColumn*>(column.get());
+        }
+        break;
+      case ColumnType::kRawValues:
+        if (values) {
+          column->Write(time_series);
+        } else {
+          values = static_cast<RawValuesColumn*>(column.get());
+          values->Reserve(values->ValuesNum() + time_series.size());
+        }
+        break;
+      default:
+        column->Write(time_series);
+    }
+  }
+
+  auto start_time = grid ? grid->start : 0;
+  auto indexer = grid ? grid->indexer : BucketIndexer(1);
+  for (const auto& record : time_series) {
+    auto idx = indexer.GetBucketIdx(start_time, record.timestamp);
+    UpdateBucket<SumOp>(sum, idx, record.value);
+    UpdateBucket<CountOp>(count, idx, record.value);
+    UpdateBucket<MinOp>(min, idx, record.value);
+    UpdateBucket<MaxOp>(max, idx, record.value);
+    UpdateBucket<LastOp>(last, idx, record.value);
+    if (timestamps) {
+      timestamps->PushBack(record.timestamp);
+    }
+    if (values) {
+      values->PushBack(record.value);
+    }
+  }
+}
+
 }  // namespace tskv
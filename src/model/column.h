@@ -1,16 +1,25 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
 #include <memory>
 #include <optional>
+#include <utility>
 #include <vector>
+#include "model/bitmap.h"
+#include "model/bucket_indexer.h"
+#include "model/encoding.h"
+#include "model/kernels.h"
 #include "model/model.h"
+#include "model/shared_vector.h"
+#include "model/timestamp_runs.h"
 
 namespace tskv {
 
-using CompressedBytes = std::vector<uint8_t>;
-
 template <typename T>
 void Append(CompressedBytes& bytes, const T& value) {
   auto begin = reinterpret_cast<const uint8_t*>(&value);
@@ -26,32 +35,43 @@ void Append(CompressedBytes& bytes, T* value, size_t size) {
 }
 
 struct CompressedBytesReader {
-  explicit CompressedBytesReader(const CompressedBytes& bytes);
+  explicit CompressedBytesReader(BytesView bytes);
 
   template <typename T>
   T Read() {
     assert(offset_ + sizeof(T) <= bytes_.size());
-    auto begin = bytes_.begin() + offset_;
-    auto end = begin + sizeof(T);
-    offset_ += sizeof(T);
     T value;
-    std::copy(begin, end, reinterpret_cast<uint8_t*>(&value));
+    std::memcpy(&value, bytes_.data() + offset_, sizeof(T));
+    offset_ += sizeof(T);
     return value;
   }
 
   template <typename T>
-  std::vector<T> ReadAll() {
-    auto begin = bytes_.begin() + offset_;
-    auto end = bytes_.end();
-    offset_ += (end - begin);
-    std::vector<T> values;
-    values.insert(values.end(), reinterpret_cast<const T*>(&*begin),
-                  reinterpret_cast<const T*>(&*end));
+  std::vector<T> Read(size_t count) {
+    assert(offset_ + count * sizeof(T) <= bytes_.size());
+    std::vector<T> values(count);
+    std::memcpy(values.data(), bytes_.data() + offset_, count * sizeof(T));
+    offset_ += count * sizeof(T);
     return values;
   }
 
+  template <typename T>
+  std::vector<T> ReadAll() {
+    return Read<T>((bytes_.size() - offset_) / sizeof(T));
+  }
+
+  // bytes are not copied
+  BytesView ReadBytes(size_t size) {
+    assert(offset_ + size <= bytes_.size());
+    auto res = bytes_.subspan(offset_, size);
+    offset_ += size;
+    return res;
+  }
+
+  size_t Remaining() const { return bytes_.size() - offset_; }
+
  private:
-  const CompressedBytes& bytes_;
+  BytesView bytes_;
   size_t offset_{0};
 };
 
@@ -72,10 +92,8 @@ enum class ColumnType {
   kAvg,
 };
 
-// I think, that Column should stores data vector with offsets and lengths, so
-// that we don't need to copy data in some cases
-//
-// But for now I implement it in a simple way
+// Columns store data in SharedVector (buffer with offset and length), so
+// that reading a range of a column doesn't copy data
 class IColumn {
  protected:
   using Column = std::shared_ptr<IColumn>;
@@ -111,116 +129,234 @@ class IAggregateColumn : public ISerializableColumn, public IReadColumn {
  public:
   virtual void ScaleBuckets(Duration bucket_interval) = 0;
   virtual size_t GetBucketsNum() const = 0;
+  virtual size_t GetStoredBucketsNum() const = 0;
+  virtual Duration GetBucketInterval() const = 0;
 };
 
-class AggregateColumn {
+// Dense run of buckets, the first one starts at `start`. Bit of presence is
+// set for buckets that got at least one value, others are equal to identity
+template <typename Bucket>
+struct BucketsRun {
+  TimePoint start;
+  SharedVector<Bucket> buckets;
+  Bitmap presence;
+};
+
+// Buckets of the run returned by ReserveBuckets
+template <typename Bucket>
+struct WritableRun {
+  TimePoint start;
+  Bucket* buckets;
+  uint64_t* presence;
+};
+
+// Common part of all bucketed columns: buckets of equal duration aligned to
+// bucket_interval_. Buckets are stored as sorted dense runs, gaps of at least
+// kMinSparseGap empty buckets between them are not stored, so that bursty
+// metrics don't waste memory on empty buckets. Not stored buckets are equal
+// to identity_ and are not present. Usually column has a single run.
+// Integral buckets are bit-packed by ToBytes, on disk all other buckets are
+// doubles
+template <typename Bucket>
+class AggregateColumnBase {
  public:
-  explicit AggregateColumn(Duration bucket_interval);
-  AggregateColumn(std::vector<double> buckets, const TimePoint& start_time,
-                  Duration bucket_interval);
-  ReadColumn Read(const TimeRange& time_range, ColumnType column_type) const;
+  static constexpr size_t kMinSparseGap = 32;
+
+ public:
+  AggregateColumnBase(Duration bucket_interval, Bucket identity);
+  AggregateColumnBase(SharedVector<Bucket> buckets, const TimePoint& start_time,
+                      Duration bucket_interval, Bucket identity);
+  AggregateColumnBase(std::vector<BucketsRun<Bucket>> runs,
+                      Duration bucket_interval, Bucket identity);
+  // not stored buckets are filled with identity
   std::vector<Value> GetValues() const;
+  // presence of every bucket of GetValues
+  Bitmap GetPresence() const;
+  bool IsPresent(size_t bucket_idx) const;
   TimeRange GetTimeRange() const;
-  Column Extract(ColumnType column_type);
   CompressedBytes ToBytes() const;
+  // number of buckets in the time range, including not stored ones
+  size_t GetBucketsNum() const;
+  size_t GetStoredBucketsNum() const;
+  bool IsSparse() const;
+  const std::vector<BucketsRun<Bucket>>& GetRuns() const;
+  Duration GetBucketInterval() const;
+  const BucketIndexer& GetBucketIndexer() const;
 
   std::optional<size_t> GetBucketIdx(TimePoint timestamp) const;
 
-  friend class SumColumn;
-  friend class CountColumn;
-  friend class MinColumn;
-  friend class MaxColumn;
-  friend class LastColumn;
-  friend class AvgColumn;
+  // extends the last run (new buckets are filled with identity) so that every
+  // record of time_series has its bucket, and returns it. If time_series
+  // starts after a long gap, new run is started instead. Presence bits of
+  // written buckets must be set by caller
+  WritableRun<Bucket> ReserveBuckets(const InputTimeSeries& time_series);
 
- private:
-  std::vector<double> buckets_;
-  TimePoint start_time_{};
+ protected:
+  // returns [start_bucket, end_bucket) range of buckets that intersect
+  // time_range, or nullopt if there are no such buckets
+  std::optional<std::pair<size_t, size_t>> GetBucketsRange(
+      const TimeRange& time_range) const;
+  TimePoint GetBucketStart(size_t bucket_idx) const;
+  TimePoint GetRunEnd(const BucketsRun<Bucket>& run) const;
+  // stored parts of [start_bucket, end_bucket) buckets, shares buffers
+  std::vector<BucketsRun<Bucket>> SliceRuns(size_t start_bucket,
+                                            size_t end_bucket) const;
+  // appends run after the last one, short gap is filled with identity
+  void AppendRun(BucketsRun<Bucket> run);
+  // joins runs that intersect [from, to) and gaps between them into a single
+  // run and returns it
+  BucketsRun<Bucket>& DensifyRange(TimePoint from, TimePoint to);
+
+ protected:
+  std::vector<BucketsRun<Bucket>> runs_;
   Duration bucket_interval_;
+  // must be updated together with bucket_interval_
+  BucketIndexer bucket_indexer_;
+  Bucket identity_;
+};
+
+extern template class AggregateColumnBase<double>;
+extern template class AggregateColumnBase<uint64_t>;
+
+// Parses bytes of AggregateColumnBase::ToBytes
+template <typename Bucket>
+std::pair<Duration, std::vector<BucketsRun<Bucket>>> ParseAggregateBytes(
+    BytesView bytes);
+
+// Offsets of parts of bytes of AggregateColumnBase::ToBytes in the extended
+// format, so that buckets of a time range can be fetched without the rest of
+// the page. Bit-packed buckets have a fixed width, so offsets of both plain and
+// bit-packed buckets are computed from their indexes
+struct AggregateIndex {
+  struct Run {
+    // in buckets from the start
+    uint64_t offset;
+    uint64_t size;
+  };
+
+  Duration bucket_interval;
+  TimePoint start;
+  std::vector<Run> runs;
+  // offset of the first double or of bit-packed data, see BitPackEncode
+  size_t buckets_offset{0};
+  bool bit_packed{false};
+  uint64_t packed_min{0};
+  int packed_width{0};
+  // presence words of every run start at a word boundary
+  std::optional<size_t> presence_offset;
 };
 
+// nullopt for dense bytes, their buckets follow the header
+std::optional<AggregateIndex> IndexAggregateBytes(BytesView bytes);
+
+// fetches `size` bytes at `offset` of the page
+using ReadBytesRange =
+    std::function<CompressedBytes(size_t offset, size_t size)>;
+
+// Bytes in the format of AggregateColumnBase::ToBytes of stored buckets of
+// the page which intersect the time range, empty if there are no such buckets
+CompressedBytes ReadAggregateRange(const AggregateIndex& index,
+                                   const TimeRange& time_range,
+                                   const ReadBytesRange& read_range);
+
 using SerializableColumn = std::shared_ptr<ISerializableColumn>;
 using Columns = std::vector<Column>;
 using SerializableColumns = std::vector<SerializableColumn>;
 
-class SumColumn : public IAggregateColumn {
- public:
-  explicit SumColumn(Duration bucket_interval);
-  SumColumn(std::vector<double> buckets, const TimePoint& start_time,
-            Duration bucket_interval);
-  ColumnType GetType() const override;
-  void ScaleBuckets(Duration bucket_interval) override;
-  void Merge(Column column) override;
-  void Write(const InputTimeSeries& time_series) override;
-  ReadColumn Read(const TimeRange& time_range) const override;
-  std::vector<Value> GetValues() const override;
-  TimeRange GetTimeRange() const override;
-  Column Extract() override;
-  CompressedBytes ToBytes() const override;
-  size_t GetBucketsNum() const override;
-
-  friend class AvgColumn;
+// Aggregation operations of AggregateColumn. Every operation provides:
+//  Bucket    - type of buckets, counts are kept as integers
+//  kType     - type of the column
+//  kIdentity - value of the empty bucket
+//  Combine   - combines two buckets, used by Merge and ScaleBuckets
+//  Update    - updates bucket with a new value, used by Write
+//  ReduceGroups - combines every `scale` consecutive buckets, used by
+//                 ScaleBuckets (see model/kernels.h)
+struct SumOp {
+  using Bucket = double;
+  static constexpr ColumnType kType = ColumnType::kSum;
+  static constexpr double kIdentity = 0;
+  static constexpr double Combine(double lhs, double rhs) { return lhs + rhs; }
+  static constexpr double Update(double bucket, Value value) {
+    return bucket + value;
+  }
+  static void ReduceGroups(const double* data, size_t groups, size_t scale,
+                           double* out) {
+    SumGroups(data, groups, scale, out);
+  }
+};
 
- private:
-  AggregateColumn column_;
-  std::vector<double>& buckets_;
-  TimePoint& start_time_;
-  Duration& bucket_interval_;
+struct CountOp {
+  using Bucket = uint64_t;
+  static constexpr ColumnType kType = ColumnType::kCount;
+  static constexpr uint64_t kIdentity = 0;
+  static constexpr uint64_t Combine(uint64_t lhs, uint64_t rhs) {
+    return lhs + rhs;
+  }
+  static constexpr uint64_t Update(uint64_t bucket, Value) {
+    return bucket + 1;
+  }
+  static void ReduceGroups(const uint64_t* data, size_t groups, size_t scale,
+                           uint64_t* out) {
+    SumGroups(data, groups, scale, out);
+  }
 };
 
-class CountColumn : public IAggregateColumn {
- public:
-  explicit CountColumn(Duration bucket_interval);
-  CountColumn(std::vector<double> buckets, const TimePoint& start_time,
-              Duration bucket_interval);
-  ColumnType GetType() const override;
-  void ScaleBuckets(Duration bucket_interval) override;
-  void Merge(Column column) override;
-  void Write(const InputTimeSeries& time_series) override;
-  ReadColumn Read(const TimeRange& time_range) const override;
-  std::vector<Value> GetValues() const override;
-  TimeRange GetTimeRange() const override;
-  Column Extract() override;
-  CompressedBytes ToBytes() const override;
-  size_t GetBucketsNum() const override;
+struct MinOp {
+  using Bucket = double;
+  static constexpr ColumnType kType = ColumnType::kMin;
+  static constexpr double kIdentity = std::numeric_limits<double>::max();
+  static constexpr double Combine(double lhs, double rhs) {
+    return std::min(lhs, rhs);
+  }
+  static constexpr double Update(double bucket, Value value) {
+    return std::min(bucket, value);
+  }
+  static void ReduceGroups(const double* data, size_t groups, size_t scale,
+                           double* out) {
+    MinGroups(data, groups, scale, out);
+  }
+};
 
-  friend class AvgColumn;
+struct MaxOp {
+  using Bucket = double;
+  static constexpr ColumnType kType = ColumnType::kMax;
+  static constexpr double kIdentity = std::numeric_limits<double>::lowest();
+  static constexpr double Combine(double lhs, double rhs) {
+    return std::max(lhs, rhs);
+  }
+  static constexpr double Update(double bucket, Value value) {
+    return std::max(bucket, value);
+  }
+  static void ReduceGroups(const double* data, size_t groups, size_t scale,
+                           double* out) {
+    MaxGroups(data, groups, scale, out);
+  }
+};
 
- private:
-  AggregateColumn column_;
-  std::vector<double>& buckets_;
-  TimePoint& start_time_;
-  Duration& bucket_interval_;
+struct LastOp {
+  using Bucket = double;
+  static constexpr ColumnType kType = ColumnType::kLast;
+  static constexpr double kIdentity = 0;
+  static constexpr double Combine(double, double rhs) { return rhs; }
+  static constexpr double Update(double, Value value) { return value; }
+  static void ReduceGroups(const double* data, size_t groups, size_t scale,
+                           double* out) {
+    LastGroups(data, groups, scale, out);
+  }
 };
 
-class MinColumn : public IAggregateColumn {
+template <typename Op, typename Bucket = typename Op::Bucket>
+class AggregateColumn : public IAggregateColumn,
+                        public AggregateColumnBase<Bucket> {
  public:
-  explicit MinColumn(Duration bucket_interval);
-  MinColumn(std::vector<double> buckets, const TimePoint& start_time,
-            Duration bucket_interval);
-  ColumnType GetType() const override;
-  void ScaleBuckets(Duration bucket_interval) override;
-  void Merge(Column column) override;
-  void Write(const InputTimeSeries& time_series) override;
-  ReadColumn Read(const TimeRange& time_range) const override;
-  std::vector<Value> GetValues() const override;
-  TimeRange GetTimeRange() const override;
-  Column Extract() override;
-  CompressedBytes ToBytes() const override;
-  size_t GetBucketsNum() const override;
-
- private:
-  AggregateColumn column_;
-  std::vector<double>& buckets_;
-  TimePoint& start_time_;
-  Duration& bucket_interval_;
-};
+  using BucketType = Bucket;
 
-class MaxColumn : public IAggregateColumn {
  public:
-  explicit MaxColumn(Duration bucket_interval);
-  MaxColumn(std::vector<double> buckets, const TimePoint& start_time,
-            Duration bucket_interval);
+  explicit AggregateColumn(Duration bucket_interval);
+  AggregateColumn(SharedVector<Bucket> buckets, const TimePoint& start_time,
+                  Duration bucket_interval);
+  AggregateColumn(std::vector<BucketsRun<Bucket>> runs,
+                  Duration bucket_interval);
   ColumnType GetType() const override;
   void ScaleBuckets(Duration bucket_interval) override;
   void Merge(Column column) override;
@@ -231,44 +367,42 @@ class MaxColumn : public IAggregateColumn {
   Column Extract() override;
   CompressedBytes ToBytes() const override;
   size_t GetBucketsNum() const override;
+  size_t GetStoredBucketsNum() const override;
+  Duration GetBucketInterval() const override;
 
  private:
-  AggregateColumn column_;
-  std::vector<double>& buckets_;
-  TimePoint& start_time_;
-  Duration& bucket_interval_;
+  using Base = AggregateColumnBase<Bucket>;
+  using Base::AppendRun;
+  using Base::bucket_indexer_;
+  using Base::bucket_interval_;
+  using Base::DensifyRange;
+  using Base::GetBucketsRange;
+  using Base::GetRunEnd;
+  using Base::runs_;
+  using Base::SliceRuns;
 };
 
-class LastColumn : public IAggregateColumn {
- public:
-  explicit LastColumn(Duration bucket_interval);
-  LastColumn(std::vector<double> buckets, const TimePoint& start_time,
-             Duration bucket_interval);
-  ColumnType GetType() const override;
-  void ScaleBuckets(Duration bucket_interval) override;
-  void Merge(Column column) override;
-  void Write(const InputTimeSeries& time_series) override;
-  ReadColumn Read(const TimeRange& time_range) const override;
-  std::vector<Value> GetValues() const override;
-  TimeRange GetTimeRange() const override;
-  Column Extract() override;
-  CompressedBytes ToBytes() const override;
-  size_t GetBucketsNum() const override;
+using SumColumn = AggregateColumn<SumOp>;
+using CountColumn = AggregateColumn<CountOp>;
+using MinColumn = AggregateColumn<MinOp>;
+using MaxColumn = AggregateColumn<MaxOp>;
+using LastColumn = AggregateColumn<LastOp>;
 
- private:
-  AggregateColumn column_;
-  std::vector<double>& buckets_;
-  TimePoint& start_time_;
-  Duration& bucket_interval_;
-};
+extern template class AggregateColumn<SumOp>;
+extern template class AggregateColumn<CountOp>;
+extern template class AggregateColumn<MinOp>;
+extern template class AggregateColumn<MaxOp>;
+extern template class AggregateColumn<LastOp>;
 
 class RawTimestampsColumn : public ISerializableColumn {
  public:
   friend class ReadRawColumn;
   RawTimestampsColumn() = default;
   explicit RawTimestampsColumn(std::vector<TimePoint> timestamps);
+  explicit RawTimestampsColumn(TimestampRuns timestamps);
   ColumnType GetType() const override;
   CompressedBytes ToBytes() const override;
+  CompressedBytes ToBytes(RawTimestampsEncoding encoding) const;
   void Merge(Column column) override;
   void Write(const InputTimeSeries& time_series) override;
   // not the best way to return timestamps, but I didn't want to break the interface
@@ -276,26 +410,32 @@ class RawTimestampsColumn : public ISerializableColumn {
   Column Extract() override;
   TimeRange GetTimeRange() const;
   size_t TimestampsNum() const;
+  TimePoint At(size_t idx) const;
+  size_t GetBytesSize() const;
+  void PushBack(TimePoint timestamp);
 
  private:
-  std::vector<TimePoint> timestamps_;
+  TimestampRuns timestamps_;
 };
 
 class RawValuesColumn : public ISerializableColumn {
  public:
   friend class ReadRawColumn;
   RawValuesColumn() = default;
-  explicit RawValuesColumn(std::vector<Value> values);
+  explicit RawValuesColumn(SharedVector<Value> values);
   ColumnType GetType() const override;
   CompressedBytes ToBytes() const override;
+  CompressedBytes ToBytes(RawValuesEncoding encoding) const;
   void Merge(Column column) override;
   void Write(const InputTimeSeries& time_series) override;
   std::vector<Value> GetValues() const override;
   Column Extract() override;
   size_t ValuesNum() const;
+  void Reserve(size_t size);
+  void PushBack(Value value);
 
  private:
-  std::vector<Value> values_;
+  SharedVector<Value> values_;
 };
 
 class ReadRawColumn : public IReadColumn {
@@ -318,10 +458,11 @@ class ReadRawColumn : public IReadColumn {
   std::shared_ptr<RawValuesColumn> values_column_;
 };
 
-class AvgColumn : public IReadColumn {
+class AvgColumn : public IReadColumn, public AggregateColumnBase<double> {
  public:
-  AvgColumn(std::vector<double> buckets, const TimePoint& start_time,
+  AvgColumn(SharedVector<double> buckets, const TimePoint& start_time,
             Duration bucket_interval);
+  AvgColumn(std::vector<BucketsRun<double>> runs, Duration bucket_interval);
   AvgColumn(std::shared_ptr<SumColumn> sum_column,
             std::shared_ptr<CountColumn> count_column);
   ColumnType GetType() const override;
@@ -333,12 +474,9 @@ class AvgColumn : public IReadColumn {
   Column Extract() override;
 
  private:
-  static AggregateColumn CreateAvgAggregateColumn(
+  static AggregateColumnBase<double> CreateAvgAggregateColumn(
       std::shared_ptr<SumColumn> sum_column,
       std::shared_ptr<CountColumn> count_column);
-
- private:
-  AggregateColumn column_;
 };
 
 template <typename T>
@@ -355,17 +493,29 @@ Column CreateAggregatedColumn(ColumnType column_type, Duration bucket_interval);
 
 Column CreateRawColumn(ColumnType column_type);
 
+// Writes time series into all columns in a single pass: bucket index of every
+// record is computed once for all aggregate columns that share buckets (as
+// memtable columns do) and raw columns are appended in the same loop. Other
+// columns are written one by one.
+void WriteColumns(const Columns& columns, const InputTimeSeries& time_series);
+
 template <typename T>
-Column AggregateFromBytes(const CompressedBytes& bytes) {
-  auto reader = CompressedBytesReader(bytes);
-  auto bucket_interval = reader.Read<size_t>();
-  auto start = reader.Read<TimePoint>();
-  auto buckets = reader.ReadAll<Value>();
-  auto col = std::make_shared<T>(buckets, start, bucket_interval);
+Column AggregateFromBytes(BytesView bytes) {
+  auto [bucket_interval, runs] =
+      ParseAggregateBytes<typename T::BucketType>(bytes);
+  auto col = std::make_shared<T>(std::move(runs), bucket_interval);
   auto read_column = std::static_pointer_cast<IReadColumn>(col);
   return std::static_pointer_cast<IColumn>(read_column);
 }
 
-Column FromBytes(const CompressedBytes& bytes, ColumnType column_type);
+Column FromBytes(BytesView bytes, ColumnType column_type);
+
+// size of data the column keeps in memory
+size_t GetColumnBytesSize(const Column& column);
+
+// Unlike IColumn::Merge, which expects `rhs` to follow `lhs`, merges read
+// columns of the same type in any order, e.g. pages of late records with
+// pages they overlap. Either argument may be reused for the result
+ReadColumn MergeUnordered(ReadColumn lhs, ReadColumn rhs);
 
 }  // namespace tskv
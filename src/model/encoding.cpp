@@ -0,0 +1,470 @@
+#include "encoding.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include "model/timestamp_runs.h"
+
+namespace tskv {
+
+namespace {
+
+uint64_t LowBits(uint64_t value, int bits) {
+  return bits == 64 ? value : value & ((uint64_t{1} << bits) - 1);
+}
+
+static_assert(sizeof(Value) == sizeof(TimePoint));
+
+constexpr size_t kRawItemSize = sizeof(Value);
+constexpr size_t kRawPageHeaderSize = sizeof(uint8_t) + sizeof(uint64_t);
+
+template <typename T>
+CompressedBytes PlainRawPage(std::span<const T> data) {
+  auto begin = reinterpret_cast<const uint8_t*>(data.data());
+  return {begin, begin + data.size() * sizeof(T)};
+}
+
+void BeginRawPage(CompressedBytes& bytes, uint8_t encoding, uint64_t count) {
+  // resize instead of inserts, which GCC mistakes for overflows when the
+  // page is empty
+  auto offset = bytes.size();
+  bytes.resize(offset + kRawPageHeaderSize);
+  bytes[offset] = encoding;
+  std::memcpy(bytes.data() + offset + sizeof(encoding), &count, sizeof(count));
+}
+
+void FinishRawPage(CompressedBytes& bytes) {
+  if (bytes.size() % kRawItemSize == 0) {
+    bytes.push_back(0);
+  }
+}
+
+bool IsPlainRawPage(BytesView bytes) {
+  return bytes.size() % kRawItemSize == 0;
+}
+
+std::pair<uint8_t, uint64_t> ReadRawPageHeader(BytesView bytes) {
+  if (bytes.size() < kRawPageHeaderSize) {
+    throw std::runtime_error("Corrupted raw page");
+  }
+  uint64_t count;
+  std::memcpy(&count, bytes.data() + sizeof(uint8_t), sizeof(count));
+  return {bytes[0], count};
+}
+
+uint64_t ZigZag(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^
+         static_cast<uint64_t>(value >> 63);
+}
+
+int64_t UnZigZag(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+}  // namespace
+
+BitWriter::BitWriter(CompressedBytes& bytes) : bytes_(bytes) {}
+
+void BitWriter::Write(uint64_t value, int bits) {
+  assert(bits >= 0 && bits <= 64);
+  value = LowBits(value, bits);
+  while (bits > 0) {
+    int free = 64 - buffered_;
+    int n = std::min(bits, free);
+    auto chunk = LowBits(value >> (bits - n), n);
+    buffer_ = n == 64 ? chunk : (buffer_ << n) | chunk;
+    buffered_ += n;
+    bits -= n;
+    if (buffered_ == 64) {
+      for (int shift = 56; shift >= 0; shift -= 8) {
+        bytes_.push_back(static_cast<uint8_t>(buffer_ >> shift));
+      }
+      buffer_ = 0;
+      buffered_ = 0;
+    }
+  }
+}
+
+void BitWriter::WriteBit(bool bit) {
+  Write(bit, 1);
+}
+
+void BitWriter::Flush() {
+  if (buffered_ == 0) {
+    return;
+  }
+  auto aligned = buffer_ << (64 - buffered_);
+  for (int i = 0; i < (buffered_ + 7) / 8; ++i) {
+    bytes_.push_back(static_cast<uint8_t>(aligned >> (56 - 8 * i)));
+  }
+  buffer_ = 0;
+  buffered_ = 0;
+}
+
+BitReader::BitReader(const uint8_t* data, size_t size)
+    : data_(data), end_(data + size) {}
+
+void BitReader::Refill() {
+  if (data_ == end_) {
+    throw std::runtime_error("Unexpected end of encoded data");
+  }
+  buffer_ = 0;
+  buffered_ = 0;
+  while (buffered_ < 64 && data_ != end_) {
+    buffer_ |= static_cast<uint64_t>(*data_++) << (56 - buffered_);
+    buffered_ += 8;
+  }
+}
+
+uint64_t BitReader::Read(int bits) {
+  assert(bits >= 0 && bits <= 64);
+  uint64_t result = 0;
+  while (bits > 0) {
+    if (buffered_ == 0) {
+      Refill();
+    }
+    int n = std::min(bits, buffered_);
+    auto chunk = buffer_ >> (64 - n);
+    result = n == 64 ? chunk : (result << n) | chunk;
+    buffer_ = n == 64 ? 0 : buffer_ << n;
+    buffered_ -= n;
+    bits -= n;
+  }
+  return result;
+}
+
+bool BitReader::ReadBit() {
+  return Read(1);
+}
+
+size_t BitReader::ReadZeroes(size_t max) {
+  size_t read = 0;
+  while (read < max) {
+    if (buffered_ == 0) {
+      if (data_ == end_) {
+        break;
+      }
+      Refill();
+    }
+    int available = buffered_;
+    int zeroes = std::min(std::countl_zero(buffer_), available);
+    int take = static_cast<int>(std::min<size_t>(zeroes, max - read));
+    buffer_ = take == 64 ? 0 : buffer_ << take;
+    buffered_ -= take;
+    read += take;
+    if (take < available) {
+      break;
+    }
+  }
+  return read;
+}
+
+// Every value is XORed with the previous one:
+//  '0'                      - same value
+//  '10' + meaningful bits   - xor fits into previous leading/trailing window
+//  '11' + 5 bits of leading zeroes + 6 bits of meaningful bits length - 1 +
+//         meaningful bits
+void GorillaEncode(std::span<const Value> values, BitWriter& writer) {
+  if (values.empty()) {
+    return;
+  }
+  auto prev = std::bit_cast<uint64_t>(values.front());
+  writer.Write(prev, 64);
+  int prev_leading = -1;
+  int prev_trailing = 0;
+  for (size_t i = 1; i < values.size(); ++i) {
+    auto cur = std::bit_cast<uint64_t>(values[i]);
+    auto xored = cur ^ prev;
+    prev = cur;
+    if (xored == 0) {
+      writer.WriteBit(false);
+      continue;
+    }
+    writer.WriteBit(true);
+    int leading = std::min(std::countl_zero(xored), 31);
+    int trailing = std::countr_zero(xored);
+    if (prev_leading != -1 && leading >= prev_leading &&
+        trailing >= prev_trailing) {
+      writer.WriteBit(false);
+      writer.Write(xored >> prev_trailing, 64 - prev_leading - prev_trailing);
+      continue;
+    }
+    int meaningful = 64 - leading - trailing;
+    writer.WriteBit(true);
+    writer.Write(leading, 5);
+    writer.Write(meaningful - 1, 6);
+    writer.Write(xored >> trailing, meaningful);
+    prev_leading = leading;
+    prev_trailing = trailing;
+  }
+}
+
+void GorillaDecode(BitReader& reader, size_t count,
+                   std::vector<Value>& values) {
+  if (count == 0) {
+    return;
+  }
+  values.reserve(values.size() + count);
+  auto prev = reader.Read(64);
+  values.push_back(std::bit_cast<Value>(prev));
+  int leading = 0;
+  int trailing = 0;
+  for (size_t i = 1; i < count; ++i) {
+    if (!reader.ReadBit()) {
+      values.push_back(std::bit_cast<Value>(prev));
+      continue;
+    }
+    if (reader.ReadBit()) {
+      leading = static_cast<int>(reader.Read(5));
+      int meaningful = static_cast<int>(reader.Read(6)) + 1;
+      trailing = 64 - leading - meaningful;
+    }
+    auto xored = reader.Read(64 - leading - trailing) << trailing;
+    prev ^= xored;
+    values.push_back(std::bit_cast<Value>(prev));
+  }
+}
+
+// Delta-of-delta of every timestamp is zigzag encoded and written as:
+//  '0'                  - same delta as previous one
+//  '10'    + 7 bits
+//  '110'   + 9 bits
+//  '1110'  + 12 bits
+//  '11110' + 32 bits
+//  '11111' + 64 bits
+// First delta is encoded as delta-of-delta with zero
+void DeltaOfDeltaEncode(const std::vector<TimePoint>& timestamps,
+                        BitWriter& writer) {
+  if (timestamps.empty()) {
+    return;
+  }
+  writer.Write(timestamps.front(), 64);
+  uint64_t prev_delta = 0;
+  for (size_t i = 1; i < timestamps.size(); ++i) {
+    uint64_t delta = timestamps[i] - timestamps[i - 1];
+    auto encoded = ZigZag(static_cast<int64_t>(delta - prev_delta));
+    prev_delta = delta;
+    if (encoded == 0) {
+      writer.WriteBit(false);
+    } else if (encoded < (uint64_t{1} << 7)) {
+      writer.Write(0b10, 2);
+      writer.Write(encoded, 7);
+    } else if (encoded < (uint64_t{1} << 9)) {
+      writer.Write(0b110, 3);
+      writer.Write(encoded, 9);
+    } else if (encoded < (uint64_t{1} << 12)) {
+      writer.Write(0b1110, 4);
+      writer.Write(encoded, 12);
+    } else if (encoded < (uint64_t{1} << 32)) {
+      writer.Write(0b11110, 5);
+      writer.Write(encoded, 32);
+    } else {
+      writer.Write(0b11111, 5);
+      writer.Write(encoded, 64);
+    }
+  }
+}
+
+void DeltaOfDeltaDecode(BitReader& reader, size_t count,
+                        std::vector<TimePoint>& timestamps) {
+  if (count == 0) {
+    return;
+  }
+  timestamps.reserve(timestamps.size() + count);
+  TimePoint timestamp = reader.Read(64);
+  timestamps.push_back(timestamp);
+  uint64_t delta = 0;
+  size_t decoded = 1;
+  while (decoded < count) {
+    // fast path for regular series: whole run of unchanged deltas is consumed
+    // at once
+    auto same_deltas = reader.ReadZeroes(count - decoded);
+    for (size_t i = 0; i < same_deltas; ++i) {
+      timestamp += delta;
+      timestamps.push_back(timestamp);
+    }
+    decoded += same_deltas;
+    if (decoded == count) {
+      break;
+    }
+
+    reader.ReadBit();
+    int width = 64;
+    if (!reader.ReadBit()) {
+      width = 7;
+    } else if (!reader.ReadBit()) {
+      width = 9;
+    } else if (!reader.ReadBit()) {
+      width = 12;
+    } else if (!reader.ReadBit()) {
+      width = 32;
+    }
+    delta += static_cast<uint64_t>(UnZigZag(reader.Read(width)));
+    timestamp += delta;
+    timestamps.push_back(timestamp);
+    ++decoded;
+  }
+}
+
+void BitPackEncode(std::span<const uint64_t> values, BitWriter& writer) {
+  if (values.empty()) {
+    return;
+  }
+  auto [min, max] = std::ranges::minmax(values);
+  int width = std::bit_width(max - min);
+  writer.Write(min, 64);
+  writer.Write(width, 7);
+  for (auto value : values) {
+    writer.Write(value - min, width);
+  }
+}
+
+void BitPackDecode(BitReader& reader, size_t count,
+                   std::vector<uint64_t>& values) {
+  if (count == 0) {
+    return;
+  }
+  values.reserve(values.size() + count);
+  auto min = reader.Read(64);
+  int width = static_cast<int>(reader.Read(7));
+  for (size_t i = 0; i < count; ++i) {
+    values.push_back(min + reader.Read(width));
+  }
+}
+
+CompressedBytes EncodeRawValues(std::span<const Value> values,
+                                RawValuesEncoding encoding) {
+  if (encoding == RawValuesEncoding::kPlain) {
+    return PlainRawPage(values);
+  }
+
+  CompressedBytes res;
+  BeginRawPage(res, static_cast<uint8_t>(encoding), values.size());
+  BitWriter writer(res);
+  switch (encoding) {
+    case RawValuesEncoding::kGorilla:
+      GorillaEncode(values, writer);
+      break;
+    default:
+      throw std::runtime_error("Unknown raw values encoding");
+  }
+  writer.Flush();
+  FinishRawPage(res);
+  return res;
+}
+
+std::vector<Value> DecodeRawValues(BytesView bytes) {
+  if (IsPlainRawPage(bytes)) {
+    auto data = reinterpret_cast<const Value*>(bytes.data());
+    return {data, data + bytes.size() / sizeof(Value)};
+  }
+
+  auto [encoding, count] = ReadRawPageHeader(bytes);
+  BitReader reader(bytes.data() + kRawPageHeaderSize,
+                   bytes.size() - kRawPageHeaderSize);
+  std::vector<Value> values;
+  switch (static_cast<RawValuesEncoding>(encoding)) {
+    case RawValuesEncoding::kGorilla:
+      GorillaDecode(reader, count, values);
+      break;
+    default:
+      throw std::runtime_error("Unknown raw values encoding");
+  }
+  return values;
+}
+
+CompressedBytes EncodeRawTimestamps(const std::vector<TimePoint>& timestamps,
+                                    RawTimestampsEncoding encoding) {
+  if (encoding == RawTimestampsEncoding::kPlain) {
+    return PlainRawPage<TimePoint>(timestamps);
+  }
+
+  if (encoding == RawTimestampsEncoding::kRuns) {
+    auto runs = TimestampRuns::DetectRuns(timestamps);
+    if (runs.size() * TimestampRuns::kMinAverageRunLength <=
+        timestamps.size()) {
+      return EncodeTimestampRuns(runs);
+    }
+    encoding = RawTimestampsEncoding::kDeltaOfDelta;
+  }
+
+  CompressedBytes res;
+  BeginRawPage(res, static_cast<uint8_t>(encoding), timestamps.size());
+  BitWriter writer(res);
+  switch (encoding) {
+    case RawTimestampsEncoding::kDeltaOfDelta:
+      DeltaOfDeltaEncode(timestamps, writer);
+      break;
+    default:
+      throw std::runtime_error("Unknown raw timestamps encoding");
+  }
+  writer.Flush();
+  FinishRawPage(res);
+  return res;
+}
+
+void DecodeRawTimestamps(BytesView bytes, std::vector<TimePoint>& timestamps) {
+  if (IsPlainRawPage(bytes)) {
+    auto data = reinterpret_cast<const TimePoint*>(bytes.data());
+    timestamps.insert(timestamps.end(), data,
+                      data + bytes.size() / sizeof(TimePoint));
+    return;
+  }
+
+  auto [encoding, count] = ReadRawPageHeader(bytes);
+  BitReader reader(bytes.data() + kRawPageHeaderSize,
+                   bytes.size() - kRawPageHeaderSize);
+  switch (static_cast<RawTimestampsEncoding>(encoding)) {
+    case RawTimestampsEncoding::kDeltaOfDelta:
+      DeltaOfDeltaDecode(reader, count, timestamps);
+      break;
+    case RawTimestampsEncoding::kRuns: {
+      timestamps.reserve(timestamps.size() + count);
+      for (const auto& run : DecodeTimestampRuns(bytes)) {
+        for (size_t i = 0; i < run.length; ++i) {
+          timestamps.push_back(run.At(i));
+        }
+      }
+      break;
+    }
+    default:
+      throw std::runtime_error("Unknown raw timestamps encoding");
+  }
+}
+
+CompressedBytes EncodeTimestampRuns(const std::vector<TimestampRun>& runs) {
+  uint64_t count = 0;
+  for (const auto& run : runs) {
+    count += run.length;
+  }
+  CompressedBytes res;
+  BeginRawPage(res, static_cast<uint8_t>(RawTimestampsEncoding::kRuns), count);
+  if (!runs.empty()) {
+    res.resize(kRawPageHeaderSize + runs.size() * sizeof(TimestampRun));
+    std::memcpy(res.data() + kRawPageHeaderSize, runs.data(),
+                runs.size() * sizeof(TimestampRun));
+  }
+  FinishRawPage(res);
+  return res;
+}
+
+bool IsTimestampRunsPage(BytesView bytes) {
+  return !IsPlainRawPage(bytes) &&
+         ReadRawPageHeader(bytes).first ==
+             static_cast<uint8_t>(RawTimestampsEncoding::kRuns);
+}
+
+std::vector<TimestampRun> DecodeTimestampRuns(BytesView bytes) {
+  assert(IsTimestampRunsPage(bytes));
+  auto runs_num = (bytes.size() - kRawPageHeaderSize) / sizeof(TimestampRun);
+  std::vector<TimestampRun> runs(runs_num);
+  std::memcpy(runs.data(), bytes.data() + kRawPageHeaderSize,
+              runs_num * sizeof(TimestampRun));
+  return runs;
+}
+
+}  // namespace tskv
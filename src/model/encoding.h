@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "model/model.h"
+
+namespace tskv {
+
+using CompressedBytes = std::vector<uint8_t>;
+// bytes of a page that are only decoded, e.g. of a mapped file
+using BytesView = std::span<const uint8_t>;
+
+enum class RawValuesEncoding : uint8_t {
+  kPlain,
+  kGorilla,
+};
+
+enum class RawTimestampsEncoding : uint8_t {
+  kPlain,
+  kDeltaOfDelta,
+  // (start, step, length) run descriptors, pages of irregular series fall back
+  // to kDeltaOfDelta
+  kRuns,
+};
+
+struct TimestampRun {
+  TimePoint start;
+  uint64_t step;
+  uint64_t length;
+
+  TimePoint At(size_t idx) const { return start + step * idx; }
+  TimePoint Back() const { return At(length - 1); }
+};
+
+// Writes bits MSB-first, so that encoded stream can be read sequentially by
+// BitReader
+class BitWriter {
+ public:
+  explicit BitWriter(CompressedBytes& bytes);
+  // writes `bits` lowest bits of `value`, bits <= 64
+  void Write(uint64_t value, int bits);
+  void WriteBit(bool bit);
+  // writes not yet written bits, padding last byte with zeroes
+  void Flush();
+
+ private:
+  CompressedBytes& bytes_;
+  uint64_t buffer_{0};
+  int buffered_{0};
+};
+
+class BitReader {
+ public:
+  BitReader(const uint8_t* data, size_t size);
+  // reads `bits` bits, bits <= 64
+  uint64_t Read(int bits);
+  bool ReadBit();
+  // consumes consecutive zero bits, but not more than `max`, and returns their
+  // number
+  size_t ReadZeroes(size_t max);
+
+ private:
+  void Refill();
+
+ private:
+  const uint8_t* data_;
+  const uint8_t* end_;
+  uint64_t buffer_{0};
+  int buffered_{0};
+};
+
+// Gorilla XOR compression of floating point values, see
+// https://www.vldb.org/pvldb/vol8/p1816-teller.pdf
+void GorillaEncode(std::span<const Value> values, BitWriter& writer);
+void GorillaDecode(BitReader& reader, size_t count, std::vector<Value>& values);
+
+// Delta-of-delta compression of sorted timestamps, zigzag encoded
+// delta-of-deltas are packed into buckets of several widths
+void DeltaOfDeltaEncode(const std::vector<TimePoint>& timestamps,
+                        BitWriter& writer);
+void DeltaOfDeltaDecode(BitReader& reader, size_t count,
+                        std::vector<TimePoint>& timestamps);
+
+// Frame-of-reference bit-packing of unsigned integers: minimum of values is
+// stored once, and every value is stored as a fixed-width offset from it
+void BitPackEncode(std::span<const uint64_t> values, BitWriter& writer);
+void BitPackDecode(BitReader& reader, size_t count,
+                   std::vector<uint64_t>& values);
+
+// Raw pages written before encodings were introduced are plain arrays of
+// values or timestamps, so their size is always a multiple of 8 bytes. Encoded
+// pages start with encoding tag and are padded to never be such a multiple,
+// that's how Decode* functions distinguish them.
+CompressedBytes EncodeRawValues(std::span<const Value> values,
+                                RawValuesEncoding encoding);
+std::vector<Value> DecodeRawValues(BytesView bytes);
+CompressedBytes EncodeRawTimestamps(const std::vector<TimePoint>& timestamps,
+                                    RawTimestampsEncoding encoding);
+// appends decoded timestamps to `timestamps`
+void DecodeRawTimestamps(BytesView bytes, std::vector<TimePoint>& timestamps);
+CompressedBytes EncodeTimestampRuns(const std::vector<TimestampRun>& runs);
+bool IsTimestampRunsPage(BytesView bytes);
+std::vector<TimestampRun> DecodeTimestampRuns(BytesView bytes);
+
+}  // namespace tskv
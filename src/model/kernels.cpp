@@ -0,0 +1,153 @@
+#include "kernels.h"
+
+#include <algorithm>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TSKV_X86_KERNELS
+#endif
+
+namespace tskv {
+
+namespace {
+
+// vector kernels don't pay off for groups shorter than one register
+constexpr size_t kMinVectorScale = 4;
+
+template <typename T, typename Combine>
+void ReduceGroupsScalar(const T* data, size_t groups, size_t scale, T* out,
+                        T identity, Combine combine) {
+  for (size_t group = 0; group < groups; ++group) {
+    const T* begin = data + group * scale;
+    T acc = identity;
+    for (size_t i = 0; i < scale; ++i) {
+      acc = combine(acc, begin[i]);
+    }
+    out[group] = acc;
+  }
+}
+
+#ifdef TSKV_X86_KERNELS
+
+__attribute__((target("avx2"))) void SumGroupsAvx2(const double* data,
+                                                   size_t groups, size_t scale,
+                                                   double* out) {
+  for (size_t group = 0; group < groups; ++group) {
+    const double* begin = data + group * scale;
+    __m256d acc = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= scale; i += 4) {
+      acc = _mm256_add_pd(acc, _mm256_loadu_pd(begin + i));
+    }
+    __m128d half =
+        _mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+    double sum = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+    for (; i < scale; ++i) {
+      sum += begin[i];
+    }
+    out[group] = sum;
+  }
+}
+
+__attribute__((target("avx2"))) void MinGroupsAvx2(const double* data,
+                                                   size_t groups, size_t scale,
+                                                   double* out) {
+  for (size_t group = 0; group < groups; ++group) {
+    const double* begin = data + group * scale;
+    __m256d acc = _mm256_set1_pd(std::numeric_limits<double>::max());
+    size_t i = 0;
+    for (; i + 4 <= scale; i += 4) {
+      acc = _mm256_min_pd(acc, _mm256_loadu_pd(begin + i));
+    }
+    __m128d half =
+        _mm_min_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+    double min = _mm_cvtsd_f64(_mm_min_sd(half, _mm_unpackhi_pd(half, half)));
+    for (; i < scale; ++i) {
+      min = std::min(min, begin[i]);
+    }
+    out[group] = min;
+  }
+}
+
+__attribute__((target("avx2"))) void MaxGroupsAvx2(const double* data,
+                                                   size_t groups, size_t scale,
+                                                   double* out) {
+  for (size_t group = 0; group < groups; ++group) {
+    const double* begin = data + group * scale;
+    __m256d acc = _mm256_set1_pd(std::numeric_limits<double>::lowest());
+    size_t i = 0;
+    for (; i + 4 <= scale; i += 4) {
+      acc = _mm256_max_pd(acc, _mm256_loadu_pd(begin + i));
+    }
+    __m128d half =
+        _mm_max_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+    double max = _mm_cvtsd_f64(_mm_max_sd(half, _mm_unpackhi_pd(half, half)));
+    for (; i < scale; ++i) {
+      max = std::max(max, begin[i]);
+    }
+    out[group] = max;
+  }
+}
+
+#endif
+
+}  // namespace
+
+bool HasAvx2() {
+#ifdef TSKV_X86_KERNELS
+  static const bool kHasAvx2 = __builtin_cpu_supports("avx2");
+  return kHasAvx2;
+#else
+  return false;
+#endif
+}
+
+void SumGroups(const double* data, size_t groups, size_t scale, double* out) {
+#ifdef TSKV_X86_KERNELS
+  if (scale >= kMinVectorScale && HasAvx2()) {
+    SumGroupsAvx2(data, groups, scale, out);
+    return;
+  }
+#endif
+  ReduceGroupsScalar(data, groups, scale, out, 0.0,
+                     [](double lhs, double rhs) { return lhs + rhs; });
+}
+
+void SumGroups(const uint64_t* data, size_t groups, size_t scale,
+               uint64_t* out) {
+  ReduceGroupsScalar(data, groups, scale, out, uint64_t{0},
+                     [](uint64_t lhs, uint64_t rhs) { return lhs + rhs; });
+}
+
+void MinGroups(const double* data, size_t groups, size_t scale, double* out) {
+#ifdef TSKV_X86_KERNELS
+  if (scale >= kMinVectorScale && HasAvx2()) {
+    MinGroupsAvx2(data, groups, scale, out);
+    return;
+  }
+#endif
+  ReduceGroupsScalar(data, groups, scale, out,
+                     std::numeric_limits<double>::max(),
+                     [](double lhs, double rhs) { return std::min(lhs, rhs); });
+}
+
+void MaxGroups(const double* data, size_t groups, size_t scale, double* out) {
+#ifdef TSKV_X86_KERNELS
+  if (scale >= kMinVectorScale && HasAvx2()) {
+    MaxGroupsAvx2(data, groups, scale, out);
+    return;
+  }
+#endif
+  ReduceGroupsScalar(data, groups, scale, out,
+                     std::numeric_limits<double>::lowest(),
+                     [](double lhs, double rhs) { return std::max(lhs, rhs); });
+}
+
+void LastGroups(const double* data, size_t groups, size_t scale, double* out) {
+  for (size_t group = 0; group < groups; ++group) {
+    out[group] = data[group * scale + scale - 1];
+  }
+}
+
+}  // namespace tskv
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace tskv {
+
+// Downsampling kernels: reduce every `scale` consecutive buckets of
+// [data, data + groups * scale) into out[i]. `out` may point into `data` as
+// long as out + i <= data + i * scale, so that ScaleBuckets can work in place.
+//
+// AVX2 versions are selected at runtime if cpu supports them.
+void SumGroups(const double* data, size_t groups, size_t scale, double* out);
+// integer sums are vectorized by the compiler, they don't depend on the order
+// of additions
+void SumGroups(const uint64_t* data, size_t groups, size_t scale,
+               uint64_t* out);
+void MinGroups(const double* data, size_t groups, size_t scale, double* out);
+void MaxGroups(const double* data, size_t groups, size_t scale, double* out);
+void LastGroups(const double* data, size_t groups, size_t scale, double* out);
+
+bool HasAvx2();
+
+}  // namespace tskv
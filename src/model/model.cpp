@@ -44,5 +44,16 @@ tskv::TimeRange tskv::TimeRange::Merge(const TimeRange& other) const {
   if (start == 0 && end == 0) {
     return other;
   }
+  if (other.start == 0 && other.end == 0) {
+    return *this;
+  }
   return {std::min(start, other.start), std::max(end, other.end)};
 }
+
+bool tskv::TimeRange::Overlaps(const TimeRange& other) const {
+  return start < other.end && other.start < end;
+}
+
+bool tskv::TimeRange::Contains(const TimeRange& other) const {
+  return start <= other.start && other.end <= end;
+}
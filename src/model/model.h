@@ -42,6 +42,9 @@ struct TimeRange {
   Duration GetDuration() const;
 
   TimeRange Merge(const TimeRange& other) const;
+  // empty ranges overlap nothing
+  bool Overlaps(const TimeRange& other) const;
+  bool Contains(const TimeRange& other) const;
 };
 
 struct Record {
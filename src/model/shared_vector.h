@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace tskv {
+
+// Reference-counted [offset, offset + size) view of a vector. Copies and
+// slices share the underlying buffer, so reading a range of a column doesn't
+// copy its data. Buffer is copied on the first mutation of a view or of a
+// shared buffer (copy-on-write).
+template <typename T>
+class SharedVector {
+ public:
+  SharedVector() = default;
+  // implicit, so that owning vectors can be passed where views are expected
+  SharedVector(std::vector<T> values)
+      : values_(std::make_shared<std::vector<T>>(std::move(values))),
+        size_(values_->size()) {}
+
+  SharedVector(const SharedVector& other) = default;
+  SharedVector& operator=(const SharedVector& other) = default;
+  SharedVector(SharedVector&& other) noexcept
+      : values_(std::move(other.values_)),
+        offset_(std::exchange(other.offset_, 0)),
+        size_(std::exchange(other.size_, 0)) {}
+  SharedVector& operator=(SharedVector&& other) noexcept {
+    values_ = std::move(other.values_);
+    offset_ = std::exchange(other.offset_, 0);
+    size_ = std::exchange(other.size_, 0);
+    return *this;
+  }
+
+  size_t Size() const { return size_; }
+  bool Empty() const { return size_ == 0; }
+  const T* Data() const {
+    return values_ ? values_->data() + offset_ : nullptr;
+  }
+  const T* begin() const { return Data(); }
+  const T* end() const { return Data() + size_; }
+  const T& operator[](size_t idx) const {
+    assert(idx < size_);
+    return Data()[idx];
+  }
+  const T& Front() const { return (*this)[0]; }
+  const T& Back() const { return (*this)[size_ - 1]; }
+  operator std::span<const T>() const { return {Data(), size_}; }
+
+  std::vector<T> ToVector() const { return {begin(), end()}; }
+
+  // [begin, end), shares buffer with this vector
+  SharedVector Slice(size_t begin, size_t end) const {
+    assert(begin <= end && end <= size_);
+    SharedVector res;
+    if (begin != end) {
+      res.values_ = values_;
+      res.offset_ = offset_ + begin;
+      res.size_ = end - begin;
+    }
+    return res;
+  }
+
+  // true if mutation will copy the buffer
+  bool IsShared() const {
+    return values_ &&
+           (values_.use_count() > 1 || offset_ != 0 ||
+            size_ != values_->size());
+  }
+
+  T* MutableData() { return Detach().data(); }
+
+  void Resize(size_t size, const T& value = T()) {
+    auto& values = Detach();
+    values.resize(size, value);
+    size_ = values.size();
+  }
+
+  void Reserve(size_t size) { Detach().reserve(size); }
+
+  void PushBack(const T& value) {
+    auto& values = Detach();
+    values.push_back(value);
+    size_ = values.size();
+  }
+
+  void Append(std::span<const T> other) {
+    auto& values = Detach();
+    values.insert(values.end(), other.begin(), other.end());
+    size_ = values.size();
+  }
+
+ private:
+  std::vector<T>& Detach() {
+    if (!values_) {
+      values_ = std::make_shared<std::vector<T>>();
+    } else if (IsShared()) {
+      values_ = std::make_shared<std::vector<T>>(begin(), end());
+      offset_ = 0;
+    }
+    return *values_;
+  }
+
+ private:
+  std::shared_ptr<std::vector<T>> values_;
+  size_t offset_{0};
+  size_t size_{0};
+};
+
+}  // namespace tskv
@@ -0,0 +1,246 @@
+#include "timestamp_runs.h"
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+namespace tskv {
+
+namespace {
+
+// irregular series are not materialized until they have at least this number
+// of timestamps, so that short columns never pay for it
+constexpr size_t kMinSizeToMaterialize = 64;
+
+// returns true if `run` was joined to `last`
+bool TryJoin(TimestampRun& last, const TimestampRun& run) {
+  assert(run.start >= last.Back());
+  if (last.length == 1 && run.length == 1) {
+    last.step = run.start - last.start;
+    last.length = 2;
+    return true;
+  }
+  if (last.length == 1 && run.start - last.start == run.step) {
+    last.step = run.step;
+    last.length += run.length;
+    return true;
+  }
+  if (last.length > 1 && run.start - last.Back() == last.step &&
+      (run.length == 1 || run.step == last.step)) {
+    last.length += run.length;
+    return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+TimestampRuns::TimestampRuns(std::vector<TimePoint> timestamps) {
+  auto runs = DetectRuns(timestamps);
+  if (timestamps.size() >= kMinSizeToMaterialize &&
+      runs.size() * kMinAverageRunLength > timestamps.size()) {
+    regular_ = false;
+    plain_ = std::move(timestamps);
+    return;
+  }
+  for (const auto& run : runs) {
+    AppendRun(run);
+  }
+}
+
+TimestampRuns::TimestampRuns(std::vector<TimestampRun> runs) {
+  for (const auto& run : runs) {
+    AppendRun(run);
+  }
+}
+
+void TimestampRuns::PushBack(TimePoint timestamp) {
+  if (!regular_) {
+    plain_.PushBack(timestamp);
+    return;
+  }
+  AppendRun({timestamp, 0, 1});
+  MaterializeIfIrregular();
+}
+
+void TimestampRuns::Append(const TimestampRuns& other) {
+  if (regular_ && other.regular_) {
+    for (const auto& run : other.runs_) {
+      AppendRun(run);
+    }
+    MaterializeIfIrregular();
+    return;
+  }
+  if (regular_) {
+    plain_ = Materialize();
+    runs_.clear();
+    ends_.clear();
+    regular_ = false;
+  }
+  if (other.regular_) {
+    auto other_plain = other.Materialize();
+    plain_.Append(other_plain);
+  } else {
+    plain_.Append(other.plain_);
+  }
+}
+
+size_t TimestampRuns::Size() const {
+  if (!regular_) {
+    return plain_.Size();
+  }
+  return ends_.empty() ? 0 : ends_.back();
+}
+
+bool TimestampRuns::Empty() const {
+  return Size() == 0;
+}
+
+TimePoint TimestampRuns::Front() const {
+  assert(!Empty());
+  return regular_ ? runs_.front().start : plain_.Front();
+}
+
+TimePoint TimestampRuns::Back() const {
+  assert(!Empty());
+  return regular_ ? runs_.back().Back() : plain_.Back();
+}
+
+TimePoint TimestampRuns::operator[](size_t idx) const {
+  assert(idx < Size());
+  if (!regular_) {
+    return plain_[idx];
+  }
+  auto run_idx = FindRun(idx);
+  auto run_begin = run_idx == 0 ? 0 : ends_[run_idx - 1];
+  return runs_[run_idx].At(idx - run_begin);
+}
+
+size_t TimestampRuns::LowerBound(TimePoint timestamp) const {
+  if (!regular_) {
+    return std::ranges::lower_bound(plain_, timestamp) - plain_.begin();
+  }
+  auto it = std::ranges::partition_point(
+      runs_, [timestamp](const auto& run) { return run.Back() < timestamp; });
+  if (it == runs_.end()) {
+    return Size();
+  }
+  size_t run_idx = it - runs_.begin();
+  auto run_begin = run_idx == 0 ? 0 : ends_[run_idx - 1];
+  if (timestamp <= it->start) {
+    return run_begin;
+  }
+  // here start < timestamp <= back, so step can't be zero
+  return run_begin + (timestamp - it->start + it->step - 1) / it->step;
+}
+
+size_t TimestampRuns::UpperBound(TimePoint timestamp) const {
+  if (!regular_) {
+    return std::ranges::upper_bound(plain_, timestamp) - plain_.begin();
+  }
+  auto it = std::ranges::partition_point(
+      runs_, [timestamp](const auto& run) { return run.Back() <= timestamp; });
+  if (it == runs_.end()) {
+    return Size();
+  }
+  size_t run_idx = it - runs_.begin();
+  auto run_begin = run_idx == 0 ? 0 : ends_[run_idx - 1];
+  if (timestamp < it->start) {
+    return run_begin;
+  }
+  return run_begin + (timestamp - it->start) / it->step + 1;
+}
+
+TimestampRuns TimestampRuns::Slice(size_t begin, size_t end) const {
+  assert(begin <= end && end <= Size());
+  TimestampRuns res;
+  if (begin == end) {
+    return res;
+  }
+  if (!regular_) {
+    res.regular_ = false;
+    res.plain_ = plain_.Slice(begin, end);
+    return res;
+  }
+  for (auto run_idx = FindRun(begin);
+       run_idx < runs_.size() && (run_idx == 0 || ends_[run_idx - 1] < end);
+       ++run_idx) {
+    const auto& run = runs_[run_idx];
+    auto run_begin = run_idx == 0 ? 0 : ends_[run_idx - 1];
+    auto from = std::max(begin, run_begin) - run_begin;
+    auto to = std::min(end, ends_[run_idx]) - run_begin;
+    res.AppendRun({run.At(from), to - from > 1 ? run.step : 0, to - from});
+  }
+  return res;
+}
+
+bool TimestampRuns::IsRegular() const {
+  return regular_;
+}
+
+std::vector<TimestampRun> TimestampRuns::GetRuns() const {
+  return regular_ ? runs_ : DetectRuns(plain_);
+}
+
+std::vector<TimePoint> TimestampRuns::Materialize() const {
+  if (!regular_) {
+    return plain_.ToVector();
+  }
+  std::vector<TimePoint> res;
+  res.reserve(Size());
+  for (const auto& run : runs_) {
+    for (size_t i = 0; i < run.length; ++i) {
+      res.push_back(run.At(i));
+    }
+  }
+  return res;
+}
+
+size_t TimestampRuns::GetBytesSize() const {
+  if (!regular_) {
+    return plain_.Size() * sizeof(TimePoint);
+  }
+  return runs_.size() * (sizeof(TimestampRun) + sizeof(size_t));
+}
+
+std::vector<TimestampRun> TimestampRuns::DetectRuns(
+    std::span<const TimePoint> timestamps) {
+  std::vector<TimestampRun> runs;
+  for (auto timestamp : timestamps) {
+    TimestampRun run{timestamp, 0, 1};
+    if (runs.empty() || !TryJoin(runs.back(), run)) {
+      runs.push_back(run);
+    }
+  }
+  return runs;
+}
+
+void TimestampRuns::AppendRun(const TimestampRun& run) {
+  assert(regular_);
+  if (run.length == 0) {
+    return;
+  }
+  if (!runs_.empty() && TryJoin(runs_.back(), run)) {
+    ends_.back() += run.length;
+    return;
+  }
+  runs_.push_back(run);
+  ends_.push_back(Size() + run.length);
+}
+
+size_t TimestampRuns::FindRun(size_t idx) const {
+  return std::ranges::upper_bound(ends_, idx) - ends_.begin();
+}
+
+void TimestampRuns::MaterializeIfIrregular() {
+  if (!regular_ || Size() < kMinSizeToMaterialize ||
+      runs_.size() * kMinAverageRunLength <= Size()) {
+    return;
+  }
+  plain_ = Materialize();
+  runs_.clear();
+  ends_.clear();
+  regular_ = false;
+}
+
+}  // namespace tskv
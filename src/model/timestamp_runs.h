@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+#include "model/encoding.h"
+#include "model/model.h"
+#include "model/shared_vector.h"
+
+namespace tskv {
+
+// Sorted sequence of timestamps. Periodic series are stored as
+// (start, step, length) runs, so that e.g. a day of 1s samples takes a single
+// run. Once runs stop paying off (too short on average) timestamps are
+// materialized into a plain vector.
+class TimestampRuns {
+ public:
+  static constexpr size_t kMinAverageRunLength = 8;
+
+ public:
+  TimestampRuns() = default;
+  explicit TimestampRuns(std::vector<TimePoint> timestamps);
+  explicit TimestampRuns(std::vector<TimestampRun> runs);
+
+  void PushBack(TimePoint timestamp);
+  void Append(const TimestampRuns& other);
+
+  size_t Size() const;
+  bool Empty() const;
+  TimePoint Front() const;
+  TimePoint Back() const;
+  TimePoint operator[](size_t idx) const;
+
+  // same as std::lower_bound/std::upper_bound, but returns index
+  size_t LowerBound(TimePoint timestamp) const;
+  size_t UpperBound(TimePoint timestamp) const;
+  // [begin, end)
+  TimestampRuns Slice(size_t begin, size_t end) const;
+
+  bool IsRegular() const;
+  // detects runs for materialized timestamps
+  std::vector<TimestampRun> GetRuns() const;
+  std::vector<TimePoint> Materialize() const;
+  size_t GetBytesSize() const;
+
+  static std::vector<TimestampRun> DetectRuns(
+      std::span<const TimePoint> timestamps);
+
+ private:
+  void AppendRun(const TimestampRun& run);
+  // returns index of run that contains idx-th timestamp
+  size_t FindRun(size_t idx) const;
+  void MaterializeIfIrregular();
+
+ private:
+  std::vector<TimestampRun> runs_;
+  // ends_[i] is index of the first timestamp after i-th run
+  std::vector<size_t> ends_;
+  // slices of materialized timestamps share the buffer
+  SharedVector<TimePoint> plain_;
+  bool regular_{true};
+};
+
+}  // namespace tskv
@@ -0,0 +1,35 @@
+#include "compaction_scheduler.h"
+
+#include <algorithm>
+#include <thread>
+#include <utility>
+
+namespace tskv {
+
+CompactionScheduler::CompactionScheduler(const Options& options)
+    : options_(options), executor_(options.threads_num) {}
+
+void CompactionScheduler::Schedule(BackgroundExecutor::Task task) {
+  executor_.Submit(std::move(task));
+}
+
+void CompactionScheduler::Throttle() {
+  if (options_.min_interval.count() == 0) {
+    return;
+  }
+  std::chrono::steady_clock::time_point start;
+  {
+    // every move reserves its own start, so that concurrent moves are spread
+    // over time too
+    std::lock_guard lock(mutex_);
+    start = std::max(next_start_, std::chrono::steady_clock::now());
+    next_start_ = start + options_.min_interval;
+  }
+  std::this_thread::sleep_until(start);
+}
+
+void CompactionScheduler::Wait() {
+  executor_.Wait();
+}
+
+}  // namespace tskv
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+
+#include "executor/background_executor.h"
+
+namespace tskv {
+
+// Worker pool shared by persistent storage managers of all metrics, which
+// moves pages between their levels in background.
+class CompactionScheduler {
+ public:
+  struct Options {
+    size_t threads_num{1};
+    // minimal time between starts of two level moves, limits the I/O
+    // compaction takes from reads and writes
+    std::chrono::milliseconds min_interval{0};
+  };
+
+ public:
+  explicit CompactionScheduler(const Options& options);
+
+  void Schedule(BackgroundExecutor::Task task);
+  // blocks until the next level move may start
+  void Throttle();
+  // waits until all scheduled compactions are finished
+  void Wait();
+
+ private:
+  Options options_;
+  std::mutex mutex_;
+  std::chrono::steady_clock::time_point next_start_;
+  // the last member, so that queued compactions are finished before the rest
+  // is destroyed
+  BackgroundExecutor executor_;
+};
+
+}  // namespace tskv
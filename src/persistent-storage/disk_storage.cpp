@@ -1,15 +1,72 @@
 #include "disk_storage.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <cassert>
+#include <cerrno>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <random>
 #include <stdexcept>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace tskv {
 
-DiskStorage::DiskStorage(const Options& options) : path_(options.path) {
+namespace {
+
+// syncs a page file or the directory, files deleted meanwhile are skipped
+void SyncFile(const std::filesystem::path& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    if (errno == ENOENT) {
+      return;
+    }
+    throw std::runtime_error("failed to open file for sync");
+  }
+  int res = fsync(fd);
+  close(fd);
+  if (res == -1) {
+    throw std::runtime_error("failed to sync file");
+  }
+}
+
+// closes files of a batch when it's finished or failed
+class Files {
+ public:
+  Files() = default;
+  ~Files() {
+    for (int fd : fds_) {
+      close(fd);
+    }
+  }
+
+  Files(const Files&) = delete;
+  Files& operator=(const Files&) = delete;
+
+  int Open(const std::filesystem::path& path, int flags) {
+    int fd = open(path.c_str(), flags, 0644);
+    if (fd == -1) {
+      throw std::runtime_error("file not found");
+    }
+    fds_.push_back(fd);
+    return fd;
+  }
+
+ private:
+  std::vector<int> fds_;
+};
+
+}  // namespace
+
+DiskStorage::DiskStorage(const Options& options)
+    : path_(options.path),
+      mmap_reads_(options.mmap_reads),
+      io_ring_(options.io_ring) {
   if (!std::filesystem::exists(path_)) {
     std::filesystem::create_directories(path_);
   }
@@ -43,6 +100,8 @@ PageId DiskStorage::CreatePage() {
     out.open(page_id);
   }
   out.close();
+  std::lock_guard lock(mutex_);
+  dir_synced_ = false;
   return page_id;
 }
 
@@ -51,8 +110,8 @@ CompressedBytes DiskStorage::Read(const PageId& page_id) {
   if (!in) {
     throw std::runtime_error("file not found");
   }
-  CompressedBytes content = {(std::istreambuf_iterator<char>(in)),
-                             std::istreambuf_iterator<char>()};
+  CompressedBytes content(std::filesystem::file_size(path_ / page_id));
+  in.read(reinterpret_cast<char*>(content.data()), content.size());
   return content;
 }
 
@@ -62,9 +121,135 @@ void DiskStorage::Write(const PageId& page_id, const CompressedBytes& bytes) {
     throw std::runtime_error("file not found");
   }
   out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+  out.close();
+  if (!out) {
+    throw std::runtime_error("failed to write page file");
+  }
+  std::lock_guard lock(mutex_);
+  unsynced_page_ids_.insert(page_id);
 }
 
 void DiskStorage::DeletePage(const PageId& page_id) {
   std::filesystem::remove(path_ / page_id);
+  std::lock_guard lock(mutex_);
+  unsynced_page_ids_.erase(page_id);
+  dir_synced_ = false;
+}
+
+CompressedBytes DiskStorage::ReadRange(const PageId& page_id, size_t offset,
+                                       size_t size) {
+  int fd = open((path_ / page_id).c_str(), O_RDONLY);
+  if (fd == -1) {
+    throw std::runtime_error("file not found");
+  }
+  CompressedBytes bytes(size);
+  size_t read = 0;
+  while (read < size) {
+    auto res = pread(fd, bytes.data() + read, size - read, offset + read);
+    if (res <= 0) {
+      close(fd);
+      throw std::runtime_error("Range is out of page");
+    }
+    read += res;
+  }
+  close(fd);
+  return bytes;
+}
+
+std::vector<PageView> DiskStorage::ReadMany(
+    const std::vector<PageId>& page_ids) {
+  if (!io_ring_ || mmap_reads_) {
+    return IPersistentStorage::ReadMany(page_ids);
+  }
+  Files files;
+  std::vector<CompressedBytes> pages(page_ids.size());
+  std::vector<IoRing::Request> requests;
+  requests.reserve(page_ids.size());
+  for (size_t i = 0; i < page_ids.size(); ++i) {
+    int fd = files.Open(path_ / page_ids[i], O_RDONLY);
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == -1) {
+      throw std::runtime_error("failed to stat page file");
+    }
+    pages[i].resize(file_stat.st_size);
+    requests.push_back(
+        IoRing::Request::Read(fd, pages[i].data(), pages[i].size(), 0));
+  }
+  io_ring_->Run(requests);
+  return ToPageViews(std::move(pages));
+}
+
+void DiskStorage::WriteMany(const std::vector<PageId>& page_ids,
+                            const std::vector<CompressedBytes>& pages) {
+  assert(page_ids.size() == pages.size());
+  if (!io_ring_) {
+    IPersistentStorage::WriteMany(page_ids, pages);
+    return;
+  }
+  Files files;
+  std::vector<IoRing::Request> requests;
+  requests.reserve(page_ids.size());
+  for (size_t i = 0; i < page_ids.size(); ++i) {
+    int fd = files.Open(path_ / page_ids[i], O_WRONLY | O_CREAT | O_TRUNC);
+    requests.push_back(
+        IoRing::Request::Write(fd, pages[i].data(), pages[i].size(), 0));
+  }
+  io_ring_->Run(requests);
+  std::lock_guard lock(mutex_);
+  unsynced_page_ids_.insert(page_ids.begin(), page_ids.end());
+}
+
+void DiskStorage::Sync() {
+  std::unordered_set<PageId> page_ids;
+  bool dir_synced = true;
+  {
+    std::lock_guard lock(mutex_);
+    page_ids.swap(unsynced_page_ids_);
+    dir_synced = std::exchange(dir_synced_, true);
+  }
+  try {
+    for (const auto& page_id : page_ids) {
+      SyncFile(path_ / page_id);
+    }
+    // entries of created and deleted pages are synced after the files
+    if (!dir_synced) {
+      SyncFile(path_);
+    }
+  } catch (...) {
+    std::lock_guard lock(mutex_);
+    unsynced_page_ids_.merge(page_ids);
+    dir_synced_ = false;
+    throw;
+  }
+}
+
+PageView DiskStorage::ReadView(const PageId& page_id) {
+  if (!mmap_reads_) {
+    return IPersistentStorage::ReadView(page_id);
+  }
+  int fd = open((path_ / page_id).c_str(), O_RDONLY);
+  if (fd == -1) {
+    throw std::runtime_error("file not found");
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) == -1) {
+    close(fd);
+    throw std::runtime_error("failed to stat page file");
+  }
+  size_t size = file_stat.st_size;
+  if (size == 0) {
+    close(fd);
+    return {};
+  }
+  void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping stays valid after the file is closed or deleted
+  close(fd);
+  if (data == MAP_FAILED) {
+    throw std::runtime_error("failed to map page file");
+  }
+  std::shared_ptr<const void> holder(data, [size](const void* mapped) {
+    munmap(const_cast<void*>(mapped), size);
+  });
+  return {std::move(holder), {static_cast<const uint8_t*>(data), size}};
 }
 }  // namespace tskv
@@ -1,7 +1,12 @@
 #pragma once
 
 #include <filesystem>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
 
+#include "io_ring.h"
 #include "persistent_storage.h"
 
 namespace tskv {
@@ -10,6 +15,11 @@ class DiskStorage : public IPersistentStorage {
  public:
   struct Options {
     std::string path;
+    // ReadView maps page files instead of reading them
+    bool mmap_reads{false};
+    // if set, ReadMany and WriteMany keep all requests of a batch in flight.
+    // Mapped reads are preferred to it, they don't copy pages
+    std::shared_ptr<IoRing> io_ring;
   };
 
  public:
@@ -19,10 +29,27 @@ class DiskStorage : public IPersistentStorage {
   CompressedBytes Read(const PageId& page_id) override;
   void Write(const PageId& page_id, const CompressedBytes& bytes) override;
   void DeletePage(const PageId& page_id) override;
+  PageView ReadView(const PageId& page_id) override;
+  CompressedBytes ReadRange(const PageId& page_id, size_t offset,
+                            size_t size) override;
+  std::vector<PageView> ReadMany(
+      const std::vector<PageId>& page_ids) override;
+  void WriteMany(const std::vector<PageId>& page_ids,
+                 const std::vector<CompressedBytes>& pages) override;
+  void Sync() override;
   static std::string GeneratePageId();
 
  private:
   std::filesystem::path path_;
+  bool mmap_reads_;
+  std::shared_ptr<IoRing> io_ring_;
+
+  // page files are written without syncing, Sync syncs only the ones written
+  // after the previous call
+  std::mutex mutex_;
+  std::unordered_set<PageId> unsynced_page_ids_;
+  // pages were created or deleted since the directory was synced
+  bool dir_synced_{true};
 };
 
 }  // namespace tskv
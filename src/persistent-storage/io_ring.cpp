@@ -0,0 +1,242 @@
+#include "io_ring.h"
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace tskv {
+
+namespace {
+
+// user data of no-ops which replace requests of a failed batch
+constexpr uint64_t kSkippedUserData = ~uint64_t{0};
+
+}  // namespace
+
+IoRing::IoRing(size_t queue_depth) {
+  if (queue_depth == 0) {
+    throw std::runtime_error("Queue depth must be positive");
+  }
+  io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+  int fd = syscall(__NR_io_uring_setup, queue_depth, &params);
+  if (fd < 0) {
+    // old kernels and sandboxes without io_uring
+    return;
+  }
+  ring_fd_ = fd;
+
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_ring_size_ =
+      params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single_mmap) {
+    sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+  }
+  sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (sq_ring_ == MAP_FAILED) {
+    sq_ring_ = nullptr;
+    Close();
+    return;
+  }
+  if (single_mmap) {
+    cq_ring_ = sq_ring_;
+  } else {
+    cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (cq_ring_ == MAP_FAILED) {
+      cq_ring_ = nullptr;
+      Close();
+      return;
+    }
+  }
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    Close();
+    return;
+  }
+  sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+  auto* sq = static_cast<uint8_t*>(sq_ring_);
+  auto* cq = static_cast<uint8_t*>(cq_ring_);
+  sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+  sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+  sq_mask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+  sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+  cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+  cq_mask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+  // completions of a batch must fit into the completion queue
+  entries_ = std::min(params.sq_entries, params.cq_entries);
+}
+
+IoRing::~IoRing() {
+  Close();
+}
+
+void IoRing::Run(std::span<const Request> requests) {
+  if (!IsAsync()) {
+    for (const auto& request : requests) {
+      RunSync(request, 0);
+    }
+    return;
+  }
+  std::lock_guard lock(mutex_);
+  for (size_t begin = 0; begin < requests.size(); begin += entries_) {
+    RunBatch(requests.subspan(
+        begin, std::min<size_t>(entries_, requests.size() - begin)));
+  }
+}
+
+void IoRing::RunBatch(std::span<const Request> requests) {
+  // no-ops left by a failed batch go first, so that submissions below start
+  // with this batch
+  SubmitSkipped();
+
+  // the submission queue is filled only under the lock, so its tail can be
+  // read without synchronization
+  unsigned first = *sq_tail_;
+  unsigned tail = first;
+  for (size_t i = 0; i < requests.size(); ++i) {
+    const auto& request = requests[i];
+    unsigned idx = tail & *sq_mask_;
+    auto& sqe = sqes_[idx];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = request.op_type == OpType::kRead ? IORING_OP_READ
+                                                  : IORING_OP_WRITE;
+    sqe.fd = request.fd;
+    sqe.addr = reinterpret_cast<uint64_t>(request.data);
+    sqe.len = request.size;
+    sqe.off = request.offset;
+    sqe.user_data = i;
+    sq_array_[idx] = idx;
+    ++tail;
+  }
+  std::atomic_ref(*sq_tail_).store(tail, std::memory_order_release);
+
+  std::vector<int> results(requests.size());
+  size_t submitted = 0;
+  size_t completed = 0;
+  while (completed < requests.size()) {
+    int res = Enter(requests.size() - submitted);
+    if (res < 0) {
+      // submitted requests read or write buffers of the caller, so they are
+      // waited for before throwing, and the rest are never run
+      for (size_t i = submitted; i < requests.size(); ++i) {
+        auto& sqe = sqes_[(first + i) & *sq_mask_];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_NOP;
+        sqe.user_data = kSkippedUserData;
+        ++skipped_num_;
+      }
+      while (completed < submitted) {
+        // waiting without submissions fails only transiently
+        if (Enter(0) >= 0) {
+          completed += Reap(results);
+        }
+      }
+      throw std::runtime_error("io_uring_enter failed");
+    }
+    submitted += res;
+    completed += Reap(results);
+  }
+
+  // short requests and requests the kernel can't run asynchronously are
+  // finished synchronously
+  for (size_t i = 0; i < requests.size(); ++i) {
+    size_t done = std::max(results[i], 0);
+    if (done < requests[i].size) {
+      RunSync(requests[i], done);
+    }
+  }
+}
+
+int IoRing::Enter(size_t to_submit) {
+  while (true) {
+    int res = syscall(__NR_io_uring_enter, ring_fd_, to_submit, 1,
+                      IORING_ENTER_GETEVENTS, nullptr, 0);
+    if (res >= 0 || errno != EINTR) {
+      return res;
+    }
+  }
+}
+
+size_t IoRing::Reap(std::vector<int>& results) {
+  size_t reaped = 0;
+  unsigned head = *cq_head_;
+  unsigned cq_tail = std::atomic_ref(*cq_tail_).load(std::memory_order_acquire);
+  for (; head != cq_tail; ++head) {
+    const auto& cqe = cqes_[head & *cq_mask_];
+    if (cqe.user_data == kSkippedUserData) {
+      --skipped_num_;
+      continue;
+    }
+    results[cqe.user_data] = cqe.res;
+    ++reaped;
+  }
+  std::atomic_ref(*cq_head_).store(head, std::memory_order_release);
+  return reaped;
+}
+
+void IoRing::SubmitSkipped() {
+  std::vector<int> results;
+  while (skipped_num_ != 0) {
+    unsigned sq_head =
+        std::atomic_ref(*sq_head_).load(std::memory_order_acquire);
+    if (Enter(*sq_tail_ - sq_head) < 0) {
+      throw std::runtime_error("io_uring_enter failed");
+    }
+    Reap(results);
+  }
+}
+
+void IoRing::RunSync(const Request& request, size_t done) {
+  while (done < request.size) {
+    ssize_t res;
+    if (request.op_type == OpType::kRead) {
+      res = pread(request.fd, request.data + done, request.size - done,
+                  request.offset + done);
+    } else {
+      res = pwrite(request.fd, request.data + done, request.size - done,
+                   request.offset + done);
+    }
+    if (res <= 0) {
+      throw std::runtime_error(request.op_type == OpType::kRead
+                                   ? "failed to read"
+                                   : "failed to write");
+    }
+    done += res;
+  }
+}
+
+void IoRing::Close() {
+  if (sqes_) {
+    munmap(sqes_, sqes_size_);
+    sqes_ = nullptr;
+  }
+  if (cq_ring_ && cq_ring_ != sq_ring_) {
+    munmap(cq_ring_, cq_ring_size_);
+  }
+  cq_ring_ = nullptr;
+  if (sq_ring_) {
+    munmap(sq_ring_, sq_ring_size_);
+    sq_ring_ = nullptr;
+  }
+  if (ring_fd_ != -1) {
+    close(ring_fd_);
+    ring_fd_ = -1;
+  }
+}
+
+}  // namespace tskv
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <vector>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace tskv {
+
+// Runs batches of positional reads and writes through io_uring, so that all
+// requests of a batch are in flight at once. If io_uring is not available,
+// requests are run one by one with pread and pwrite.
+class IoRing {
+ public:
+  enum class OpType {
+    kRead,
+    kWrite,
+  };
+
+  struct Request {
+    static Request Read(int fd, uint8_t* data, size_t size, size_t offset) {
+      return {OpType::kRead, fd, data, size, offset};
+    }
+    static Request Write(int fd, const uint8_t* data, size_t size,
+                         size_t offset) {
+      return {OpType::kWrite, fd, const_cast<uint8_t*>(data), size, offset};
+    }
+
+    OpType op_type;
+    int fd;
+    // read into or written from, it's not modified by writes
+    uint8_t* data;
+    size_t size;
+    size_t offset;
+  };
+
+ public:
+  explicit IoRing(size_t queue_depth = 64);
+  ~IoRing();
+
+  IoRing(const IoRing&) = delete;
+  IoRing& operator=(const IoRing&) = delete;
+
+  // runs requests, up to the queue depth of them at once, and waits for all
+  // of them. Batches of concurrent callers are run one after another
+  void Run(std::span<const Request> requests);
+  // false if requests are run synchronously
+  bool IsAsync() const { return ring_fd_ != -1; }
+
+ private:
+  void RunBatch(std::span<const Request> requests);
+  // io_uring_enter which waits for a completion, retried on EINTR
+  int Enter(size_t to_submit);
+  // moves results of completed requests to `results`, returns their number
+  size_t Reap(std::vector<int>& results);
+  // runs no-ops left in the submission queue by a failed batch
+  void SubmitSkipped();
+  // finishes the request from `done` bytes with pread or pwrite
+  static void RunSync(const Request& request, size_t done);
+  void Close();
+
+ private:
+  std::mutex mutex_;
+  int ring_fd_{-1};
+  unsigned entries_{0};
+  void* sq_ring_{nullptr};
+  size_t sq_ring_size_{0};
+  void* cq_ring_{nullptr};
+  size_t cq_ring_size_{0};
+  io_uring_sqe* sqes_{nullptr};
+  size_t sqes_size_{0};
+  unsigned* sq_head_{nullptr};
+  unsigned* sq_tail_{nullptr};
+  unsigned* sq_mask_{nullptr};
+  unsigned* sq_array_{nullptr};
+  unsigned* cq_head_{nullptr};
+  unsigned* cq_tail_{nullptr};
+  unsigned* cq_mask_{nullptr};
+  io_uring_cqe* cqes_{nullptr};
+  // no-ops which are not completed yet
+  size_t skipped_num_{0};
+};
+
+}  // namespace tskv
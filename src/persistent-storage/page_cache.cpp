@@ -0,0 +1,107 @@
+#include "page_cache.h"
+
+#include <functional>
+#include <stdexcept>
+#include <utility>
+
+namespace tskv {
+
+PageCache::PageCache(const Options& options) : shards_(options.shards_num) {
+  if (options.shards_num == 0) {
+    throw std::runtime_error("Page cache should have at least one shard");
+  }
+  shard_max_bytes_size_ = options.max_bytes_size / options.shards_num;
+}
+
+Column PageCache::Get(uint64_t storage_id, const PageId& page_id) {
+  Key key{storage_id, page_id};
+  auto& shard = GetShard(key);
+  std::lock_guard lock(shard.mutex);
+  auto it = shard.index.find(key);
+  if (it == shard.index.end()) {
+    ++misses_;
+    return {};
+  }
+  ++hits_;
+  shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+  return it->second->column;
+}
+
+bool PageCache::Contains(uint64_t storage_id, const PageId& page_id) const {
+  Key key{storage_id, page_id};
+  const auto& shard = GetShard(key);
+  std::lock_guard lock(shard.mutex);
+  return shard.index.contains(key);
+}
+
+void PageCache::Put(uint64_t storage_id, const PageId& page_id,
+                    Column column) {
+  auto bytes_size = GetColumnBytesSize(column);
+  if (bytes_size > shard_max_bytes_size_) {
+    return;
+  }
+  Key key{storage_id, page_id};
+  auto& shard = GetShard(key);
+  std::lock_guard lock(shard.mutex);
+  auto it = shard.index.find(key);
+  if (it != shard.index.end()) {
+    // concurrent readers of the same page may both miss
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    return;
+  }
+  shard.entries.push_front({key, std::move(column), bytes_size});
+  shard.index.emplace(std::move(key), shard.entries.begin());
+  shard.bytes_size += bytes_size;
+  Evict(shard);
+}
+
+void PageCache::Erase(uint64_t storage_id, const PageId& page_id) {
+  Key key{storage_id, page_id};
+  auto& shard = GetShard(key);
+  std::lock_guard lock(shard.mutex);
+  auto it = shard.index.find(key);
+  if (it == shard.index.end()) {
+    return;
+  }
+  shard.bytes_size -= it->second->bytes_size;
+  shard.entries.erase(it->second);
+  shard.index.erase(it);
+}
+
+PageCache::Stats PageCache::GetStats() const {
+  return {.hits = hits_, .misses = misses_};
+}
+
+size_t PageCache::GetBytesSize() const {
+  size_t bytes_size = 0;
+  for (const auto& shard : shards_) {
+    std::lock_guard lock(shard.mutex);
+    bytes_size += shard.bytes_size;
+  }
+  return bytes_size;
+}
+
+size_t PageCache::KeyHash::operator()(const Key& key) const {
+  auto hash = std::hash<PageId>{}(key.page_id);
+  return hash ^ (std::hash<uint64_t>{}(key.storage_id) + 0x9e3779b97f4a7c15 +
+                 (hash << 6) + (hash >> 2));
+}
+
+PageCache::Shard& PageCache::GetShard(const Key& key) {
+  return shards_[KeyHash{}(key) % shards_.size()];
+}
+
+const PageCache::Shard& PageCache::GetShard(const Key& key) const {
+  return shards_[KeyHash{}(key) % shards_.size()];
+}
+
+void PageCache::Evict(Shard& shard) {
+  while (shard.bytes_size > shard_max_bytes_size_) {
+    auto& entry = shard.entries.back();
+    shard.bytes_size -= entry.bytes_size;
+    shard.index.erase(entry.key);
+    shard.entries.pop_back();
+  }
+}
+
+}  // namespace tskv
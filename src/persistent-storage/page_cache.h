@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "model/column.h"
+#include "persistent_storage.h"
+
+namespace tskv {
+
+// LRU cache of decoded pages, shared by levels of all metrics. Pages are
+// immutable until they are deleted, so cached columns are never stale, but
+// they are shared between readers and must not be modified. Pages are keyed
+// by the instance id of their storage too, because several storages may
+// share the cache and reuse page ids, see IPersistentStorage::GetInstanceId.
+class PageCache {
+ public:
+  struct Options {
+    // budget of all shards together, see GetColumnBytesSize
+    size_t max_bytes_size;
+    // every shard has its own lock and its own part of the budget
+    size_t shards_num{16};
+  };
+
+  struct Stats {
+    uint64_t hits;
+    uint64_t misses;
+  };
+
+ public:
+  explicit PageCache(const Options& options);
+
+  // nullptr if the page is not cached
+  Column Get(uint64_t storage_id, const PageId& page_id);
+  // unlike Get, doesn't count as a use of the page
+  bool Contains(uint64_t storage_id, const PageId& page_id) const;
+  // columns larger than the budget of a shard are not cached
+  void Put(uint64_t storage_id, const PageId& page_id, Column column);
+  void Erase(uint64_t storage_id, const PageId& page_id);
+
+  Stats GetStats() const;
+  size_t GetBytesSize() const;
+
+ private:
+  struct Key {
+    uint64_t storage_id;
+    PageId page_id;
+
+    bool operator==(const Key& other) const = default;
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key& key) const;
+  };
+
+  struct Entry {
+    Key key;
+    Column column;
+    size_t bytes_size;
+  };
+
+  struct Shard {
+    mutable std::mutex mutex;
+    // the most recently used page is the first
+    std::list<Entry> entries;
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+    size_t bytes_size{0};
+  };
+
+ private:
+  Shard& GetShard(const Key& key);
+  const Shard& GetShard(const Key& key) const;
+  void Evict(Shard& shard);
+
+ private:
+  size_t shard_max_bytes_size_;
+  std::vector<Shard> shards_;
+  std::atomic<uint64_t> hits_{0};
+  std::atomic<uint64_t> misses_{0};
+};
+
+}  // namespace tskv
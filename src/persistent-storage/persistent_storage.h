@@ -1,14 +1,37 @@
 #pragma once
 
+#include <atomic>
+#include <cassert>
+#include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <stdexcept>
 #include <string>
+#include <vector>
 #include "model/column.h"
 
 namespace tskv {
 
 using PageId = std::string;
 
+// Read-only bytes of a page, which may be a mapping of the page file
+struct PageView {
+  // keeps bytes alive: owns the buffer or unmaps the file
+  std::shared_ptr<const void> holder;
+  BytesView bytes;
+};
+
+// views owning the pages
+inline std::vector<PageView> ToPageViews(std::vector<CompressedBytes> pages) {
+  std::vector<PageView> views;
+  views.reserve(pages.size());
+  for (auto& page : pages) {
+    auto bytes = std::make_shared<const CompressedBytes>(std::move(page));
+    views.push_back({bytes, *bytes});
+  }
+  return views;
+}
+
 class IPersistentStorage {
  public:
   struct Metadata {};
@@ -16,11 +39,56 @@ class IPersistentStorage {
  public:
   virtual ~IPersistentStorage() = default;
 
+  // unique among storages of the process, page ids are unique only within a
+  // storage
+  uint64_t GetInstanceId() const { return instance_id_; }
+
   virtual Metadata GetMetadata() const = 0;
   virtual PageId CreatePage() = 0;
   virtual CompressedBytes Read(const PageId& page_id) = 0;
   virtual void Write(const PageId& page_id, const CompressedBytes& bytes) = 0;
   virtual void DeletePage(const PageId& page_id) = 0;
+  // bytes of the page for decoding, storages that can avoid copying them
+  // override it, by default they are read with Read
+  virtual PageView ReadView(const PageId& page_id) {
+    auto bytes = std::make_shared<const CompressedBytes>(Read(page_id));
+    return {bytes, *bytes};
+  }
+  // [offset, offset + size) bytes of the page, storages that can read a part
+  // of a page override it
+  virtual CompressedBytes ReadRange(const PageId& page_id, size_t offset,
+                                    size_t size) {
+    auto bytes = Read(page_id);
+    if (offset + size > bytes.size()) {
+      throw std::runtime_error("Range is out of page");
+    }
+    return {bytes.begin() + offset, bytes.begin() + offset + size};
+  }
+  // storages that can keep many requests in flight override batched reads
+  // and writes, by default pages are read with ReadView and written one by
+  // one
+  virtual std::vector<PageView> ReadMany(const std::vector<PageId>& page_ids) {
+    std::vector<PageView> pages;
+    pages.reserve(page_ids.size());
+    for (const auto& page_id : page_ids) {
+      pages.push_back(ReadView(page_id));
+    }
+    return pages;
+  }
+  virtual void WriteMany(const std::vector<PageId>& page_ids,
+                         const std::vector<CompressedBytes>& pages) {
+    assert(page_ids.size() == pages.size());
+    for (size_t i = 0; i < page_ids.size(); ++i) {
+      Write(page_ids[i], pages[i]);
+    }
+  }
+  // makes pages written and deleted before the call durable, storages which
+  // don't sync every write override it
+  virtual void Sync() {}
+
+ private:
+  static inline std::atomic<uint64_t> next_instance_id_{0};
+  uint64_t instance_id_{next_instance_id_++};
 };
 
 }  // namespace tskv
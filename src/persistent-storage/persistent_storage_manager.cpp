@@ -1,44 +1,240 @@
 #include "persistent_storage_manager.h"
 
+#include <mutex>
+#include <utility>
+
 #include "model/column.h"
 
 namespace tskv {
 
-PersistentStorageManager::PersistentStorageManager(const Options& options) {
+PersistentStorageManager::PersistentStorageManager(const Options& options)
+    : level_options_(options.levels),
+      storage_(options.storage),
+      compaction_scheduler_(options.compaction_scheduler),
+      page_cache_(options.page_cache) {
   for (size_t i = 0; i < options.levels.size(); ++i) {
-    levels_.emplace_back(options.levels[i], options.storage);
+    levels_.emplace_back(options.levels[i], options.storage, page_cache_);
   }
 }
 
-void PersistentStorageManager::Write(const SerializableColumns& columns) {
-  for (const auto& column : columns) {
-    levels_.front().Write(column);
-  }
+PersistentStorageManager::~PersistentStorageManager() {
+  std::unique_lock lock(mutex_);
+  compaction_finished_.wait(lock, [this] { return !compaction_scheduled_; });
+}
+
+void PersistentStorageManager::Write(
+    const SerializableColumns& columns,
+    const SerializableColumns& late_columns) {
+  Write(PrepareWrite(columns, late_columns));
+  Compact();
+}
+
+Level::PendingWrite PersistentStorageManager::PrepareWrite(
+    const SerializableColumns& columns,
+    const SerializableColumns& late_columns) const {
+  // level 0 is replaced by the compaction, but its options and storage stay
+  // the same, so pages are prepared by a level of its own
+  Level level(level_options_.front(), storage_, page_cache_);
+  return level.PrepareWrite(columns, late_columns);
+}
 
-  MergeLevels();
+void PersistentStorageManager::Write(Level::PendingWrite write) {
+  std::exception_ptr error;
+  std::vector<PageId> retired_page_ids;
+  {
+    std::unique_lock lock(mutex_);
+    error = std::exchange(compaction_error_, nullptr);
+    if (!error) {
+      levels_.front().Apply(std::move(write));
+      retired_page_ids = levels_.front().ExtractRetiredPages();
+    }
+  }
+  if (error) {
+    // the caller retries the write with new pages
+    for (const auto& page : write.pages) {
+      retired_page_ids.push_back(page.page_id);
+    }
+    for (const auto& page : write.late_pages) {
+      retired_page_ids.push_back(page.page_id);
+    }
+    DeletePages(retired_page_ids);
+    std::rethrow_exception(error);
+  }
+  DeletePages(retired_page_ids);
 }
 
 Column PersistentStorageManager::Read(
     const TimeRange& time_range, StoredAggregationType aggregation_type) const {
-  // TODO: not read all levels, check time_range and read only needed levels
+  std::shared_lock lock(mutex_);
+  auto decoded_pages = FetchPages(time_range, aggregation_type);
+  // levels read only pages that overlap time_range, so levels older than
+  // time_range cost nothing
   Column result;
   for (int i = levels_.size() - 1; i >= 0; --i) {
-    auto column = levels_[i].Read(time_range, aggregation_type);
-    if (result) {
-      result->Merge(column);
-    } else {
-      result = column;
-    }
+    auto column = levels_[i].Read(time_range, aggregation_type, decoded_pages);
+    // late records of newer levels may be older than data of older ones
+    result = MergeUnordered(std::static_pointer_cast<IReadColumn>(result),
+                            std::static_pointer_cast<IReadColumn>(column));
+  }
+  if (moving_) {
+    auto column =
+        moving_->level.Read(time_range, aggregation_type, decoded_pages);
+    result = MergeUnordered(std::static_pointer_cast<IReadColumn>(result),
+                            std::static_pointer_cast<IReadColumn>(column));
   }
   return result;
 }
 
+void PersistentStorageManager::Compact() {
+  {
+    std::unique_lock lock(mutex_);
+    if (compaction_scheduled_ || !NeedMerge()) {
+      return;
+    }
+    compaction_scheduled_ = true;
+  }
+  if (!compaction_scheduler_) {
+    RunCompaction();
+    return;
+  }
+  compaction_scheduler_->Schedule([this] { RunCompaction(); });
+}
+
+void PersistentStorageManager::RunCompaction() {
+  while (true) {
+    std::exception_ptr error;
+    try {
+      MergeLevels();
+    } catch (...) {
+      error = std::current_exception();
+    }
+
+    std::unique_lock lock(mutex_);
+    // writes may have filled level 0 again, they didn't schedule compaction
+    // because this one was running
+    if (error || !NeedMerge()) {
+      compaction_error_ = error;
+      compaction_scheduled_ = false;
+      compaction_finished_.notify_all();
+      return;
+    }
+  }
+}
+
 void PersistentStorageManager::MergeLevels() {
-  for (size_t i = 0; i < levels_.size() - 1; ++i) {
+  for (size_t i = 0; i + 1 < levels_.size(); ++i) {
+    MoveLevel(i);
+  }
+}
+
+void PersistentStorageManager::MoveLevel(size_t level_idx) {
+  std::optional<Level> level;
+  std::optional<Level> next_level;
+  {
+    std::unique_lock lock(mutex_);
+    if (!moving_) {
+      if (!levels_[level_idx].NeedMerge()) {
+        return;
+      }
+      moving_ = MovingLevel{
+          .level_idx = level_idx,
+          .level = std::exchange(levels_[level_idx],
+                                 Level(level_options_[level_idx], storage_,
+                                       page_cache_)),
+      };
+    } else if (moving_->level_idx != level_idx) {
+      // the move failed before, it's retried when its level comes
+      return;
+    }
+    // only the compaction changes levels after the first one, so the copy
+    // stays up to date
+    level = moving_->level;
+    next_level = levels_[level_idx + 1];
+  }
+
+  if (compaction_scheduler_) {
+    compaction_scheduler_->Throttle();
+  }
+  next_level->MovePagesFrom(*level);
+  auto retired_page_ids = next_level->ExtractRetiredPages();
+  for (auto& page_id : level->ExtractRetiredPages()) {
+    retired_page_ids.push_back(std::move(page_id));
+  }
+
+  {
+    std::unique_lock lock(mutex_);
+    levels_[level_idx + 1] = std::move(*next_level);
+    moving_.reset();
+  }
+  // reads that could use these pages have finished before the lock was taken
+  DeletePages(retired_page_ids);
+}
+
+bool PersistentStorageManager::NeedMerge() const {
+  if (moving_) {
+    return true;
+  }
+  for (size_t i = 0; i + 1 < levels_.size(); ++i) {
     if (levels_[i].NeedMerge()) {
-      levels_[i + 1].MovePagesFrom(levels_[i]);
+      return true;
+    }
+  }
+  return false;
+}
+
+void PersistentStorageManager::DeletePages(
+    const std::vector<PageId>& page_ids) {
+  for (const auto& page_id : page_ids) {
+    if (page_cache_) {
+      page_cache_->Erase(storage_->GetInstanceId(), page_id);
+    }
+    storage_->DeletePage(page_id);
+  }
+}
+
+Level::DecodedPages PersistentStorageManager::FetchPages(
+    const TimeRange& time_range, StoredAggregationType aggregation_type) const {
+  std::vector<Level::PageRef> page_refs;
+  for (const auto& level : levels_) {
+    auto level_page_refs = level.GetPagesToRead(time_range, aggregation_type);
+    page_refs.insert(page_refs.end(), level_page_refs.begin(),
+                     level_page_refs.end());
+  }
+  if (moving_) {
+    auto level_page_refs =
+        moving_->level.GetPagesToRead(time_range, aggregation_type);
+    page_refs.insert(page_refs.end(), level_page_refs.begin(),
+                     level_page_refs.end());
+  }
+
+  Level::DecodedPages decoded_pages;
+  std::vector<Level::PageRef> missed_page_refs;
+  std::vector<PageId> page_ids;
+  for (auto& page_ref : page_refs) {
+    if (page_cache_) {
+      if (auto column =
+              page_cache_->Get(storage_->GetInstanceId(), page_ref.page_id)) {
+        decoded_pages.emplace(page_ref.page_id, std::move(column));
+        continue;
+      }
+    }
+    page_ids.push_back(page_ref.page_id);
+    missed_page_refs.push_back(std::move(page_ref));
+  }
+  if (page_ids.empty()) {
+    return decoded_pages;
+  }
+
+  auto pages = storage_->ReadMany(page_ids);
+  for (size_t i = 0; i < pages.size(); ++i) {
+    const auto& page_ref = missed_page_refs[i];
+    auto column = FromBytes(pages[i].bytes, page_ref.column_type);
+    if (page_cache_) {
+      page_cache_->Put(storage_->GetInstanceId(), page_ref.page_id, column);
     }
+    decoded_pages.emplace(page_ref.page_id, std::move(column));
   }
+  return decoded_pages;
 }
 
 }  // namespace tskv
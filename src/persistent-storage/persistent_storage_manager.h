@@ -1,11 +1,17 @@
 #pragma once
 
+#include "compaction_scheduler.h"
 #include "level/level.h"
 #include "model/column.h"
 #include "model/model.h"
+#include "page_cache.h"
 #include "persistent_storage.h"
 
+#include <condition_variable>
+#include <exception>
 #include <memory>
+#include <optional>
+#include <shared_mutex>
 #include <vector>
 
 namespace tskv {
@@ -15,20 +21,75 @@ class PersistentStorageManager {
   struct Options {
     std::vector<Level::Options> levels;
     std::shared_ptr<IPersistentStorage> storage;
+    // if set, pages are moved between levels by the scheduler, otherwise
+    // inside Compact
+    std::shared_ptr<CompactionScheduler> compaction_scheduler;
+    // if set, decoded pages are cached for reads
+    std::shared_ptr<PageCache> page_cache;
   };
 
  public:
   explicit PersistentStorageManager(const Options& options);
-  void Write(const SerializableColumns& columns);
+  // waits for the background compaction
+  ~PersistentStorageManager();
+  // writes and reads may be called concurrently with the compaction, writes
+  // rethrow the error of the failed compaction
+  // late columns have records older than already written ones, compacts
+  // after the write
+  void Write(const SerializableColumns& columns,
+             const SerializableColumns& late_columns = {});
+  // stores pages of the columns without the lock, so that callers can do it
+  // outside of their own locks and only add the pages with Write under them
+  Level::PendingWrite PrepareWrite(
+      const SerializableColumns& columns,
+      const SerializableColumns& late_columns = {}) const;
+  // doesn't compact, so that callers can add the pages under their own locks
+  // and call Compact after them. If it throws, pages of the write are deleted
+  void Write(Level::PendingWrite write);
+  // moves pages between levels if they need it: schedules the move or,
+  // without the scheduler, does it in the calling thread. Only one
+  // compaction runs at a time, the error is rethrown by the next write
+  void Compact();
 
   Column Read(const TimeRange& time_range,
               StoredAggregationType aggregation_type) const;
 
  private:
+  struct MovingLevel {
+    size_t level_idx;
+    Level level;
+  };
+
+ private:
+  // merges levels until none of them needs it
+  void RunCompaction();
   void MergeLevels();
+  // moves pages of the level to the next one if it needs merge
+  void MoveLevel(size_t level_idx);
+  bool NeedMerge() const;
+  void DeletePages(const std::vector<PageId>& page_ids);
+  // fetches pages of all levels which are read whole for the query in one
+  // batch, the rest are fetched by levels
+  Level::DecodedPages FetchPages(const TimeRange& time_range,
+                                 StoredAggregationType aggregation_type) const;
 
  private:
+  std::vector<Level::Options> level_options_;
+  std::shared_ptr<IPersistentStorage> storage_;
+  std::shared_ptr<CompactionScheduler> compaction_scheduler_;
+  std::shared_ptr<PageCache> page_cache_;
+
+  // guards all members below. The level is moved to a copy of the next one
+  // without the lock, the copy replaces the next level in one critical
+  // section with the reset of moving_, so that reads see every page once
+  mutable std::shared_mutex mutex_;
   std::vector<Level> levels_;
+  // contents of the level which is being moved to the next one, the level
+  // itself takes new writes
+  std::optional<MovingLevel> moving_;
+  bool compaction_scheduled_{false};
+  std::condition_variable_any compaction_finished_;
+  std::exception_ptr compaction_error_;
 };
 
 }  // namespace tskv
@@ -0,0 +1,708 @@
+#include "segment_storage.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cassert>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "model/column.h"
+
+namespace tskv {
+
+namespace {
+
+constexpr const char* kLogName = "pages.log";
+constexpr const char* kSegmentExtension = ".seg";
+// the log is rewritten only when it's long enough, so that small tables
+// aren't rewritten on every reclamation
+constexpr size_t kMinRewriteLogEntriesNum = 1024;
+
+enum class LogOp : uint8_t {
+  kPut = 1,
+  kDelete = 2,
+};
+
+// [op][page id size][page id], puts are followed by [segment][offset][size],
+// segment 0 means the page is empty
+CompressedBytes MakeLogEntry(LogOp op, const PageId& page_id) {
+  // the entry is sized up front, GCC mistakes inserts into an empty vector
+  // for overflows
+  auto page_id_size = static_cast<uint32_t>(page_id.size());
+  CompressedBytes entry(sizeof(uint8_t) + sizeof(page_id_size) +
+                        page_id.size());
+  entry[0] = static_cast<uint8_t>(op);
+  std::memcpy(entry.data() + sizeof(uint8_t), &page_id_size,
+              sizeof(page_id_size));
+  std::memcpy(entry.data() + sizeof(uint8_t) + sizeof(page_id_size),
+              page_id.data(), page_id.size());
+  return entry;
+}
+
+CompressedBytes MakePutEntry(const PageId& page_id, uint64_t segment_id,
+                             uint64_t offset, uint64_t size) {
+  auto entry = MakeLogEntry(LogOp::kPut, page_id);
+  Append(entry, segment_id);
+  Append(entry, offset);
+  Append(entry, size);
+  return entry;
+}
+
+void ReadFully(int fd, uint8_t* data, size_t size, size_t offset) {
+  size_t read = 0;
+  while (read < size) {
+    auto res = pread(fd, data + read, size - read, offset + read);
+    if (res <= 0) {
+      throw std::runtime_error("failed to read segment");
+    }
+    read += res;
+  }
+}
+
+void WriteFully(int fd, const uint8_t* data, size_t size, size_t offset) {
+  size_t written = 0;
+  while (written < size) {
+    auto res = pwrite(fd, data + written, size - written, offset + written);
+    if (res <= 0) {
+      throw std::runtime_error("failed to write segment");
+    }
+    written += res;
+  }
+}
+
+void AppendFully(int fd, const CompressedBytes& bytes) {
+  size_t written = 0;
+  while (written < bytes.size()) {
+    auto res = write(fd, bytes.data() + written, bytes.size() - written);
+    if (res <= 0) {
+      throw std::runtime_error("failed to write table log");
+    }
+    written += res;
+  }
+}
+
+void SyncFd(int fd) {
+  if (fdatasync(fd) == -1) {
+    throw std::runtime_error("failed to sync segment storage");
+  }
+}
+
+void SyncDirectory(const std::filesystem::path& path) {
+  int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd == -1) {
+    throw std::runtime_error("failed to open segment storage directory");
+  }
+  int res = fsync(fd);
+  close(fd);
+  if (res == -1) {
+    throw std::runtime_error("failed to sync segment storage directory");
+  }
+}
+
+int OpenLog(const std::filesystem::path& path) {
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (fd == -1) {
+    throw std::runtime_error("failed to open table log");
+  }
+  return fd;
+}
+
+}  // namespace
+
+SegmentStorage::Segment::Segment(uint64_t id, int fd, size_t bytes_size)
+    : id(id), fd(fd), bytes_size(bytes_size) {}
+
+SegmentStorage::Segment::~Segment() {
+  close(fd);
+}
+
+SegmentStorage::SegmentStorage(const Options& options)
+    : path_(options.path),
+      max_segment_size_(options.max_segment_size),
+      reclaim_ratio_(options.reclaim_ratio),
+      reclaim_executor_(options.reclaim_executor),
+      io_ring_(options.io_ring) {
+  if (!std::filesystem::exists(path_)) {
+    std::filesystem::create_directories(path_);
+  }
+  Replay();
+  log_fd_ = OpenLog(path_ / kLogName);
+}
+
+SegmentStorage::~SegmentStorage() {
+  std::unique_lock lock(mutex_);
+  reclaim_finished_.wait(lock, [this] { return !reclaim_scheduled_; });
+  close(log_fd_);
+}
+
+void SegmentStorage::Replay() {
+  for (const auto& entry : std::filesystem::directory_iterator(path_)) {
+    if (entry.path().extension() != kSegmentExtension) {
+      continue;
+    }
+    uint64_t segment_id = std::stoull(entry.path().stem().string());
+    segments_[segment_id] = OpenSegment(segment_id);
+    next_segment_id_ = std::max(next_segment_id_, segment_id + 1);
+  }
+
+  auto log_path = path_ / kLogName;
+  if (!std::filesystem::exists(log_path)) {
+    return;
+  }
+  std::ifstream in(log_path, std::ios::binary);
+  CompressedBytes log(std::filesystem::file_size(log_path));
+  in.read(reinterpret_cast<char*>(log.data()), log.size());
+  CompressedBytesReader reader(log);
+  // earlier entries may point to reclaimed segments, so locations are
+  // resolved after the whole log is replayed
+  struct LogLocation {
+    uint64_t segment_id;
+    uint64_t offset;
+    uint64_t size;
+  };
+  std::unordered_map<PageId, LogLocation> locations;
+  auto is_in_segments = [this](const LogLocation& location) {
+    if (location.segment_id == 0) {
+      return true;
+    }
+    auto it = segments_.find(location.segment_id);
+    return it != segments_.end() &&
+           location.offset + location.size <= it->second->bytes_size;
+  };
+  size_t valid_size = 0;
+  while (true) {
+    // the last entry may be cut by a crash during the append
+    if (reader.Remaining() < sizeof(uint8_t) + sizeof(uint32_t)) {
+      break;
+    }
+    auto op = static_cast<LogOp>(reader.Read<uint8_t>());
+    auto page_id_size = reader.Read<uint32_t>();
+    size_t location_size = op == LogOp::kPut ? sizeof(LogLocation) : 0;
+    if (reader.Remaining() < page_id_size + location_size) {
+      break;
+    }
+    auto page_id_bytes = reader.ReadBytes(page_id_size);
+    PageId page_id(page_id_bytes.begin(), page_id_bytes.end());
+    if (op == LogOp::kPut) {
+      // the entry may reach the disk before bytes of the page, they are lost
+      // after a crash then, and the page keeps its previous location
+      auto location = reader.Read<LogLocation>();
+      if (is_in_segments(location)) {
+        locations[page_id] = location;
+      }
+      // ids of lost segments are not reused, so that their entries stay
+      // ignored
+      next_segment_id_ = std::max(next_segment_id_, location.segment_id + 1);
+    } else if (op == LogOp::kDelete) {
+      locations.erase(page_id);
+    } else {
+      throw std::runtime_error("Corrupted table log");
+    }
+    valid_size = log.size() - reader.Remaining();
+    ++log_entries_num_;
+
+    uint64_t page_number = 0;
+    auto [_, ec] = std::from_chars(page_id.data(),
+                                   page_id.data() + page_id.size(),
+                                   page_number);
+    if (ec == std::errc()) {
+      next_page_id_ = std::max(next_page_id_, page_number + 1);
+    }
+  }
+  if (valid_size != log.size()) {
+    std::filesystem::resize_file(log_path, valid_size);
+  }
+
+  for (const auto& [page_id, log_location] : locations) {
+    Location location;
+    if (log_location.segment_id != 0) {
+      const auto& segment = segments_.at(log_location.segment_id);
+      location = {segment, log_location.offset, log_location.size};
+      location.segment->live_bytes_size += location.size;
+    }
+    table_.emplace(page_id, std::move(location));
+  }
+  // segments of deleted pages which were not reclaimed before
+  std::erase_if(segments_, [this](const auto& item) {
+    const auto& [segment_id, segment] = item;
+    if (segment->live_bytes_size != 0) {
+      return false;
+    }
+    std::filesystem::remove(GetSegmentPath(segment_id));
+    return true;
+  });
+}
+
+SegmentStorage::Metadata SegmentStorage::GetMetadata() const {
+  return {};
+}
+
+PageId SegmentStorage::CreatePage() {
+  std::lock_guard lock(mutex_);
+  // pages are logged on the first write
+  auto page_id = std::to_string(next_page_id_++);
+  table_.emplace(page_id, Location{});
+  return page_id;
+}
+
+CompressedBytes SegmentStorage::Read(const PageId& page_id) {
+  auto location = GetLocation(page_id);
+  CompressedBytes bytes(location.size);
+  if (location.size != 0) {
+    ReadFully(location.segment->fd, bytes.data(), bytes.size(),
+              location.offset);
+  }
+  return bytes;
+}
+
+void SegmentStorage::Write(const PageId& page_id,
+                           const CompressedBytes& bytes) {
+  Location location;
+  {
+    std::lock_guard lock(mutex_);
+    RethrowReclaimError();
+    location = ReserveInSegment(bytes.size());
+  }
+  try {
+    if (location.segment) {
+      WriteFully(location.segment->fd, bytes.data(), bytes.size(),
+                 location.offset);
+    }
+  } catch (...) {
+    std::lock_guard lock(mutex_);
+    FinishWrite(location);
+    throw;
+  }
+  std::lock_guard lock(mutex_);
+  FinishWrite(location);
+  SetLocation(page_id, std::move(location));
+}
+
+void SegmentStorage::DeletePage(const PageId& page_id) {
+  {
+    std::lock_guard lock(mutex_);
+    RethrowReclaimError();
+    auto it = table_.find(page_id);
+    if (it == table_.end()) {
+      return;
+    }
+    AppendToLog(MakeLogEntry(LogOp::kDelete, page_id));
+    if (it->second.segment) {
+      it->second.segment->live_bytes_size -= it->second.size;
+    }
+    table_.erase(it);
+    if (reclaim_scheduled_ || !NeedReclaim()) {
+      return;
+    }
+    reclaim_scheduled_ = true;
+  }
+
+  if (reclaim_executor_) {
+    reclaim_executor_->Submit([this] { ReclaimInBackground(); });
+    return;
+  }
+  std::exception_ptr error;
+  try {
+    Reclaim();
+  } catch (...) {
+    error = std::current_exception();
+  }
+  {
+    std::lock_guard lock(mutex_);
+    reclaim_scheduled_ = false;
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+CompressedBytes SegmentStorage::ReadRange(const PageId& page_id,
+                                          size_t offset, size_t size) {
+  auto location = GetLocation(page_id);
+  if (offset + size > location.size) {
+    throw std::runtime_error("Range is out of page");
+  }
+  CompressedBytes bytes(size);
+  if (size != 0) {
+    ReadFully(location.segment->fd, bytes.data(), size,
+              location.offset + offset);
+  }
+  return bytes;
+}
+
+std::vector<PageView> SegmentStorage::ReadMany(
+    const std::vector<PageId>& page_ids) {
+  if (!io_ring_) {
+    return IPersistentStorage::ReadMany(page_ids);
+  }
+  // locations keep segments of the batch open
+  std::vector<Location> locations;
+  locations.reserve(page_ids.size());
+  {
+    std::lock_guard lock(mutex_);
+    for (const auto& page_id : page_ids) {
+      auto it = table_.find(page_id);
+      if (it == table_.end()) {
+        throw std::runtime_error("page not found");
+      }
+      locations.push_back(it->second);
+    }
+  }
+
+  std::vector<CompressedBytes> pages(page_ids.size());
+  std::vector<IoRing::Request> requests;
+  requests.reserve(page_ids.size());
+  for (size_t i = 0; i < page_ids.size(); ++i) {
+    const auto& location = locations[i];
+    pages[i].resize(location.size);
+    if (location.segment) {
+      requests.push_back(IoRing::Request::Read(
+          location.segment->fd, pages[i].data(), location.size,
+          location.offset));
+    }
+  }
+  io_ring_->Run(requests);
+  return ToPageViews(std::move(pages));
+}
+
+void SegmentStorage::WriteMany(const std::vector<PageId>& page_ids,
+                               const std::vector<CompressedBytes>& pages) {
+  assert(page_ids.size() == pages.size());
+  if (!io_ring_) {
+    IPersistentStorage::WriteMany(page_ids, pages);
+    return;
+  }
+  std::vector<Location> locations;
+  locations.reserve(page_ids.size());
+  {
+    std::lock_guard lock(mutex_);
+    RethrowReclaimError();
+    for (const auto& bytes : pages) {
+      locations.push_back(ReserveInSegment(bytes.size()));
+    }
+  }
+  std::vector<IoRing::Request> requests;
+  requests.reserve(page_ids.size());
+  for (size_t i = 0; i < pages.size(); ++i) {
+    const auto& location = locations[i];
+    if (location.segment) {
+      requests.push_back(IoRing::Request::Write(location.segment->fd,
+                                                pages[i].data(),
+                                                pages[i].size(),
+                                                location.offset));
+    }
+  }
+  try {
+    io_ring_->Run(requests);
+  } catch (...) {
+    std::lock_guard lock(mutex_);
+    for (const auto& location : locations) {
+      FinishWrite(location);
+    }
+    throw;
+  }
+  // pages are logged only after all of them are written
+  std::lock_guard lock(mutex_);
+  for (size_t i = 0; i < page_ids.size(); ++i) {
+    FinishWrite(locations[i]);
+    SetLocation(page_ids[i], std::move(locations[i]));
+  }
+}
+
+void SegmentStorage::Sync() {
+  std::vector<std::shared_ptr<Segment>> segments;
+  int log_fd = -1;
+  bool dir_synced = true;
+  {
+    std::lock_guard lock(mutex_);
+    if (!log_synced_) {
+      // the log may be rewritten and closed meanwhile
+      log_fd = dup(log_fd_);
+      if (log_fd == -1) {
+        throw std::runtime_error("failed to sync table log");
+      }
+      log_synced_ = true;
+    }
+    for (const auto& [_, segment] : segments_) {
+      if (!std::exchange(segment->synced, true)) {
+        segments.push_back(segment);
+      }
+    }
+    dir_synced = std::exchange(dir_synced_, true);
+  }
+  // the log is synced last, so that it never points to bytes which are lost
+  // after a crash
+  try {
+    for (const auto& segment : segments) {
+      SyncFd(segment->fd);
+    }
+    if (!dir_synced) {
+      SyncDirectory(path_);
+    }
+    if (log_fd != -1) {
+      SyncFd(log_fd);
+    }
+  } catch (...) {
+    std::lock_guard lock(mutex_);
+    for (const auto& segment : segments) {
+      segment->synced = false;
+    }
+    log_synced_ = log_synced_ && log_fd == -1;
+    dir_synced_ = dir_synced_ && dir_synced;
+    if (log_fd != -1) {
+      close(log_fd);
+    }
+    throw;
+  }
+  if (log_fd != -1) {
+    close(log_fd);
+  }
+}
+
+size_t SegmentStorage::SegmentsNum() const {
+  std::lock_guard lock(mutex_);
+  return segments_.size();
+}
+
+SegmentStorage::Location SegmentStorage::GetLocation(
+    const PageId& page_id) const {
+  std::lock_guard lock(mutex_);
+  auto it = table_.find(page_id);
+  if (it == table_.end()) {
+    throw std::runtime_error("page not found");
+  }
+  return it->second;
+}
+
+SegmentStorage::Location SegmentStorage::ReserveInSegment(size_t size) {
+  if (size == 0) {
+    return {};
+  }
+  if (!active_segment_ || active_segment_->bytes_size >= max_segment_size_) {
+    active_segment_ = OpenSegment(next_segment_id_++);
+    segments_[active_segment_->id] = active_segment_;
+    dir_synced_ = false;
+  }
+  Location location{
+      .segment = active_segment_,
+      .offset = active_segment_->bytes_size,
+      .size = size,
+  };
+  // bytes of failed writes are never live, so they are reclaimed
+  active_segment_->bytes_size += size;
+  ++active_segment_->pending_writes_num;
+  return location;
+}
+
+void SegmentStorage::FinishWrite(const Location& location) {
+  if (location.segment) {
+    --location.segment->pending_writes_num;
+  }
+}
+
+void SegmentStorage::SetLocation(const PageId& page_id, Location location) {
+  auto segment_id = location.segment ? location.segment->id : 0;
+  AppendToLog(
+      MakePutEntry(page_id, segment_id, location.offset, location.size));
+  auto& current = table_[page_id];
+  if (current.segment) {
+    current.segment->live_bytes_size -= current.size;
+  }
+  if (location.segment) {
+    location.segment->live_bytes_size += location.size;
+    location.segment->synced = false;
+  }
+  current = std::move(location);
+}
+
+std::shared_ptr<SegmentStorage::Segment> SegmentStorage::OpenSegment(
+    uint64_t segment_id) {
+  auto path = GetSegmentPath(segment_id);
+  int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd == -1) {
+    throw std::runtime_error("failed to open segment");
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) == -1) {
+    close(fd);
+    throw std::runtime_error("failed to stat segment");
+  }
+  return std::make_shared<Segment>(segment_id, fd, file_stat.st_size);
+}
+
+std::filesystem::path SegmentStorage::GetSegmentPath(
+    uint64_t segment_id) const {
+  return path_ / (std::to_string(segment_id) + kSegmentExtension);
+}
+
+void SegmentStorage::AppendToLog(const CompressedBytes& entry) {
+  AppendFully(log_fd_, entry);
+  ++log_entries_num_;
+  log_synced_ = false;
+}
+
+void SegmentStorage::RewriteLog() {
+  CompressedBytes log;
+  for (const auto& [page_id, location] : table_) {
+    auto segment_id = location.segment ? location.segment->id : 0;
+    auto entry =
+        MakePutEntry(page_id, segment_id, location.offset, location.size);
+    log.insert(log.end(), entry.begin(), entry.end());
+  }
+  // the new log replaces the old one atomically
+  auto log_path = path_ / kLogName;
+  auto tmp_path = path_ / (std::string(kLogName) + ".tmp");
+  {
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(log.data()), log.size());
+    if (!out) {
+      throw std::runtime_error("failed to write table log");
+    }
+  }
+  int tmp_fd = OpenLog(tmp_path);
+  try {
+    SyncFd(tmp_fd);
+  } catch (...) {
+    close(tmp_fd);
+    throw;
+  }
+  close(tmp_fd);
+  std::filesystem::rename(tmp_path, log_path);
+  SyncDirectory(path_);
+  close(log_fd_);
+  log_fd_ = OpenLog(log_path);
+  log_entries_num_ = table_.size();
+  log_synced_ = true;
+}
+
+bool SegmentStorage::NeedReclaim() const {
+  return PickSegmentToReclaim() ||
+         log_entries_num_ > 2 * table_.size() + kMinRewriteLogEntriesNum;
+}
+
+std::shared_ptr<SegmentStorage::Segment>
+SegmentStorage::PickSegmentToReclaim() const {
+  for (const auto& [_, segment] : segments_) {
+    // bytes of pending writes are not live yet
+    if (segment == active_segment_ || segment->pending_writes_num != 0) {
+      continue;
+    }
+    auto dead_bytes_size = segment->bytes_size - segment->live_bytes_size;
+    if (dead_bytes_size != 0 &&
+        dead_bytes_size >= reclaim_ratio_ * segment->bytes_size) {
+      return segment;
+    }
+  }
+  return nullptr;
+}
+
+void SegmentStorage::Reclaim() {
+  while (true) {
+    std::shared_ptr<Segment> segment;
+    std::vector<std::pair<PageId, Location>> pages;
+    {
+      std::lock_guard lock(mutex_);
+      segment = PickSegmentToReclaim();
+      if (!segment) {
+        break;
+      }
+      for (const auto& [page_id, location] : table_) {
+        if (location.segment == segment) {
+          pages.emplace_back(page_id, location);
+        }
+      }
+    }
+
+    // live pages are read and copied without the lock, the segment is
+    // sealed, so only their locations may change meanwhile
+    std::vector<CompressedBytes> pages_bytes;
+    for (const auto& [_, location] : pages) {
+      auto& bytes = pages_bytes.emplace_back(location.size);
+      ReadFully(segment->fd, bytes.data(), bytes.size(), location.offset);
+    }
+    std::vector<Location> new_locations;
+    {
+      std::lock_guard lock(mutex_);
+      for (const auto& bytes : pages_bytes) {
+        new_locations.push_back(ReserveInSegment(bytes.size()));
+      }
+    }
+    try {
+      for (size_t i = 0; i < pages_bytes.size(); ++i) {
+        const auto& location = new_locations[i];
+        WriteFully(location.segment->fd, pages_bytes[i].data(),
+                   pages_bytes[i].size(), location.offset);
+      }
+    } catch (...) {
+      std::lock_guard lock(mutex_);
+      for (const auto& location : new_locations) {
+        FinishWrite(location);
+      }
+      throw;
+    }
+
+    {
+      std::lock_guard lock(mutex_);
+      for (size_t i = 0; i < pages.size(); ++i) {
+        const auto& [page_id, location] = pages[i];
+        FinishWrite(new_locations[i]);
+        auto it = table_.find(page_id);
+        // the page was deleted or rewritten, its copy is dead
+        if (it == table_.end() || it->second.segment != segment ||
+            it->second.offset != location.offset) {
+          continue;
+        }
+        SetLocation(page_id, std::move(new_locations[i]));
+      }
+      assert(segment->live_bytes_size == 0);
+      segments_.erase(segment->id);
+    }
+    // copies and their locations are synced before the segment is removed,
+    // so that the log doesn't point to it after a crash. Reads of the
+    // segment which are in progress keep its file open
+    Sync();
+    std::filesystem::remove(GetSegmentPath(segment->id));
+    std::lock_guard lock(mutex_);
+    dir_synced_ = false;
+  }
+
+  std::lock_guard lock(mutex_);
+  if (log_entries_num_ > 2 * table_.size() + kMinRewriteLogEntriesNum) {
+    RewriteLog();
+  }
+}
+
+void SegmentStorage::ReclaimInBackground() {
+  while (true) {
+    std::exception_ptr error;
+    try {
+      Reclaim();
+    } catch (...) {
+      error = std::current_exception();
+    }
+
+    std::lock_guard lock(mutex_);
+    // deletes during the reclamation didn't schedule another one
+    if (error || !NeedReclaim()) {
+      reclaim_error_ = error;
+      reclaim_scheduled_ = false;
+      reclaim_finished_.notify_all();
+      return;
+    }
+  }
+}
+
+void SegmentStorage::RethrowReclaimError() {
+  if (reclaim_error_) {
+    std::rethrow_exception(std::exchange(reclaim_error_, nullptr));
+  }
+}
+
+}  // namespace tskv
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "executor/background_executor.h"
+#include "io_ring.h"
+#include "persistent_storage.h"
+
+namespace tskv {
+
+// Appends pages to large segment files instead of creating a file per page.
+// Locations of pages are kept in memory and persisted in an append-only
+// table log, which is replayed on open. Space of deleted and rewritten pages
+// is reclaimed by copying live pages of mostly dead segments to the active
+// one.
+class SegmentStorage : public IPersistentStorage {
+ public:
+  struct Options {
+    std::string path;
+    // pages are appended to the active segment until it reaches this size
+    size_t max_segment_size{64 * 1024 * 1024};
+    // sealed segments with at least this share of dead bytes are reclaimed
+    double reclaim_ratio{0.5};
+    // if set, space is reclaimed by the executor, otherwise inside DeletePage
+    std::shared_ptr<BackgroundExecutor> reclaim_executor;
+    // if set, ReadMany and WriteMany keep all requests of a batch in flight
+    std::shared_ptr<IoRing> io_ring;
+  };
+
+ public:
+  explicit SegmentStorage(const Options& options);
+  // waits for the background reclamation
+  ~SegmentStorage() override;
+
+  SegmentStorage(const SegmentStorage&) = delete;
+  SegmentStorage& operator=(const SegmentStorage&) = delete;
+
+  Metadata GetMetadata() const override;
+  PageId CreatePage() override;
+  CompressedBytes Read(const PageId& page_id) override;
+  // writes and deletes rethrow the error of the failed background
+  // reclamation
+  void Write(const PageId& page_id, const CompressedBytes& bytes) override;
+  void DeletePage(const PageId& page_id) override;
+  CompressedBytes ReadRange(const PageId& page_id, size_t offset,
+                            size_t size) override;
+  std::vector<PageView> ReadMany(
+      const std::vector<PageId>& page_ids) override;
+  void WriteMany(const std::vector<PageId>& page_ids,
+                 const std::vector<CompressedBytes>& pages) override;
+  // syncs segments written since the previous call before the table log
+  void Sync() override;
+
+  size_t SegmentsNum() const;
+
+ private:
+  struct Segment {
+    Segment(uint64_t id, int fd, size_t bytes_size);
+    ~Segment();
+
+    Segment(const Segment&) = delete;
+    Segment& operator=(const Segment&) = delete;
+
+    uint64_t id;
+    int fd;
+    size_t bytes_size;
+    // bytes of pages which are still in the table
+    size_t live_bytes_size{0};
+    // reserved ranges which are being written, the segment isn't reclaimed
+    // until they are finished
+    size_t pending_writes_num{0};
+    // pages were written to the segment since it was synced
+    bool synced{true};
+  };
+
+  struct Location {
+    // null for pages which were created but not written
+    std::shared_ptr<Segment> segment;
+    size_t offset{0};
+    size_t size{0};
+  };
+
+ private:
+  void Replay();
+  Location GetLocation(const PageId& page_id) const;
+  // space for bytes at the end of the active segment, starting a new one if
+  // it's full. The space is written without the lock, and FinishWrite is
+  // called under it once the write succeeds or fails
+  Location ReserveInSegment(size_t size);
+  void FinishWrite(const Location& location);
+  void SetLocation(const PageId& page_id, Location location);
+  std::shared_ptr<Segment> OpenSegment(uint64_t segment_id);
+  std::filesystem::path GetSegmentPath(uint64_t segment_id) const;
+  void AppendToLog(const CompressedBytes& entry);
+  // replaces the log with the current table when most entries are stale
+  void RewriteLog();
+
+  bool NeedReclaim() const;
+  std::shared_ptr<Segment> PickSegmentToReclaim() const;
+  void Reclaim();
+  void ReclaimInBackground();
+  void RethrowReclaimError();
+
+ private:
+  std::filesystem::path path_;
+  size_t max_segment_size_;
+  double reclaim_ratio_;
+  std::shared_ptr<BackgroundExecutor> reclaim_executor_;
+  std::shared_ptr<IoRing> io_ring_;
+
+  // guards all members below. Reads and writes copy or reserve the page
+  // location under it and do the I/O without it, the segment file stays open
+  // while it's used even if it's reclaimed
+  mutable std::mutex mutex_;
+  std::unordered_map<PageId, Location> table_;
+  std::map<uint64_t, std::shared_ptr<Segment>> segments_;
+  std::shared_ptr<Segment> active_segment_;
+  uint64_t next_segment_id_{1};
+  uint64_t next_page_id_{1};
+  int log_fd_{-1};
+  size_t log_entries_num_{0};
+  bool log_synced_{true};
+  // segments were created or removed since the directory was synced
+  bool dir_synced_{true};
+  bool reclaim_scheduled_{false};
+  std::condition_variable reclaim_finished_;
+  std::exception_ptr reclaim_error_;
+};
+
+}  // namespace tskv
@@ -1,8 +1,27 @@
 #include "storage.h"
+
+#include <algorithm>
+#include <mutex>
+#include <numeric>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include "model/aggregations.h"
 
 namespace tskv {
 
+namespace {
+
+[[noreturn]] void ThrowNotFound(MetricId id) {
+  throw std::runtime_error("Metric with id " + std::to_string(id) +
+                           " not found");
+}
+
+}  // namespace
+
 void ValidateOptions(const MetricStorage::Options& options) {
   auto memtable_options = options.memtable_options;
   auto persistent_storage_options = options.persistent_storage_manager_options;
@@ -46,36 +65,213 @@ void ValidateOptions(const MetricStorage::Options& options) {
   }
 }
 
+Storage::Storage(size_t shards_num, std::shared_ptr<WriteAheadLog> wal)
+    : shards_(shards_num), wal_(std::move(wal)) {
+  if (shards_num == 0) {
+    throw std::runtime_error("Storage should have at least one shard");
+  }
+}
+
 MetricId Storage::InitMetric(const MetricStorage::Options& options) {
   ValidateOptions(options);
+  if (const auto& persistent_storage =
+          options.persistent_storage_manager_options.storage) {
+    std::lock_guard lock(persistent_storages_mutex_);
+    if (std::ranges::find(persistent_storages_, persistent_storage) ==
+        persistent_storages_.end()) {
+      persistent_storages_.push_back(persistent_storage);
+    }
+  }
   MetricId id = next_id_++;
-  metrics_.emplace(id, options);
+  auto& shard = GetShard(id);
+  std::unique_lock lock(shard.mutex);
+  shard.metrics.emplace(id, options);
   return id;
 }
 
 void Storage::Write(MetricId id, const InputTimeSeries& input) {
-  auto it = metrics_.find(id);
-  if (it == metrics_.end()) {
-    throw std::runtime_error("Metric with id " + std::to_string(id) +
-                             " not found");
+  if (!wal_) {
+    WriteMetric(id, input, std::nullopt);
+    return;
+  }
+  if (id >= next_id_) {
+    ThrowNotFound(id);
+  }
+  // series are logged as batches of one metric, but applied directly
+  InputBatch batch;
+  for (const auto& record : input) {
+    batch.Add(id, record.timestamp, record.value);
+  }
+  {
+    std::shared_lock wal_lock(wal_mutex_);
+    WriteMetric(id, input, wal_->Append(batch));
+  }
+  MaybeTruncateWal();
+}
+
+void Storage::WriteBatch(const InputBatch& batch) {
+  // only batches which can be applied are logged
+  ValidateBatch(batch);
+  if (!wal_) {
+    ApplyBatch(batch, std::nullopt);
+    return;
+  }
+  {
+    std::shared_lock wal_lock(wal_mutex_);
+    ApplyBatch(batch, wal_->Append(batch));
+  }
+  MaybeTruncateWal();
+}
+
+void Storage::ValidateBatch(const InputBatch& batch) const {
+  auto size = batch.Size();
+  if (batch.timestamps.size() != size || batch.values.size() != size) {
+    throw std::runtime_error("Batch columns have different sizes");
+  }
+  MetricId ids_num = next_id_;
+  for (auto id : batch.metric_ids) {
+    if (id >= ids_num) {
+      ThrowNotFound(id);
+    }
+  }
+}
+
+void Storage::ApplyBatch(const InputBatch& batch,
+                         std::optional<uint64_t> lsn) {
+  // records are grouped by shard and metric, only ids of the batch are
+  // sorted, so the cost doesn't depend on the number of metrics. The sort is
+  // stable, so records of every metric keep their order
+  auto shards_num = shards_.size();
+  auto key = [&batch, shards_num](size_t i) {
+    auto id = batch.metric_ids[i];
+    return std::pair(id % shards_num, id);
+  };
+  std::vector<size_t> order(batch.Size());
+  std::iota(order.begin(), order.end(), 0);
+  std::ranges::stable_sort(order, {}, key);
+
+  // every shard is locked once, a single buffer is reused for series of all
+  // metrics
+  InputTimeSeries time_series;
+  std::unique_lock<std::shared_mutex> lock;
+  for (size_t begin = 0; begin < order.size();) {
+    auto id = batch.metric_ids[order[begin]];
+    time_series.clear();
+    auto end = begin;
+    for (; end < order.size() && batch.metric_ids[order[end]] == id; ++end) {
+      time_series.push_back(
+          {batch.timestamps[order[end]], batch.values[order[end]]});
+    }
+    auto& shard = GetShard(id);
+    if (lock.mutex() != &shard.mutex) {
+      if (lock.owns_lock()) {
+        lock.unlock();
+      }
+      lock = std::unique_lock(shard.mutex);
+    }
+    FindMetric(shard, id).Write(time_series, lsn);
+    begin = end;
+  }
+}
+
+void Storage::WriteMetric(MetricId id, const InputTimeSeries& input,
+                          std::optional<uint64_t> lsn) {
+  auto& shard = GetShard(id);
+  std::unique_lock lock(shard.mutex);
+  FindMetric(shard, id).Write(input, lsn);
+}
+
+MetricStorage& Storage::FindMetric(Shard& shard, MetricId id) {
+  auto it = shard.metrics.find(id);
+  if (it == shard.metrics.end()) {
+    ThrowNotFound(id);
   }
-  it->second.Write(input);
+  return it->second;
 }
 
 Column Storage::Read(MetricId id, const TimeRange& time_range,
                      AggregationType aggregation_type) const {
-  auto it = metrics_.find(id);
-  if (it == metrics_.end()) {
-    throw std::runtime_error("Metric with id " + std::to_string(id) +
-                             " not found");
+  const auto& shard = GetShard(id);
+  std::shared_lock lock(shard.mutex);
+  auto it = shard.metrics.find(id);
+  if (it == shard.metrics.end()) {
+    ThrowNotFound(id);
   }
   return it->second.Read(time_range, aggregation_type);
 }
 
 void Storage::Flush() {
-  for (auto& [_, metric] : metrics_) {
-    metric.Flush();
+  for (auto& shard : shards_) {
+    std::unique_lock lock(shard.mutex);
+    for (auto& [_, metric] : shard.metrics) {
+      metric.Flush();
+    }
+  }
+  if (wal_) {
+    TruncateWal();
   }
 }
 
+void Storage::ReplayWal() {
+  if (!wal_) {
+    return;
+  }
+  wal_->Replay([this](uint64_t lsn, const InputBatch& batch) {
+    ValidateBatch(batch);
+    ApplyBatch(batch, lsn);
+  });
+}
+
+void Storage::MaybeTruncateWal() {
+  auto files_num = wal_->FilesNum();
+  auto truncated_files_num = wal_files_num_.load();
+  if (files_num <= 1 || files_num == truncated_files_num ||
+      !wal_files_num_.compare_exchange_strong(truncated_files_num,
+                                              files_num)) {
+    return;
+  }
+  TruncateWal();
+  wal_files_num_ = wal_->FilesNum();
+}
+
+void Storage::TruncateWal() {
+  uint64_t lsn = 0;
+  {
+    // no logged batch is waiting to be applied under the unique lock
+    std::unique_lock wal_lock(wal_mutex_);
+    lsn = wal_->GetNextLsn();
+    for (const auto& shard : shards_) {
+      std::shared_lock lock(shard.mutex);
+      for (const auto& [_, metric] : shard.metrics) {
+        if (auto first_lsn = metric.GetFirstUnflushedLsn()) {
+          lsn = std::min(lsn, *first_lsn);
+        }
+      }
+    }
+  }
+  // records before the lsn were written to the storages, writes are synced
+  // without the lock, so they don't block logged writes
+  SyncPersistentStorages();
+  wal_->Truncate(lsn);
+}
+
+void Storage::SyncPersistentStorages() {
+  std::vector<std::shared_ptr<IPersistentStorage>> persistent_storages;
+  {
+    std::lock_guard lock(persistent_storages_mutex_);
+    persistent_storages = persistent_storages_;
+  }
+  for (const auto& persistent_storage : persistent_storages) {
+    persistent_storage->Sync();
+  }
+}
+
+Storage::Shard& Storage::GetShard(MetricId id) {
+  return shards_[id % shards_.size()];
+}
+
+const Storage::Shard& Storage::GetShard(MetricId id) const {
+  return shards_[id % shards_.size()];
+}
+
 }  // namespace tskv
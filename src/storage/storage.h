@@ -2,25 +2,98 @@
 
 #include "metric-storage/metric_storage.h"
 #include "model/model.h"
+#include "wal/write_ahead_log.h"
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
 #include <unordered_map>
+#include <vector>
 
 namespace tskv {
 
 using MetricId = uint64_t;
 
+// Columnar batch of records of many metrics: i-th record is (timestamps[i],
+// values[i]) of metric metric_ids[i]. Records of every metric must keep
+// their time order
+struct InputBatch {
+  std::vector<MetricId> metric_ids;
+  std::vector<TimePoint> timestamps;
+  std::vector<Value> values;
+
+  void Add(MetricId metric_id, TimePoint timestamp, Value value) {
+    metric_ids.push_back(metric_id);
+    timestamps.push_back(timestamp);
+    values.push_back(value);
+  }
+  size_t Size() const { return metric_ids.size(); }
+  // keeps capacity, so that the batch can be reused
+  void Clear() {
+    metric_ids.clear();
+    timestamps.clear();
+    values.clear();
+  }
+};
+
+// Metrics are partitioned into shards by id, every shard has its own lock.
+// All methods are thread-safe: metrics of different shards are written in
+// parallel, and reads only block writes of their own shard.
 class Storage {
  public:
+  // if wal is set, writes are logged before they are applied, and files of
+  // the log are deleted once records of all their writes are flushed
+  explicit Storage(size_t shards_num = 1,
+                   std::shared_ptr<WriteAheadLog> wal = nullptr);
   MetricId InitMetric(const MetricStorage::Options& options);
   Column Read(MetricId metric_id, const TimeRange& time_range,
               AggregationType aggregation_type) const;
 
   void Write(MetricId metric_id, const InputTimeSeries& time_series);
+  // writes every metric of the batch once, so lookups and flush checks are
+  // done per metric instead of per series
+  void WriteBatch(const InputBatch& batch);
   void Flush();
+  // writes batches of the log again after a restart. Metrics must be
+  // initialized in the same order as before it, so that they get the same
+  // ids
+  void ReplayWal();
+
+ private:
+  struct Shard {
+    mutable std::shared_mutex mutex;
+    std::unordered_map<MetricId, MetricStorage> metrics;
+  };
+
+  Shard& GetShard(MetricId metric_id);
+  const Shard& GetShard(MetricId metric_id) const;
+  void ValidateBatch(const InputBatch& batch) const;
+  void ApplyBatch(const InputBatch& batch, std::optional<uint64_t> lsn);
+  void WriteMetric(MetricId metric_id, const InputTimeSeries& time_series,
+                   std::optional<uint64_t> lsn);
+  // the shard must be locked
+  MetricStorage& FindMetric(Shard& shard, MetricId metric_id);
+  // tries to truncate the log once a new file of it is started
+  void MaybeTruncateWal();
+  // pages of flushed records are synced before their log files are deleted
+  void TruncateWal();
+  void SyncPersistentStorages();
 
  private:
-  std::unordered_map<MetricId, MetricStorage> metrics_;
-  size_t next_id_ = 0;
+  std::vector<Shard> shards_;
+  std::atomic<MetricId> next_id_{0};
+  std::shared_ptr<WriteAheadLog> wal_;
+  // logged batches are applied under the shared lock, so that the
+  // truncation sees every logged batch in the metrics
+  std::shared_mutex wal_mutex_;
+  // number of log files after the last truncation
+  std::atomic<size_t> wal_files_num_{0};
+  // distinct persistent storages of the metrics
+  std::mutex persistent_storages_mutex_;
+  std::vector<std::shared_ptr<IPersistentStorage>> persistent_storages_;
 };
 
 }  // namespace tskv
@@ -0,0 +1,37 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include "executor/background_executor.h"
+
+TEST(BackgroundExecutor, RunsTasks) {
+  std::atomic<int> sum{0};
+  tskv::BackgroundExecutor executor(4);
+  for (int i = 1; i <= 100; ++i) {
+    executor.Submit([&sum, i] { sum += i; });
+  }
+  executor.Wait();
+  EXPECT_EQ(sum, 5050);
+
+  executor.Submit([&sum] { sum = 0; });
+  executor.Wait();
+  EXPECT_EQ(sum, 0);
+}
+
+TEST(BackgroundExecutor, Order) {
+  std::vector<int> order;
+  {
+    // single thread runs tasks one by one, queued tasks are run on
+    // destruction
+    tskv::BackgroundExecutor executor;
+    for (int i = 0; i < 10; ++i) {
+      executor.Submit([&order, i] { order.push_back(i); });
+    }
+  }
+  EXPECT_EQ(order, std::vector<int>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+}
+
+TEST(BackgroundExecutor, NoThreads) {
+  EXPECT_THROW(tskv::BackgroundExecutor(0), std::runtime_error);
+}
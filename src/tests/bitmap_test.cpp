@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+#include "model/bitmap.h"
+
+namespace {
+
+std::vector<bool> ToBools(const tskv::Bitmap& bitmap) {
+  std::vector<bool> res;
+  for (size_t i = 0; i < bitmap.Size(); ++i) {
+    res.push_back(bitmap.Get(i));
+  }
+  return res;
+}
+
+}  // namespace
+
+TEST(Bitmap, Basic) {
+  tskv::Bitmap bitmap(100, false);
+  EXPECT_EQ(bitmap.Size(), 100);
+  EXPECT_TRUE(bitmap.None());
+  bitmap.Set(0);
+  bitmap.Set(63);
+  bitmap.Set(64);
+  bitmap.Set(99);
+  EXPECT_EQ(bitmap.Count(), 4);
+  EXPECT_EQ(bitmap.Count(1, 64), 1);
+  EXPECT_EQ(bitmap.Count(63, 65), 2);
+  bitmap.Set(63, false);
+  EXPECT_FALSE(bitmap.Get(63));
+  EXPECT_EQ(bitmap.ToWords(), (std::vector<uint64_t>{1, 1 | (1ull << 35)}));
+
+  EXPECT_TRUE(tskv::Bitmap(130, true).All());
+  bitmap.Resize(65);
+  EXPECT_EQ(bitmap.Count(), 2);
+  bitmap.Resize(200, true);
+  EXPECT_EQ(bitmap.Count(), 137);
+}
+
+TEST(Bitmap, SliceAndAppend) {
+  std::mt19937_64 gen(42);
+  tskv::Bitmap bitmap;
+  std::vector<bool> expected;
+  for (int i = 0; i < 1000; ++i) {
+    bool bit = gen() % 3 == 0;
+    bitmap.Resize(bitmap.Size() + 1);
+    bitmap.Set(i, bit);
+    expected.push_back(bit);
+  }
+  EXPECT_EQ(ToBools(bitmap), expected);
+
+  for (auto [begin, end] : std::vector<std::pair<size_t, size_t>>{
+           {0, 1000}, {3, 70}, {64, 128}, {100, 101}, {500, 999}}) {
+    auto slice = bitmap.Slice(begin, end);
+    std::vector<bool> expected_slice(expected.begin() + begin,
+                                     expected.begin() + end);
+    EXPECT_EQ(ToBools(slice), expected_slice);
+    EXPECT_EQ(slice.Count(), std::count(expected_slice.begin(),
+                                        expected_slice.end(), true));
+
+    // mutation of a slice doesn't touch the source
+    auto copy = slice;
+    copy.Append(bitmap.Slice(7, 300));
+    expected_slice.insert(expected_slice.end(), expected.begin() + 7,
+                          expected.begin() + 300);
+    copy.Set(0, !copy.Get(0));
+    expected_slice[0] = !expected_slice[0];
+    EXPECT_EQ(ToBools(copy), expected_slice);
+    EXPECT_EQ(ToBools(bitmap), expected);
+
+    tskv::Bitmap from_words(copy.ToWords(), copy.Size());
+    EXPECT_EQ(ToBools(from_words), expected_slice);
+  }
+}
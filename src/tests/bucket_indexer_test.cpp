@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <limits>
+#include <random>
+
+#include "model/bucket_indexer.h"
+
+namespace {
+
+void CheckDivide(uint64_t divisor, uint64_t value) {
+  tskv::BucketIndexer indexer(divisor);
+  EXPECT_EQ(indexer.Divide(value), value / divisor)
+      << value << " / " << divisor;
+  EXPECT_EQ(indexer.Mod(value), value % divisor) << value << " % " << divisor;
+}
+
+}  // namespace
+
+TEST(BucketIndexer, Small) {
+  for (uint64_t divisor = 1; divisor < 200; ++divisor) {
+    for (uint64_t value = 0; value < 1000; ++value) {
+      CheckDivide(divisor, value);
+    }
+  }
+}
+
+TEST(BucketIndexer, Edge) {
+  constexpr auto kMax = std::numeric_limits<uint64_t>::max();
+  for (uint64_t divisor : {uint64_t{1}, uint64_t{3}, uint64_t{7},
+                           uint64_t{1} << 63, (uint64_t{1} << 63) + 1,
+                           kMax - 1, kMax}) {
+    for (uint64_t value : {uint64_t{0}, uint64_t{1}, divisor - 1, divisor,
+                           kMax - 1, kMax}) {
+      CheckDivide(divisor, value);
+    }
+  }
+}
+
+TEST(BucketIndexer, Random) {
+  std::mt19937_64 gen(42);
+  for (int i = 0; i < 10000; ++i) {
+    auto divisor = gen() >> (gen() % 64);
+    if (divisor == 0) {
+      continue;
+    }
+    CheckDivide(divisor, gen());
+    CheckDivide(divisor, gen() >> (gen() % 64));
+  }
+}
+
+TEST(BucketIndexer, Buckets) {
+  // 1 second buckets on nanosecond timestamps
+  tskv::BucketIndexer indexer(1'000'000'000);
+  EXPECT_EQ(indexer.GetBucketInterval(), 1'000'000'000);
+  EXPECT_EQ(indexer.AlignDown(1'700'000'000'123'456'789),
+            1'700'000'000'000'000'000);
+  EXPECT_EQ(indexer.GetBucketIdx(1'700'000'000'000'000'000,
+                                 1'700'000'005'999'999'999),
+            5);
+}
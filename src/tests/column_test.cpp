@@ -256,7 +256,7 @@ TEST(SumColumn, ScaleBuckets) {
 }
 
 TEST(CountColumn, Basic) {
-  tskv::CountColumn column(std::vector<double>{1, 2, 3, 4, 5},
+  tskv::CountColumn column(std::vector<uint64_t>{1, 2, 3, 4, 5},
                            tskv::TimePoint(1), 1);
   EXPECT_EQ(column.GetType(), tskv::ColumnType::kCount);
   auto expected = std::vector<double>{1, 2, 3, 4, 5};
@@ -303,7 +303,7 @@ TEST(CountColumn, Write) {
 
 TEST(CountColumn, Read) {
   {
-    tskv::CountColumn column(std::vector<double>{1, 2, 3, 4, 5},
+    tskv::CountColumn column(std::vector<uint64_t>{1, 2, 3, 4, 5},
                              tskv::TimePoint(1), 1);
     auto expected = std::vector<double>{1, 2, 3, 4, 5};
     EXPECT_EQ(column.Read(tskv::TimeRange(1, 6))->GetValues(), expected);
@@ -334,7 +334,7 @@ TEST(CountColumn, Read) {
               tskv::ColumnType::kCount);
   }
   {
-    tskv::CountColumn column(std::vector<double>{1, 2, 3, 4, 5},
+    tskv::CountColumn column(std::vector<uint64_t>{1, 2, 3, 4, 5},
                              tskv::TimePoint(2), 2);
     auto expected = std::vector<double>{1, 2, 3, 4, 5};
     EXPECT_EQ(column.Read(tskv::TimeRange(2, 12))->GetValues(), expected);
@@ -365,10 +365,10 @@ TEST(CountColumn, Read) {
 
 TEST(CountColumn, Merge) {
   {
-    tskv::CountColumn column1(std::vector<double>{1, 2, 3, 4, 5},
+    tskv::CountColumn column1(std::vector<uint64_t>{1, 2, 3, 4, 5},
                               tskv::TimePoint(1), 1);
-    tskv::CountColumn column2(std::vector<double>{5, 4, 3}, tskv::TimePoint(3),
-                              1);
+    tskv::CountColumn column2(std::vector<uint64_t>{5, 4, 3},
+                              tskv::TimePoint(3), 1);
     std::shared_ptr<tskv::IReadColumn> column2_read =
         std::make_shared<tskv::CountColumn>(column2);
     column1.Merge(column2_read);
@@ -377,9 +377,9 @@ TEST(CountColumn, Merge) {
     EXPECT_EQ(column1.GetTimeRange(), tskv::TimeRange(1, 6));
   }
   {
-    tskv::CountColumn column1(std::vector<double>{1, 2, 3}, tskv::TimePoint(3),
-                              3);
-    tskv::CountColumn column2(std::vector<double>{10, 20}, tskv::TimePoint(9),
+    tskv::CountColumn column1(std::vector<uint64_t>{1, 2, 3},
+                              tskv::TimePoint(3), 3);
+    tskv::CountColumn column2(std::vector<uint64_t>{10, 20}, tskv::TimePoint(9),
                               3);
     std::shared_ptr<tskv::IReadColumn> column2_read =
         std::make_shared<tskv::CountColumn>(column2);
@@ -391,7 +391,7 @@ TEST(CountColumn, Merge) {
 }
 
 TEST(CountColumn, Extract) {
-  tskv::CountColumn column(std::vector<double>{1, 2, 3, 4, 5},
+  tskv::CountColumn column(std::vector<uint64_t>{1, 2, 3, 4, 5},
                            tskv::TimePoint(5), 5);
   auto result = std::static_pointer_cast<tskv::IReadColumn>(column.Extract());
   auto expected = std::vector<double>{1, 2, 3, 4, 5};
@@ -403,7 +403,7 @@ TEST(CountColumn, Extract) {
 }
 
 TEST(CountColumn, ToBytes) {
-  tskv::CountColumn column(std::vector<double>{1, 2, 3, 4, 5},
+  tskv::CountColumn column(std::vector<uint64_t>{1, 2, 3, 4, 5},
                            tskv::TimePoint(45), 15);
   auto bytes = column.ToBytes();
   auto expected = std::vector<uint8_t>{
@@ -426,9 +426,59 @@ TEST(CountColumn, FromBytes) {
   EXPECT_EQ(count_column->GetTimeRange(), tskv::TimeRange(45, 120));
 }
 
+TEST(CountColumn, BitPackedBytes) {
+  std::vector<uint64_t> counts;
+  for (int i = 0; i < 1000; ++i) {
+    counts.push_back(100 + i % 7);
+  }
+  auto check = [](const tskv::CountColumn& column) {
+    auto bytes = column.ToBytes();
+    auto result = std::static_pointer_cast<tskv::CountColumn>(
+        std::static_pointer_cast<tskv::IReadColumn>(
+            tskv::FromBytes(bytes, tskv::ColumnType::kCount)));
+    EXPECT_EQ(result->GetValues(), column.GetValues());
+    EXPECT_EQ(result->GetTimeRange(), column.GetTimeRange());
+    EXPECT_EQ(result->GetPresence().ToWords(),
+              column.GetPresence().ToWords());
+    EXPECT_EQ(result->ToBytes(), bytes);
+    return bytes;
+  };
+
+  tskv::CountColumn dense(counts, 0, 10);
+  // 3 bits per bucket instead of 64
+  EXPECT_LT(check(dense).size() * 16, counts.size() * sizeof(double));
+
+  tskv::CountColumn sparse(10);
+  sparse.Write({{0, 1}, {0, 1}, {30, 1}});
+  sparse.Write({{100000, 1}});
+  EXPECT_TRUE(sparse.IsSparse());
+  check(sparse);
+}
+
+TEST(CountColumn, IntegerBuckets) {
+  tskv::CountColumn column(1);
+  tskv::InputTimeSeries time_series;
+  for (tskv::TimePoint timestamp = 0; timestamp < 100; ++timestamp) {
+    time_series.push_back({timestamp, 0.5});
+  }
+  column.Write(time_series);
+  auto other = std::make_shared<tskv::CountColumn>(
+      std::vector<uint64_t>(10, uint64_t{1} << 60), tskv::TimePoint(90), 1);
+  column.Merge(std::static_pointer_cast<tskv::IReadColumn>(other));
+  column.ScaleBuckets(50);
+
+  // counts above 2^53 are exact, they would be rounded as doubles
+  auto expected = std::vector<uint64_t>{50, 50 + 10 * (uint64_t{1} << 60)};
+  EXPECT_EQ(column.GetRuns().front().buckets.ToVector(), expected);
+  auto bytes = std::static_pointer_cast<tskv::CountColumn>(
+      std::static_pointer_cast<tskv::IReadColumn>(
+          tskv::FromBytes(column.ToBytes(), tskv::ColumnType::kCount)));
+  EXPECT_EQ(bytes->GetRuns().front().buckets.ToVector(), expected);
+}
+
 TEST(CountColumn, ScaleBuckets) {
   {
-    tskv::CountColumn column(std::vector<double>{1, 2, 3, 4, 5},
+    tskv::CountColumn column(std::vector<uint64_t>{1, 2, 3, 4, 5},
                              tskv::TimePoint(1), 1);
     column.ScaleBuckets(2);
     EXPECT_EQ(column.GetType(), tskv::ColumnType::kCount);
@@ -437,8 +487,9 @@ TEST(CountColumn, ScaleBuckets) {
     EXPECT_EQ(column.GetValues(), expected);
   }
   {
-    tskv::CountColumn column(std::vector<double>{1, 4, 2, 3, 9, 15, 0, 1, 8, 5},
-                             tskv::TimePoint(2), 2);
+    tskv::CountColumn column(
+        std::vector<uint64_t>{1, 4, 2, 3, 9, 15, 0, 1, 8, 5},
+        tskv::TimePoint(2), 2);
     column.ScaleBuckets(2);
     EXPECT_EQ(column.GetType(), tskv::ColumnType::kCount);
     EXPECT_EQ(column.GetTimeRange(), tskv::TimeRange(2, 22));
@@ -446,8 +497,9 @@ TEST(CountColumn, ScaleBuckets) {
     EXPECT_EQ(column.GetValues(), expected);
   }
   {
-    tskv::CountColumn column(std::vector<double>{1, 4, 2, 3, 9, 15, 0, 1, 8, 5},
-                             tskv::TimePoint(2), 2);
+    tskv::CountColumn column(
+        std::vector<uint64_t>{1, 4, 2, 3, 9, 15, 0, 1, 8, 5},
+        tskv::TimePoint(2), 2);
     column.ScaleBuckets(6);
     EXPECT_EQ(column.GetType(), tskv::ColumnType::kCount);
     EXPECT_EQ(column.GetTimeRange(), tskv::TimeRange(0, 24));
@@ -455,7 +507,7 @@ TEST(CountColumn, ScaleBuckets) {
     EXPECT_EQ(column.GetValues(), expected);
   }
   {
-    tskv::CountColumn column(std::vector<double>{1, 4, 2, 3, 9, 15, 0, 1, 8},
+    tskv::CountColumn column(std::vector<uint64_t>{1, 4, 2, 3, 9, 15, 0, 1, 8},
                              tskv::TimePoint(0), 2);
     column.ScaleBuckets(4);
     EXPECT_EQ(column.GetType(), tskv::ColumnType::kCount);
@@ -464,7 +516,7 @@ TEST(CountColumn, ScaleBuckets) {
     EXPECT_EQ(column.GetValues(), expected);
   }
   {
-    tskv::CountColumn column(std::vector<double>{0, 0, 0}, tskv::TimePoint(0),
+    tskv::CountColumn column(std::vector<uint64_t>{0, 0, 0}, tskv::TimePoint(0),
                              1);
     column.ScaleBuckets(2);
     EXPECT_EQ(column.GetType(), tskv::ColumnType::kCount);
@@ -1383,7 +1435,7 @@ TEST(AvgColumn, Basic) {
     auto sum_column = std::make_shared<tskv::SumColumn>(
         std::vector<double>{1, 2, 3, 4, 5}, tskv::TimePoint(1), 1);
     auto count_column = std::make_shared<tskv::CountColumn>(
-        std::vector<double>{2, 2, 1, 2, 1}, tskv::TimePoint(1), 1);
+        std::vector<uint64_t>{2, 2, 1, 2, 1}, tskv::TimePoint(1), 1);
     tskv::AvgColumn column(sum_column, count_column);
     EXPECT_EQ(column.GetType(), tskv::ColumnType::kAvg);
     auto expected = std::vector<double>{0.5, 1, 3, 2, 5};
@@ -1453,3 +1505,279 @@ TEST(AvgColumn, Read) {
               tskv::ColumnType::kAvg);
   }
 }
+
+TEST(WriteColumns, Basic) {
+  auto types = {tskv::ColumnType::kSum, tskv::ColumnType::kCount,
+                tskv::ColumnType::kMin, tskv::ColumnType::kMax,
+                tskv::ColumnType::kLast};
+  tskv::Columns fused;
+  tskv::Columns expected;
+  for (auto type : types) {
+    fused.push_back(tskv::CreateAggregatedColumn(type, 3));
+    expected.push_back(tskv::CreateAggregatedColumn(type, 3));
+  }
+  for (auto type :
+       {tskv::ColumnType::kRawTimestamps, tskv::ColumnType::kRawValues}) {
+    fused.push_back(tskv::CreateRawColumn(type));
+    expected.push_back(tskv::CreateRawColumn(type));
+  }
+  // column with different bucket interval is written separately
+  fused.push_back(tskv::CreateAggregatedColumn(tskv::ColumnType::kSum, 5));
+  expected.push_back(tskv::CreateAggregatedColumn(tskv::ColumnType::kSum, 5));
+
+  std::vector<tskv::InputTimeSeries> batches = {
+      {{4, 1}, {5, 2}, {5, -3}, {9, 4}, {17, 5}},
+      {{17, 1}, {18, 7}, {30, -1}},
+      {{31, 2}}};
+  for (const auto& batch : batches) {
+    tskv::WriteColumns(fused, batch);
+    for (auto& column : expected) {
+      column->Write(batch);
+    }
+  }
+  for (size_t i = 0; i < fused.size(); ++i) {
+    EXPECT_EQ(fused[i]->GetValues(), expected[i]->GetValues());
+  }
+  EXPECT_EQ(fused[0]->GetValues(),
+            (std::vector<double>{0, 0, 4, 0, 6, 7, 0, 0, 0, 1}));
+}
+
+TEST(SparseColumn, Write) {
+  // one record per 100 buckets, every record is written separately, so
+  // gaps are not stored
+  tskv::InputTimeSeries time_series;
+  for (uint64_t i = 0; i < 50; ++i) {
+    time_series.push_back({1000 + i * 1000 + i % 7, static_cast<double>(i)});
+  }
+  tskv::MaxColumn sparse(10);
+  for (const auto& record : time_series) {
+    sparse.Write({record});
+  }
+  tskv::MaxColumn dense(10);
+  dense.Write(time_series);
+
+  EXPECT_TRUE(sparse.IsSparse());
+  EXPECT_FALSE(dense.IsSparse());
+  EXPECT_EQ(sparse.GetRuns().size(), 50);
+  EXPECT_EQ(sparse.GetStoredBucketsNum(), 50);
+  EXPECT_EQ(sparse.GetBucketsNum(), dense.GetBucketsNum());
+  EXPECT_EQ(sparse.GetTimeRange(), dense.GetTimeRange());
+  EXPECT_EQ(sparse.GetValues(), dense.GetValues());
+
+  for (auto [start, end] : std::vector<std::pair<uint64_t, uint64_t>>{
+           {0, 100'000}, {1000, 1010}, {2500, 5010}, {1005, 49'001}}) {
+    auto sparse_read = sparse.Read(tskv::TimeRange(start, end));
+    auto dense_read = dense.Read(tskv::TimeRange(start, end));
+    EXPECT_EQ(sparse_read->GetTimeRange().end, dense_read->GetTimeRange().end);
+    auto sparse_values = sparse_read->GetValues();
+    auto dense_values = dense_read->GetValues();
+    // reads starting in a gap start from the first stored bucket
+    dense_values.erase(dense_values.begin(),
+                       dense_values.end() - sparse_values.size());
+    EXPECT_EQ(sparse_values, dense_values);
+  }
+  EXPECT_FALSE(sparse.Read(tskv::TimeRange(1100, 1900)));
+
+  // short gaps are filled
+  tskv::SumColumn column(10);
+  column.Write({{0, 1}});
+  column.Write({{100, 1}});
+  EXPECT_FALSE(column.IsSparse());
+  EXPECT_EQ(column.GetStoredBucketsNum(), 11);
+}
+
+TEST(SparseColumn, Merge) {
+  std::vector<tskv::InputTimeSeries> batches = {
+      {{0, 1}, {5, 2}},   {{1000, 3}},  {{5000, 4}, {5001, 5}},
+      {{5002, 6}},        {{9000, 7}},  {{20000, 8}}};
+  auto write = [](tskv::SumColumn& column,
+                  const std::vector<tskv::InputTimeSeries>& batches) {
+    for (const auto& batch : batches) {
+      column.Write(batch);
+    }
+  };
+  tskv::SumColumn first(10);
+  write(first, {batches.begin(), batches.begin() + 3});
+  tskv::SumColumn second(10);
+  write(second, {batches.begin() + 3, batches.end()});
+
+  // dense reference
+  tskv::InputTimeSeries all;
+  for (const auto& batch : batches) {
+    all.insert(all.end(), batch.begin(), batch.end());
+  }
+  tskv::SumColumn expected(10);
+  expected.Write(all);
+
+  auto as_column = [](const tskv::SumColumn& column) {
+    std::shared_ptr<tskv::IReadColumn> res =
+        std::make_shared<tskv::SumColumn>(column);
+    return res;
+  };
+  auto merged = std::make_shared<tskv::SumColumn>(10);
+  merged->Merge(as_column(first));
+  merged->Merge(as_column(second));
+  EXPECT_TRUE(merged->IsSparse());
+  EXPECT_EQ(merged->GetRuns().size(), 5);
+  EXPECT_EQ(merged->GetValues(), expected.GetValues());
+  EXPECT_EQ(merged->GetTimeRange(), expected.GetTimeRange());
+
+  // merge into a gap
+  tskv::SumColumn gap(10);
+  gap.Write({{3000, 10}, {3010, 20}});
+  merged->Merge(as_column(gap));
+  expected.Write({{3000, 10}, {3010, 20}});
+  EXPECT_EQ(merged->GetValues(), expected.GetValues());
+
+  // merge overlapping the last run
+  tskv::SumColumn overlap(10);
+  overlap.Write({{20000, 1}, {20030, 2}});
+  merged->Merge(as_column(overlap));
+  expected.Write({{20000, 1}, {20030, 2}});
+  EXPECT_EQ(merged->GetValues(), expected.GetValues());
+}
+
+TEST(SparseColumn, ScaleBuckets) {
+  tskv::InputTimeSeries all;
+  tskv::MinColumn sparse(10);
+  for (uint64_t i = 0; i < 20; ++i) {
+    tskv::Record record{i * i * 100 + 50, static_cast<double>(i % 5)};
+    sparse.Write({record});
+    all.push_back(record);
+  }
+  tskv::MinColumn dense(10);
+  dense.Write(all);
+  EXPECT_TRUE(sparse.IsSparse());
+  for (uint64_t bucket_interval : {20, 100, 1000, 10000}) {
+    sparse.ScaleBuckets(bucket_interval);
+    dense.ScaleBuckets(bucket_interval);
+    EXPECT_EQ(sparse.GetValues(), dense.GetValues());
+    EXPECT_EQ(sparse.GetTimeRange(), dense.GetTimeRange());
+  }
+  EXPECT_FALSE(sparse.IsSparse());
+}
+
+TEST(SparseColumn, ToBytes) {
+  tskv::LastColumn column(10);
+  column.Write({{100, 1}, {110, 2}});
+  column.Write({{10000, 3}});
+  column.Write({{30000, 4}, {30020, 5}});
+  EXPECT_TRUE(column.IsSparse());
+  auto bytes = column.ToBytes();
+  EXPECT_NE(bytes.size() % sizeof(double), 0);
+  auto result = std::static_pointer_cast<tskv::LastColumn>(
+      std::static_pointer_cast<tskv::IReadColumn>(
+          tskv::FromBytes(bytes, tskv::ColumnType::kLast)));
+  EXPECT_TRUE(result->IsSparse());
+  EXPECT_EQ(result->GetRuns().size(), 3);
+  EXPECT_EQ(result->GetValues(), column.GetValues());
+  EXPECT_EQ(result->GetTimeRange(), column.GetTimeRange());
+  EXPECT_EQ(result->ToBytes(), bytes);
+}
+
+TEST(SparseColumn, Avg) {
+  auto sum = std::make_shared<tskv::SumColumn>(10);
+  auto count = std::make_shared<tskv::CountColumn>(10);
+  for (auto batch : std::vector<tskv::InputTimeSeries>{
+           {{0, 2}, {1, 4}}, {{1000, 3}}, {{5000, 5}, {5010, 1}}}) {
+    sum->Write(batch);
+    count->Write(batch);
+  }
+  tskv::AvgColumn avg(sum, count);
+  auto expected = std::vector<double>(502, 0);
+  expected[0] = 3;
+  expected[100] = 3;
+  expected[500] = 5;
+  expected[501] = 1;
+  EXPECT_EQ(avg.GetValues(), expected);
+  EXPECT_EQ(avg.Read(tskv::TimeRange(1000, 5001))->GetValues(),
+            std::vector<double>(expected.begin() + 100, expected.end() - 1));
+}
+
+TEST(PresenceColumn, Write) {
+  tskv::LastColumn column(10);
+  column.Write({{0, 1}, {30, 0}});
+  column.Write({{2000, 3}});
+  EXPECT_TRUE(column.IsSparse());
+  auto presence = column.GetPresence();
+  EXPECT_EQ(presence.Size(), column.GetBucketsNum());
+  EXPECT_EQ(presence.Count(), 3);
+  EXPECT_TRUE(column.IsPresent(0));
+  EXPECT_FALSE(column.IsPresent(1));
+  EXPECT_TRUE(column.IsPresent(3));
+  EXPECT_FALSE(column.IsPresent(100));
+  EXPECT_TRUE(column.IsPresent(200));
+
+  // columns made of plain buckets have every bucket present
+  tskv::SumColumn plain(std::vector<double>{0, 0, 1}, 0, 10);
+  EXPECT_TRUE(plain.GetPresence().All());
+}
+
+TEST(PresenceColumn, Merge) {
+  auto as_column = [](const tskv::LastColumn& column) {
+    std::shared_ptr<tskv::IReadColumn> res =
+        std::make_shared<tskv::LastColumn>(column);
+    return res;
+  };
+  tskv::LastColumn first(10);
+  first.Write({{0, 1}, {10, 2}, {20, 3}});
+  tskv::LastColumn second(10);
+  // bucket [10, 20) is absent, it must not overwrite value of first column
+  second.Write({{0, 4}, {20, 0}});
+  first.Merge(as_column(second));
+  EXPECT_EQ(first.GetValues(), std::vector<double>({4, 2, 0}));
+  EXPECT_TRUE(first.GetPresence().All());
+}
+
+TEST(PresenceColumn, ScaleBuckets) {
+  tskv::LastColumn column(10);
+  column.Write({{0, 1}, {10, 2}, {20, 3}, {30, 4}, {40, 5}, {100, 6}});
+  column.Write({{210, 7}, {230, 8}});
+  column.ScaleBuckets(40);
+  // last of [40, 80) is 5, not the identity of empty buckets after it
+  EXPECT_EQ(column.GetValues(), std::vector<double>({4, 5, 6, 0, 0, 8}));
+  auto presence = column.GetPresence();
+  EXPECT_EQ(presence.Size(), 6);
+  EXPECT_EQ(presence.Count(), 4);
+  EXPECT_FALSE(column.IsPresent(3));
+  EXPECT_FALSE(column.IsPresent(4));
+}
+
+TEST(PresenceColumn, ToBytes) {
+  tskv::MaxColumn column(10);
+  column.Write({{0, 1}, {30, 2}});
+  auto bytes = column.ToBytes();
+  EXPECT_NE(bytes.size() % sizeof(double), 0);
+  auto result = std::static_pointer_cast<tskv::MaxColumn>(
+      std::static_pointer_cast<tskv::IReadColumn>(
+          tskv::FromBytes(bytes, tskv::ColumnType::kMax)));
+  EXPECT_EQ(result->GetValues(), column.GetValues());
+  EXPECT_FALSE(result->IsPresent(1));
+  EXPECT_TRUE(result->IsPresent(3));
+  EXPECT_EQ(result->ToBytes(), bytes);
+
+  // fully present columns keep the plain format
+  tskv::MaxColumn full(10);
+  full.Write({{0, 1}, {10, 2}});
+  EXPECT_EQ(full.ToBytes().size() % sizeof(double), 0);
+}
+
+TEST(MergeUnordered, Basic) {
+  std::shared_ptr<tskv::IReadColumn> newer =
+      std::make_shared<tskv::SumColumn>(std::vector<double>{1, 2}, 20, 10);
+  std::shared_ptr<tskv::IReadColumn> older =
+      std::make_shared<tskv::SumColumn>(std::vector<double>{3, 4}, 10, 10);
+  auto merged = tskv::MergeUnordered(newer, older);
+  EXPECT_EQ(merged->GetValues(), std::vector<double>({3, 5, 2}));
+
+  auto raw = [](const tskv::InputTimeSeries& records) {
+    auto column = std::make_shared<tskv::ReadRawColumn>();
+    column->Write(records);
+    return std::static_pointer_cast<tskv::IReadColumn>(column);
+  };
+  auto merged_raw =
+      tskv::MergeUnordered(raw({{5, 1}, {9, 2}}), raw({{1, 3}, {7, 4}}));
+  EXPECT_EQ(merged_raw->GetValues(), std::vector<double>({3, 1, 4, 2}));
+  EXPECT_EQ(merged_raw->GetTimeRange(), tskv::TimeRange(1, 10));
+  EXPECT_EQ(tskv::MergeUnordered(nullptr, older), older);
+}
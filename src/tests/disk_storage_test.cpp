@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "model/column.h"
+#include "persistent-storage/disk_storage.h"
+#include "persistent-storage/io_ring.h"
+
+namespace {
+
+std::string MakeTempDir(const std::string& name) {
+  auto path = std::filesystem::temp_directory_path() / name;
+  std::filesystem::remove_all(path);
+  return path;
+}
+
+// copies of the viewed pages, so that they can be compared
+std::vector<tskv::CompressedBytes> ToBytes(
+    const std::vector<tskv::PageView>& page_views) {
+  std::vector<tskv::CompressedBytes> pages;
+  for (const auto& page_view : page_views) {
+    pages.emplace_back(page_view.bytes.begin(), page_view.bytes.end());
+  }
+  return pages;
+}
+
+}  // namespace
+
+TEST(DiskStorage, ReadWrite) {
+  auto path = MakeTempDir("tskv_disk_storage_test");
+  tskv::DiskStorage storage({.path = path});
+  auto page_id = storage.CreatePage();
+  tskv::CompressedBytes bytes{1, 2, 3, 4, 5};
+  storage.Write(page_id, bytes);
+  storage.Sync();
+  EXPECT_EQ(storage.Read(page_id), bytes);
+
+  auto page_view = storage.ReadView(page_id);
+  EXPECT_EQ(tskv::CompressedBytes(page_view.bytes.begin(),
+                                  page_view.bytes.end()),
+            bytes);
+  EXPECT_EQ(storage.ReadRange(page_id, 1, 3), tskv::CompressedBytes({2, 3, 4}));
+  EXPECT_THROW(storage.ReadRange(page_id, 3, 3), std::runtime_error);
+  storage.DeletePage(page_id);
+  storage.Sync();
+  EXPECT_THROW(storage.Read(page_id), std::runtime_error);
+  std::filesystem::remove_all(path);
+}
+
+TEST(DiskStorage, MappedReads) {
+  auto path = MakeTempDir("tskv_disk_storage_mmap_test");
+  tskv::DiskStorage storage({.path = path, .mmap_reads = true});
+  auto column = std::make_shared<tskv::SumColumn>(
+      std::vector<double>{1, 2, 3}, tskv::TimePoint(10), 5);
+  auto page_id = storage.CreatePage();
+  storage.Write(page_id, column->ToBytes());
+
+  auto page_view = storage.ReadView(page_id);
+  // mapping outlives the page file
+  storage.DeletePage(page_id);
+  auto read_column = tskv::FromBytes(page_view.bytes, tskv::ColumnType::kSum);
+  EXPECT_EQ(read_column->GetValues(), std::vector<double>({1, 2, 3}));
+
+  auto empty_page_id = storage.CreatePage();
+  EXPECT_TRUE(storage.ReadView(empty_page_id).bytes.empty());
+  EXPECT_THROW(storage.ReadView(page_id), std::runtime_error);
+  std::filesystem::remove_all(path);
+}
+
+TEST(DiskStorage, ReadWriteMany) {
+  auto path = MakeTempDir("tskv_disk_storage_many_test");
+  tskv::DiskStorage storage(
+      {.path = path, .io_ring = std::make_shared<tskv::IoRing>(2)});
+  std::vector<tskv::PageId> page_ids;
+  std::vector<tskv::CompressedBytes> pages;
+  for (uint8_t i = 0; i < 5; ++i) {
+    page_ids.push_back(storage.CreatePage());
+    pages.push_back(tskv::CompressedBytes(i, i));
+  }
+  storage.WriteMany(page_ids, pages);
+  EXPECT_EQ(ToBytes(storage.ReadMany(page_ids)), pages);
+  EXPECT_EQ(storage.Read(page_ids[3]), pages[3]);
+
+  storage.DeletePage(page_ids[3]);
+  EXPECT_THROW(storage.ReadMany(page_ids), std::runtime_error);
+  page_ids.erase(page_ids.begin() + 3);
+  pages.erase(pages.begin() + 3);
+
+  // mapped pages are not copied into batches
+  tskv::DiskStorage mapped_storage({
+      .path = path,
+      .mmap_reads = true,
+      .io_ring = std::make_shared<tskv::IoRing>(2),
+  });
+  EXPECT_EQ(ToBytes(mapped_storage.ReadMany(page_ids)), pages);
+  std::filesystem::remove_all(path);
+}
@@ -0,0 +1,170 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "model/column.h"
+#include "model/encoding.h"
+#include "model/model.h"
+
+TEST(BitWriter, ReadWrite) {
+  tskv::CompressedBytes bytes;
+  tskv::BitWriter writer(bytes);
+  writer.WriteBit(true);
+  writer.Write(5, 3);
+  writer.Write(0xdeadbeefcafebabe, 64);
+  writer.Write(0, 7);
+  writer.Write(1, 1);
+  writer.Flush();
+  EXPECT_EQ(bytes.size(), 10);
+
+  tskv::BitReader reader(bytes.data(), bytes.size());
+  EXPECT_TRUE(reader.ReadBit());
+  EXPECT_EQ(reader.Read(3), 5);
+  EXPECT_EQ(reader.Read(64), 0xdeadbeefcafebabe);
+  EXPECT_EQ(reader.Read(7), 0);
+  EXPECT_EQ(reader.Read(1), 1);
+}
+
+TEST(Gorilla, RoundTrip) {
+  std::vector<double> values = {
+      1,
+      1,
+      1.5,
+      -2,
+      0,
+      -0.0,
+      std::numeric_limits<double>::max(),
+      std::numeric_limits<double>::lowest(),
+      std::numeric_limits<double>::infinity(),
+      std::numeric_limits<double>::denorm_min(),
+      12.25,
+      12.25,
+      12.5,
+  };
+  std::mt19937_64 gen(42);
+  std::uniform_real_distribution<double> dis(-1e6, 1e6);
+  for (int i = 0; i < 1000; ++i) {
+    values.push_back(dis(gen));
+  }
+
+  auto bytes = tskv::EncodeRawValues(values, tskv::RawValuesEncoding::kGorilla);
+  EXPECT_NE(bytes.size() % sizeof(double), 0);
+  auto decoded = tskv::DecodeRawValues(bytes);
+  ASSERT_EQ(decoded.size(), values.size());
+  for (size_t i = 0; i < values.size(); ++i) {
+    EXPECT_EQ(std::bit_cast<uint64_t>(decoded[i]),
+              std::bit_cast<uint64_t>(values[i]));
+  }
+}
+
+TEST(Gorilla, NaN) {
+  std::vector<double> values = {1, std::numeric_limits<double>::quiet_NaN(), 2};
+  auto decoded = tskv::DecodeRawValues(
+      tskv::EncodeRawValues(values, tskv::RawValuesEncoding::kGorilla));
+  ASSERT_EQ(decoded.size(), 3);
+  EXPECT_EQ(decoded[0], 1);
+  EXPECT_TRUE(std::isnan(decoded[1]));
+  EXPECT_EQ(decoded[2], 2);
+}
+
+TEST(Gorilla, Empty) {
+  auto bytes = tskv::EncodeRawValues({}, tskv::RawValuesEncoding::kGorilla);
+  EXPECT_TRUE(tskv::DecodeRawValues(bytes).empty());
+}
+
+TEST(Gorilla, Compression) {
+  std::vector<double> values;
+  for (int i = 0; i < 3600; ++i) {
+    values.push_back(50 + (i % 60 == 0 ? 1 : 0));
+  }
+  auto bytes = tskv::EncodeRawValues(values, tskv::RawValuesEncoding::kGorilla);
+  EXPECT_LT(bytes.size() * 8, values.size() * sizeof(double));
+  EXPECT_EQ(tskv::DecodeRawValues(bytes), values);
+}
+
+TEST(Gorilla, RawValuesColumn) {
+  tskv::RawValuesColumn column(std::vector<double>{1, 2, 3, 4, 5});
+  auto plain = column.ToBytes(tskv::RawValuesEncoding::kPlain);
+  EXPECT_EQ(plain, column.ToBytes());
+
+  auto bytes = column.ToBytes(tskv::RawValuesEncoding::kGorilla);
+  auto result = tskv::FromBytes(bytes, tskv::ColumnType::kRawValues);
+  auto expected = std::vector<double>{1, 2, 3, 4, 5};
+  EXPECT_EQ(result->GetValues(), expected);
+  EXPECT_EQ(result->GetType(), tskv::ColumnType::kRawValues);
+}
+
+TEST(DeltaOfDelta, RoundTrip) {
+  std::vector<uint64_t> timestamps = {0, 0, 1, 1000, 1000, 1001, 1500, 1500};
+  std::mt19937_64 gen(42);
+  std::uniform_int_distribution<uint64_t> dis(0, 1ull << 40);
+  auto last = timestamps.back();
+  for (int i = 0; i < 1000; ++i) {
+    auto step = i % 3 == 0 ? dis(gen) : i % 100;
+    last += step;
+    timestamps.push_back(last);
+  }
+  timestamps.push_back(std::numeric_limits<uint64_t>::max());
+
+  auto bytes = tskv::EncodeRawTimestamps(
+      timestamps, tskv::RawTimestampsEncoding::kDeltaOfDelta);
+  EXPECT_NE(bytes.size() % sizeof(uint64_t), 0);
+  std::vector<uint64_t> decoded;
+  tskv::DecodeRawTimestamps(bytes, decoded);
+  EXPECT_EQ(decoded, timestamps);
+}
+
+TEST(DeltaOfDelta, Regular) {
+  std::vector<uint64_t> timestamps;
+  for (uint64_t i = 0; i < 86400; ++i) {
+    timestamps.push_back(1'451'606'400'000'000 + i * 1'000'000);
+  }
+  timestamps.push_back(timestamps.back() + 999'999);
+  timestamps.push_back(timestamps.back() + 1'000'000);
+
+  auto bytes = tskv::EncodeRawTimestamps(
+      timestamps, tskv::RawTimestampsEncoding::kDeltaOfDelta);
+  EXPECT_LT(bytes.size() * 50, timestamps.size() * sizeof(uint64_t));
+  std::vector<uint64_t> decoded = {1, 2};
+  tskv::DecodeRawTimestamps(bytes, decoded);
+  ASSERT_EQ(decoded.size(), timestamps.size() + 2);
+  EXPECT_TRUE(std::equal(timestamps.begin(), timestamps.end(),
+                         decoded.begin() + 2));
+}
+
+TEST(BitPack, RoundTrip) {
+  for (auto max : {0ull, 1ull, 1000ull, ~0ull}) {
+    std::vector<uint64_t> values;
+    std::mt19937_64 gen(42);
+    std::uniform_int_distribution<uint64_t> dis(0, max);
+    for (int i = 0; i < 1000; ++i) {
+      values.push_back(dis(gen));
+    }
+    tskv::CompressedBytes bytes;
+    tskv::BitWriter writer(bytes);
+    tskv::BitPackEncode(values, writer);
+    writer.Flush();
+    EXPECT_LE(bytes.size(), 9 + (std::bit_width(max) * values.size() + 7) / 8);
+    tskv::BitReader reader(bytes.data(), bytes.size());
+    std::vector<uint64_t> decoded;
+    tskv::BitPackDecode(reader, values.size(), decoded);
+    EXPECT_EQ(decoded, values);
+  }
+}
+
+TEST(DeltaOfDelta, RawTimestampsColumn) {
+  tskv::RawTimestampsColumn column(std::vector<uint64_t>{1, 2, 3, 4, 5});
+  EXPECT_EQ(column.ToBytes(tskv::RawTimestampsEncoding::kPlain),
+            column.ToBytes());
+
+  auto bytes = column.ToBytes(tskv::RawTimestampsEncoding::kDeltaOfDelta);
+  auto result = tskv::FromBytes(bytes, tskv::ColumnType::kRawTimestamps);
+  auto expected = std::vector<double>{1, 2, 3, 4, 5};
+  EXPECT_EQ(result->GetValues(), expected);
+  auto raw_column = std::static_pointer_cast<tskv::RawTimestampsColumn>(result);
+  EXPECT_EQ(raw_column->GetTimeRange(), tskv::TimeRange(1, 6));
+}
@@ -0,0 +1,53 @@
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <filesystem>
+#include <stdexcept>
+#include <vector>
+
+#include "model/column.h"
+#include "persistent-storage/io_ring.h"
+
+TEST(IoRing, ReadWrite) {
+  auto path = std::filesystem::temp_directory_path() / "tskv_io_ring_test";
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  ASSERT_NE(fd, -1);
+
+  // batches larger than the queue are split
+  tskv::IoRing io_ring(4);
+  std::vector<tskv::CompressedBytes> blocks;
+  std::vector<tskv::IoRing::Request> requests;
+  for (uint8_t i = 0; i < 10; ++i) {
+    blocks.push_back(tskv::CompressedBytes(100, i));
+  }
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    requests.push_back(tskv::IoRing::Request::Write(fd, blocks[i].data(),
+                                                    blocks[i].size(), i * 100));
+  }
+  io_ring.Run(requests);
+  EXPECT_EQ(std::filesystem::file_size(path), 1000);
+
+  std::vector<tskv::CompressedBytes> read_blocks(10,
+                                                 tskv::CompressedBytes(50));
+  requests.clear();
+  for (size_t i = 0; i < read_blocks.size(); ++i) {
+    requests.push_back(tskv::IoRing::Request::Read(
+        fd, read_blocks[i].data(), read_blocks[i].size(), i * 100 + 25));
+  }
+  io_ring.Run(requests);
+  for (uint8_t i = 0; i < 10; ++i) {
+    EXPECT_EQ(read_blocks[i], tskv::CompressedBytes(50, i));
+  }
+
+  // reads after the end of the file fail
+  tskv::CompressedBytes bytes(10);
+  std::vector<tskv::IoRing::Request> out_of_file{
+      tskv::IoRing::Request::Read(fd, bytes.data(), bytes.size(), 995)};
+  EXPECT_THROW(io_ring.Run(out_of_file), std::runtime_error);
+  close(fd);
+  std::filesystem::remove(path);
+}
+
+TEST(IoRing, ZeroQueueDepth) {
+  EXPECT_THROW(tskv::IoRing(0), std::runtime_error);
+}
@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+#include "model/column.h"
+#include "model/kernels.h"
+
+namespace {
+
+template <typename Op, typename Bucket = typename Op::Bucket>
+std::vector<Bucket> ReduceGroupsNaive(const std::vector<Bucket>& data,
+                                      size_t scale) {
+  std::vector<Bucket> res;
+  for (size_t begin = 0; begin + scale <= data.size(); begin += scale) {
+    Bucket acc = Op::kIdentity;
+    for (size_t i = begin; i < begin + scale; ++i) {
+      acc = Op::Combine(acc, data[i]);
+    }
+    res.push_back(acc);
+  }
+  return res;
+}
+
+template <typename Op, typename Bucket = typename Op::Bucket>
+void CheckReduceGroups() {
+  std::mt19937_64 gen(42);
+  std::uniform_int_distribution<int> dis(std::is_signed_v<Bucket> ? -1000 : 0,
+                                         1000);
+  std::vector<Bucket> data(1000);
+  for (auto& value : data) {
+    value = dis(gen);
+  }
+  for (size_t scale : {1, 2, 3, 4, 5, 7, 8, 16, 60, 1000}) {
+    auto expected = ReduceGroupsNaive<Op>(data, scale);
+    std::vector<Bucket> result(data.size() / scale);
+    Op::ReduceGroups(data.data(), result.size(), scale, result.data());
+    EXPECT_EQ(result, expected) << "scale " << scale;
+
+    // in place
+    auto in_place = data;
+    Op::ReduceGroups(in_place.data(), result.size(), scale, in_place.data());
+    in_place.resize(result.size());
+    EXPECT_EQ(in_place, expected) << "scale " << scale;
+  }
+}
+
+}  // namespace
+
+TEST(Kernels, Sum) {
+  CheckReduceGroups<tskv::SumOp>();
+}
+
+TEST(Kernels, Count) {
+  CheckReduceGroups<tskv::CountOp>();
+}
+
+TEST(Kernels, Min) {
+  CheckReduceGroups<tskv::MinOp>();
+}
+
+TEST(Kernels, Max) {
+  CheckReduceGroups<tskv::MaxOp>();
+}
+
+TEST(Kernels, Last) {
+  CheckReduceGroups<tskv::LastOp>();
+}
+
+TEST(Kernels, ScaleBucketsRagged) {
+  std::vector<double> buckets(100);
+  for (size_t i = 0; i < buckets.size(); ++i) {
+    buckets[i] = i;
+  }
+  for (uint64_t start = 0; start < 20; ++start) {
+    tskv::MaxColumn column(buckets, tskv::TimePoint(start), 1);
+    column.ScaleBuckets(8);
+    std::vector<double> expected;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+      if (i == 0 || (start + i) % 8 == 0) {
+        expected.push_back(buckets[i]);
+      } else {
+        expected.back() = std::max(expected.back(), buckets[i]);
+      }
+    }
+    EXPECT_EQ(column.GetValues(), expected) << "start " << start;
+    EXPECT_EQ(column.GetTimeRange(),
+              tskv::TimeRange(start - start % 8, (start + 100 + 7) / 8 * 8));
+  }
+}
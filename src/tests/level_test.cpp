@@ -1,7 +1,11 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <numeric>
+#include <string>
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "level/level.h"
@@ -22,8 +26,40 @@ class MockPersistentStorage : public tskv::IPersistentStorage {
               (const tskv::PageId& page_id, const tskv::CompressedBytes& bytes),
               (override));
   MOCK_METHOD(void, DeletePage, (const tskv::PageId& page_id), (override));
+  MOCK_METHOD(tskv::CompressedBytes, ReadRange,
+              (const tskv::PageId& page_id, size_t offset, size_t size),
+              (override));
 };
 
+namespace {
+
+// makes the mock store pages in `pages`
+void StorePages(MockPersistentStorage& storage,
+                std::map<tskv::PageId, tskv::CompressedBytes>& pages) {
+  ON_CALL(storage, CreatePage).WillByDefault([&] {
+    auto page_id = std::to_string(pages.size());
+    pages[page_id];
+    return page_id;
+  });
+  ON_CALL(storage, Write)
+      .WillByDefault([&](const tskv::PageId& page_id,
+                         const tskv::CompressedBytes& bytes) {
+        pages[page_id] = bytes;
+      });
+  ON_CALL(storage, Read).WillByDefault([&](const tskv::PageId& page_id) {
+    return pages.at(page_id);
+  });
+  ON_CALL(storage, ReadRange)
+      .WillByDefault(
+          [&](const tskv::PageId& page_id, size_t offset, size_t size) {
+            const auto& bytes = pages.at(page_id);
+            return tskv::CompressedBytes(bytes.begin() + offset,
+                                         bytes.begin() + offset + size);
+          });
+}
+
+}  // namespace
+
 TEST(Level, ReadWrite) {
   auto mock_storage = std::make_shared<MockPersistentStorage>();
   tskv::Level level(
@@ -54,4 +90,402 @@ TEST(Level, ReadWrite) {
   EXPECT_EQ(read_column->GetTimeRange(), tskv::TimeRange(45, 120));
 }
 
-// TODO: add MovePagesFrom test
+TEST(Level, TimeRangePruning) {
+  auto mock_storage = std::make_shared<MockPersistentStorage>();
+  tskv::Level level(
+      tskv::Level::Options{
+          .bucket_interval = tskv::Duration::Seconds(40),
+          .level_duration = tskv::Duration::Hours(20),
+      },
+      mock_storage);
+
+  EXPECT_CALL(*mock_storage, CreatePage).Times(1);
+  EXPECT_CALL(*mock_storage, Write).Times(1);
+  level.Write(std::make_shared<tskv::SumColumn>(
+      std::vector<double>{1, 2, 3, 4, 5}, tskv::TimePoint(45), 15));
+
+  // pages that don't overlap the range are not read
+  EXPECT_CALL(*mock_storage, Read).Times(0);
+  EXPECT_FALSE(
+      level.Read(tskv::TimeRange{120, 200}, tskv::StoredAggregationType::kSum));
+  EXPECT_FALSE(
+      level.Read(tskv::TimeRange{0, 45}, tskv::StoredAggregationType::kSum));
+  EXPECT_FALSE(
+      level.Read(tskv::TimeRange{0, 100}, tskv::StoredAggregationType::kMax));
+}
+
+TEST(Level, PageCache) {
+  auto mock_storage = std::make_shared<MockPersistentStorage>();
+  auto page_cache = std::make_shared<tskv::PageCache>(
+      tskv::PageCache::Options{.max_bytes_size = 1000});
+  tskv::Level level(
+      tskv::Level::Options{
+          .bucket_interval = 15,
+          .level_duration = 1000,
+      },
+      mock_storage, page_cache);
+
+  EXPECT_CALL(*mock_storage, CreatePage)
+      .WillOnce(testing::Return(tskv::PageId("page")));
+  EXPECT_CALL(*mock_storage, Write).Times(1);
+  auto column = std::make_shared<tskv::SumColumn>(
+      std::vector<double>{1, 2, 3, 4, 5}, tskv::TimePoint(45), 15);
+  level.Write(column);
+
+  // the page is decoded once, then parts of it are read from the cache
+  EXPECT_CALL(*mock_storage, Read)
+      .WillOnce(testing::Return(column->ToBytes()));
+  EXPECT_CALL(*mock_storage, ReadRange).Times(0);
+  auto read_column =
+      level.Read(tskv::TimeRange{45, 120}, tskv::StoredAggregationType::kSum);
+  EXPECT_EQ(read_column->GetValues(), std::vector<double>({1, 2, 3, 4, 5}));
+  for (int i = 0; i < 2; ++i) {
+    read_column = level.Read(tskv::TimeRange{60, 90},
+                             tskv::StoredAggregationType::kSum);
+    EXPECT_EQ(read_column->GetValues(), std::vector<double>({2, 3}));
+  }
+  EXPECT_EQ(page_cache->GetStats().hits, 2);
+  EXPECT_EQ(page_cache->GetStats().misses, 1);
+}
+
+TEST(Level, SharedPageCache) {
+  auto page_cache = std::make_shared<tskv::PageCache>(
+      tskv::PageCache::Options{.max_bytes_size = 1000});
+  tskv::Level::Options options{
+      .bucket_interval = 10,
+      .level_duration = 1000,
+  };
+  std::vector<std::map<tskv::PageId, tskv::CompressedBytes>> pages(2);
+  std::vector<tskv::Level> levels;
+  for (size_t i = 0; i < 2; ++i) {
+    auto mock_storage =
+        std::make_shared<testing::NiceMock<MockPersistentStorage>>();
+    StorePages(*mock_storage, pages[i]);
+    levels.emplace_back(options, mock_storage, page_cache);
+    levels.back().Write(std::make_shared<tskv::SumColumn>(
+        std::vector<double>{double(i)}, tskv::TimePoint(0), 10));
+  }
+
+  // both storages named their pages "0"
+  for (size_t i = 0; i < 2; ++i) {
+    auto sum = levels[i].Read(tskv::TimeRange{0, 10},
+                              tskv::StoredAggregationType::kSum);
+    EXPECT_EQ(sum->GetValues(), std::vector<double>({double(i)}));
+  }
+  EXPECT_EQ(page_cache->GetStats().misses, 2);
+}
+
+TEST(Level, RangedReads) {
+  auto mock_storage =
+      std::make_shared<testing::NiceMock<MockPersistentStorage>>();
+  std::map<tskv::PageId, tskv::CompressedBytes> pages;
+  StorePages(*mock_storage, pages);
+  size_t fetched_bytes = 0;
+  ON_CALL(*mock_storage, ReadRange)
+      .WillByDefault(
+          [&](const tskv::PageId& page_id, size_t offset, size_t size) {
+            fetched_bytes += size;
+            const auto& bytes = pages.at(page_id);
+            return tskv::CompressedBytes(bytes.begin() + offset,
+                                         bytes.begin() + offset + size);
+          });
+  EXPECT_CALL(*mock_storage, Read).Times(0);
+  tskv::Level level(
+      tskv::Level::Options{
+          .bucket_interval = 10,
+          .level_duration = 100000,
+          .store_raw = true,
+      },
+      mock_storage);
+
+  std::vector<double> values(1000);
+  std::iota(values.begin(), values.end(), 0);
+  std::vector<tskv::TimePoint> timestamps;
+  for (size_t i = 0; i < values.size(); ++i) {
+    timestamps.push_back(i * 10);
+  }
+  level.Write(
+      std::make_shared<tskv::SumColumn>(values, tskv::TimePoint(0), 10));
+  level.Write(std::make_shared<tskv::RawTimestampsColumn>(timestamps));
+  level.Write(std::make_shared<tskv::RawValuesColumn>(values));
+
+  // only five buckets, the header is known from the page metadata
+  auto sum = level.Read(tskv::TimeRange{1000, 1050},
+                        tskv::StoredAggregationType::kSum);
+  EXPECT_EQ(sum->GetValues(), std::vector<double>({100, 101, 102, 103, 104}));
+  EXPECT_EQ(fetched_bytes, 5 * 8);
+
+  // one block of timestamps and values
+  fetched_bytes = 0;
+  auto raw = level.Read(tskv::TimeRange{5000, 5030},
+                        tskv::StoredAggregationType::kNone);
+  EXPECT_EQ(raw->GetValues(), std::vector<double>({500, 501, 502}));
+  EXPECT_EQ(fetched_bytes, 2 * tskv::Level::kRawBlockSize * 8);
+}
+
+TEST(Level, RangedReadsOfIndexedPages) {
+  auto mock_storage =
+      std::make_shared<testing::NiceMock<MockPersistentStorage>>();
+  std::map<tskv::PageId, tskv::CompressedBytes> pages;
+  StorePages(*mock_storage, pages);
+  size_t fetched_bytes = 0;
+  ON_CALL(*mock_storage, ReadRange)
+      .WillByDefault(
+          [&](const tskv::PageId& page_id, size_t offset, size_t size) {
+            fetched_bytes += size;
+            const auto& bytes = pages.at(page_id);
+            return tskv::CompressedBytes(bytes.begin() + offset,
+                                         bytes.begin() + offset + size);
+          });
+  EXPECT_CALL(*mock_storage, Read).Times(0);
+  // parts of pages are not cached
+  auto page_cache = std::make_shared<tskv::PageCache>(
+      tskv::PageCache::Options{.max_bytes_size = 1 << 20});
+  tskv::Level level(
+      tskv::Level::Options{
+          .bucket_interval = 10,
+          .level_duration = 100000,
+      },
+      mock_storage, page_cache);
+
+  // two runs of buckets, every third bucket is absent, so count pages are
+  // bit-packed and both pages have presence bitmaps
+  auto count = std::make_shared<tskv::CountColumn>(10);
+  auto min = std::make_shared<tskv::MinColumn>(10);
+  for (auto [first, last] : {std::pair<size_t, size_t>{0, 200}, {500, 700}}) {
+    tskv::InputTimeSeries records;
+    for (size_t i = first; i < last; ++i) {
+      for (size_t j = 0; i % 3 != 0 && j < 1 + i % 2; ++j) {
+        records.push_back({i * 10 + j, double(i)});
+      }
+    }
+    count->Write(records);
+    min->Write(records);
+  }
+  ASSERT_TRUE(count->IsSparse());
+  level.Write(count);
+  level.Write(min);
+
+  for (auto time_range :
+       {tskv::TimeRange{1000, 1050}, tskv::TimeRange{1900, 5050}}) {
+    fetched_bytes = 0;
+    auto read_count = std::dynamic_pointer_cast<tskv::CountColumn>(
+        level.Read(time_range, tskv::StoredAggregationType::kCount));
+    ASSERT_TRUE(read_count);
+    auto expected_count =
+        std::static_pointer_cast<tskv::CountColumn>(count->Read(time_range));
+    EXPECT_EQ(read_count->GetValues(), expected_count->GetValues());
+    EXPECT_EQ(read_count->GetPresence().ToWords(),
+              expected_count->GetPresence().ToWords());
+    // a few bytes of 2-bit counts and presence words of the range, the page
+    // is several times larger
+    EXPECT_LE(fetched_bytes, 8 + 3 * 8);
+
+    auto read_min = std::dynamic_pointer_cast<tskv::MinColumn>(
+        level.Read(time_range, tskv::StoredAggregationType::kMin));
+    ASSERT_TRUE(read_min);
+    auto expected_min =
+        std::static_pointer_cast<tskv::MinColumn>(min->Read(time_range));
+    EXPECT_EQ(read_min->GetValues(), expected_min->GetValues());
+    EXPECT_EQ(read_min->GetPresence().ToWords(),
+              expected_min->GetPresence().ToWords());
+  }
+  EXPECT_EQ(page_cache->GetBytesSize(), 0);
+
+  // the range without stored buckets fetches nothing
+  fetched_bytes = 0;
+  EXPECT_FALSE(level.Read(tskv::TimeRange{2500, 4500},
+                          tskv::StoredAggregationType::kCount));
+  EXPECT_EQ(fetched_bytes, 0);
+}
+
+TEST(Level, AppendOnlyWrites) {
+  auto mock_storage =
+      std::make_shared<testing::NiceMock<MockPersistentStorage>>();
+  std::map<tskv::PageId, tskv::CompressedBytes> pages;
+  StorePages(*mock_storage, pages);
+  tskv::Level level(
+      tskv::Level::Options{
+          .bucket_interval = 10,
+          .level_duration = 1000,
+          .store_raw = true,
+      },
+      mock_storage);
+
+  // pages are never read and rewritten on writes
+  EXPECT_CALL(*mock_storage, Read).Times(0);
+  EXPECT_CALL(*mock_storage, CreatePage).Times(6);
+  for (tskv::TimePoint start : {0, 30}) {
+    level.Write(std::make_shared<tskv::SumColumn>(std::vector<double>{1, 2, 3},
+                                                  start, 10));
+    level.Write(std::make_shared<tskv::RawTimestampsColumn>(
+        std::vector<tskv::TimePoint>{start, start + 10, start + 20}));
+    level.Write(std::make_shared<tskv::RawValuesColumn>(
+        std::vector<double>{1, 2, 3}));
+  }
+  testing::Mock::VerifyAndClearExpectations(mock_storage.get());
+
+  // segments are stitched on reads
+  auto sum =
+      level.Read(tskv::TimeRange{0, 60}, tskv::StoredAggregationType::kSum);
+  EXPECT_EQ(sum->GetValues(), std::vector<double>({1, 2, 3, 1, 2, 3}));
+  auto raw =
+      level.Read(tskv::TimeRange{15, 45}, tskv::StoredAggregationType::kNone);
+  EXPECT_EQ(raw->GetValues(), std::vector<double>({3, 1, 2}));
+}
+
+TEST(Level, PageIndex) {
+  auto mock_storage =
+      std::make_shared<testing::NiceMock<MockPersistentStorage>>();
+  std::map<tskv::PageId, tskv::CompressedBytes> pages;
+  StorePages(*mock_storage, pages);
+  tskv::Level::Options options{
+      .bucket_interval = 10,
+      .level_duration = 1000,
+  };
+  tskv::Level level(options, mock_storage);
+  tskv::Level next_level(options, mock_storage);
+  for (tskv::TimePoint start = 0; start < 300; start += 30) {
+    level.Write(std::make_shared<tskv::SumColumn>(std::vector<double>{1, 2, 3},
+                                                  start, 10));
+  }
+
+  // pages are moved without rewriting
+  EXPECT_CALL(*mock_storage, Read).Times(0);
+  EXPECT_CALL(*mock_storage, CreatePage).Times(0);
+  next_level.MovePagesFrom(level);
+  testing::Mock::VerifyAndClearExpectations(mock_storage.get());
+
+  // only pages overlapping the range are fetched
+  EXPECT_CALL(*mock_storage, Read).Times(2);
+  auto sum = next_level.Read(tskv::TimeRange{90, 150},
+                             tskv::StoredAggregationType::kSum);
+  EXPECT_EQ(sum->GetValues(), std::vector<double>({1, 2, 3, 1, 2, 3}));
+  testing::Mock::VerifyAndClearExpectations(mock_storage.get());
+
+  EXPECT_CALL(*mock_storage, Read).Times(10);
+  sum = next_level.Read(tskv::TimeRange{0, 300},
+                        tskv::StoredAggregationType::kSum);
+  EXPECT_EQ(sum->GetValues().size(), 30);
+  EXPECT_EQ(level.Read(tskv::TimeRange{0, 300},
+                       tskv::StoredAggregationType::kSum),
+            nullptr);
+}
+
+TEST(Level, PagesToRead) {
+  auto mock_storage =
+      std::make_shared<testing::NiceMock<MockPersistentStorage>>();
+  std::map<tskv::PageId, tskv::CompressedBytes> pages;
+  StorePages(*mock_storage, pages);
+  tskv::Level level(
+      tskv::Level::Options{
+          .bucket_interval = 10,
+          .level_duration = 1000,
+      },
+      mock_storage);
+  for (tskv::TimePoint start : {0, 30, 60}) {
+    level.Write(std::make_shared<tskv::SumColumn>(std::vector<double>{1, 2, 3},
+                                                  start, 10));
+  }
+
+  // the last page is fetched partially by the level itself
+  tskv::TimeRange time_range{0, 70};
+  auto page_refs =
+      level.GetPagesToRead(time_range, tskv::StoredAggregationType::kSum);
+  ASSERT_EQ(page_refs.size(), 2);
+  tskv::Level::DecodedPages decoded_pages;
+  for (const auto& page_ref : page_refs) {
+    EXPECT_EQ(page_ref.column_type, tskv::ColumnType::kSum);
+    decoded_pages.emplace(
+        page_ref.page_id,
+        tskv::FromBytes(pages.at(page_ref.page_id), page_ref.column_type));
+  }
+
+  EXPECT_CALL(*mock_storage, Read).Times(0);
+  EXPECT_CALL(*mock_storage, ReadRange).Times(1);
+  auto sum = level.Read(time_range, tskv::StoredAggregationType::kSum,
+                        decoded_pages);
+  EXPECT_EQ(sum->GetValues(), std::vector<double>({1, 2, 3, 1, 2, 3, 1}));
+}
+
+TEST(Level, LateWritesDontFillLevel) {
+  auto mock_storage =
+      std::make_shared<testing::NiceMock<MockPersistentStorage>>();
+  std::map<tskv::PageId, tskv::CompressedBytes> pages;
+  StorePages(*mock_storage, pages);
+  tskv::Level level(
+      tskv::Level::Options{
+          .bucket_interval = 10,
+          .level_duration = 100,
+      },
+      mock_storage);
+  level.Write(std::make_shared<tskv::SumColumn>(std::vector<double>{1, 2, 3},
+                                                1000, 10));
+  EXPECT_FALSE(level.NeedMerge());
+
+  // a late record much older than the level duration
+  level.WriteLate(
+      std::make_shared<tskv::SumColumn>(std::vector<double>{5}, 0, 10));
+  EXPECT_FALSE(level.NeedMerge());
+  auto sum =
+      level.Read(tskv::TimeRange{0, 10}, tskv::StoredAggregationType::kSum);
+  EXPECT_EQ(sum->GetValues(), std::vector<double>({5}));
+}
+
+TEST(Level, MovePagesMergesLatePages) {
+  auto mock_storage =
+      std::make_shared<testing::NiceMock<MockPersistentStorage>>();
+  std::map<tskv::PageId, tskv::CompressedBytes> pages;
+  StorePages(*mock_storage, pages);
+  tskv::Level::Options options{
+      .bucket_interval = 10,
+      .level_duration = 100,
+      .store_raw = true,
+  };
+  tskv::Level level(options, mock_storage);
+  tskv::Level next_level(options, mock_storage);
+  auto raw_columns = [](const tskv::InputTimeSeries& records) {
+    tskv::SerializableColumns columns;
+    for (auto column_type :
+         {tskv::ColumnType::kRawTimestamps, tskv::ColumnType::kRawValues}) {
+      auto column = tskv::CreateRawColumn(column_type);
+      column->Write(records);
+      columns.push_back(
+          std::dynamic_pointer_cast<tskv::ISerializableColumn>(column));
+    }
+    return columns;
+  };
+  next_level.Write(std::make_shared<tskv::SumColumn>(
+      std::vector<double>{1, 2, 3}, 0, 10));
+  next_level.Write(raw_columns({{1, 1}, {5, 2}}));
+  level.Write(
+      std::make_shared<tskv::SumColumn>(std::vector<double>{4, 5}, 100, 10));
+  level.Write(raw_columns({{105, 3}}));
+  // late records overlap pages of both levels
+  level.WriteLate(
+      std::make_shared<tskv::SumColumn>(std::vector<double>{10}, 10, 10));
+  level.WriteLate(
+      std::make_shared<tskv::SumColumn>(std::vector<double>{20}, 110, 10));
+  for (const auto& column : raw_columns({{3, 7}})) {
+    level.WriteLate(column);
+  }
+
+  next_level.MovePagesFrom(level);
+  // late pages are gone, their records are in the pages they overlap
+  EXPECT_EQ(level.ExtractRetiredPages().size(), 4);
+  EXPECT_EQ(next_level.ExtractRetiredPages().size(), 4);
+  tskv::TimeRange time_range{0, 200};
+  EXPECT_EQ(
+      next_level.GetPagesToRead(time_range, tskv::StoredAggregationType::kSum)
+          .size(),
+      2);
+  auto sum = next_level.Read(time_range, tskv::StoredAggregationType::kSum);
+  EXPECT_EQ(sum->GetValues(),
+            std::vector<double>({1, 12, 3, 0, 0, 0, 0, 0, 0, 0, 4, 25}));
+  EXPECT_EQ(
+      next_level.GetPagesToRead(time_range, tskv::StoredAggregationType::kNone)
+          .size(),
+      4);
+  auto raw = next_level.Read(time_range, tskv::StoredAggregationType::kNone);
+  EXPECT_EQ(raw->GetValues(), std::vector<double>({1, 7, 2, 3}));
+}
@@ -97,3 +97,94 @@ TEST(Memtable, ExtractColumns) {
     }
   }
 }
+
+TEST(Memtable, OutOfOrder) {
+  tskv::Memtable memtable(
+      tskv::Memtable::Options{
+          .bucket_interval = 2,
+          .store_raw = true,
+          .max_lateness = 4,
+      },
+      tskv::MetricOptions{{tskv::StoredAggregationType::kLast}});
+
+  memtable.Write(tskv::InputTimeSeries{{10, 1}, {3, 2}, {8, 3}});
+  // records of the lateness window are readable before they are written to
+  // columns
+  auto read_res = memtable.Read(tskv::TimeRange{0, 100},
+                                tskv::StoredAggregationType::kLast);
+  ASSERT_EQ(read_res.found->GetValues(),
+            std::vector<double>({2, 0, 0, 3, 1}));
+  read_res = memtable.Read(tskv::TimeRange{0, 100},
+                           tskv::StoredAggregationType::kNone);
+  ASSERT_EQ(read_res.found->GetValues(), std::vector<double>({2, 3, 1}));
+
+  memtable.Write(tskv::InputTimeSeries{{20, 4}, {9, 5}, {5, 6}});
+  read_res = memtable.Read(tskv::TimeRange{0, 100},
+                           tskv::StoredAggregationType::kNone);
+  ASSERT_EQ(read_res.found->GetValues(),
+            std::vector<double>({2, 6, 3, 5, 1, 4}));
+  ASSERT_FALSE(memtable.HasLateRecords());
+
+  // behind the lateness window, nothing is flushed yet, so even the record
+  // older than the memtable isn't late
+  memtable.Write(tskv::InputTimeSeries{{1, 7}, {15, 8}, {4, 11}});
+  ASSERT_FALSE(memtable.HasLateRecords());
+  read_res = memtable.Read(tskv::TimeRange{0, 100},
+                           tskv::StoredAggregationType::kNone);
+  ASSERT_EQ(read_res.found->GetValues(),
+            std::vector<double>({7, 2, 11, 6, 3, 5, 1, 8, 4}));
+  ASSERT_EQ(*read_res.not_found, tskv::TimeRange(0, 1));
+  read_res = memtable.Read(tskv::TimeRange{0, 100},
+                           tskv::StoredAggregationType::kLast);
+  ASSERT_EQ(read_res.found->GetValues(),
+            std::vector<double>({7, 2, 6, 0, 5, 1, 0, 8, 0, 0, 4}));
+
+  auto columns = memtable.ExtractColumns();
+  for (const auto& column : columns) {
+    if (column->GetType() == tskv::ColumnType::kRawTimestamps) {
+      ASSERT_EQ(column->GetValues(),
+                std::vector<double>({1, 3, 4, 5, 8, 9, 10, 15, 20}));
+    }
+  }
+  // flushed records can't be merged anymore
+  memtable.Write(tskv::InputTimeSeries{{19, 9}, {21, 10}});
+  ASSERT_TRUE(memtable.HasLateRecords());
+  auto late = memtable.ExtractLateColumns();
+  ASSERT_FALSE(memtable.HasLateRecords());
+  for (const auto& column : late) {
+    if (column->GetType() == tskv::ColumnType::kRawTimestamps) {
+      ASSERT_EQ(column->GetValues(), std::vector<double>({19}));
+    } else if (column->GetType() == tskv::ColumnType::kRawValues) {
+      ASSERT_EQ(column->GetValues(), std::vector<double>({9}));
+    }
+  }
+}
+
+TEST(Memtable, Freeze) {
+  tskv::Memtable memtable(
+      tskv::Memtable::Options{
+          .bucket_interval = 2,
+          .store_raw = true,
+      },
+      tskv::MetricOptions{{tskv::StoredAggregationType::kSum}});
+
+  memtable.Write(tskv::InputTimeSeries{{3, 10}, {4, 1}, {5, 2}});
+  auto frozen = memtable.Freeze();
+  memtable.Write(tskv::InputTimeSeries{{5, 3}, {8, 4}});
+
+  auto read_res =
+      frozen->Read(tskv::TimeRange{0, 10}, tskv::StoredAggregationType::kSum);
+  ASSERT_EQ(read_res.found->GetValues(), std::vector<double>({10, 3}));
+  ASSERT_EQ(*read_res.not_found, tskv::TimeRange(0, 2));
+  ASSERT_EQ(frozen->GetColumns().size(), 3);
+
+  // the first bucket is shared with the frozen memtable, so it is not found
+  // either
+  read_res =
+      memtable.Read(tskv::TimeRange{0, 10}, tskv::StoredAggregationType::kSum);
+  ASSERT_EQ(read_res.found->GetValues(), std::vector<double>({3, 0, 4}));
+  ASSERT_EQ(*read_res.not_found, tskv::TimeRange(0, 6));
+
+  memtable.Write(tskv::InputTimeSeries{{2, 7}});
+  ASSERT_TRUE(memtable.HasLateRecords());
+}
@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "model/column.h"
+#include "persistent-storage/page_cache.h"
+
+namespace {
+
+// column of `buckets_num` buckets, 8 bytes each
+tskv::Column MakeColumn(size_t buckets_num) {
+  auto column = std::make_shared<tskv::SumColumn>(
+      std::vector<double>(buckets_num, 1), tskv::TimePoint(0), 10);
+  return std::static_pointer_cast<tskv::IReadColumn>(column);
+}
+
+}  // namespace
+
+TEST(PageCache, GetPut) {
+  tskv::PageCache cache({.max_bytes_size = 1000, .shards_num = 1});
+  EXPECT_FALSE(cache.Get(0, "a"));
+
+  auto column = MakeColumn(10);
+  cache.Put(0, "a", column);
+  EXPECT_EQ(cache.Get(0, "a"), column);
+  EXPECT_EQ(cache.GetBytesSize(), 80);
+
+  cache.Erase(0, "a");
+  EXPECT_FALSE(cache.Get(0, "a"));
+  EXPECT_EQ(cache.GetBytesSize(), 0);
+
+  auto stats = cache.GetStats();
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(stats.misses, 2);
+}
+
+TEST(PageCache, Eviction) {
+  tskv::PageCache cache({.max_bytes_size = 240, .shards_num = 1});
+  cache.Put(0, "a", MakeColumn(10));
+  cache.Put(0, "b", MakeColumn(10));
+  cache.Put(0, "c", MakeColumn(10));
+  // "a" becomes the most recently used, so "b" is evicted
+  EXPECT_TRUE(cache.Get(0, "a"));
+  cache.Put(0, "d", MakeColumn(10));
+  EXPECT_TRUE(cache.Get(0, "a"));
+  EXPECT_FALSE(cache.Get(0, "b"));
+  EXPECT_TRUE(cache.Get(0, "c"));
+  EXPECT_TRUE(cache.Get(0, "d"));
+  EXPECT_EQ(cache.GetBytesSize(), 240);
+
+  // larger than the whole budget
+  cache.Put(0, "e", MakeColumn(100));
+  EXPECT_FALSE(cache.Get(0, "e"));
+  EXPECT_EQ(cache.GetBytesSize(), 240);
+}
+
+TEST(PageCache, Storages) {
+  tskv::PageCache cache({.max_bytes_size = 1000, .shards_num = 1});
+  auto first = MakeColumn(1);
+  auto second = MakeColumn(2);
+  // storages reuse page ids
+  cache.Put(0, "a", first);
+  cache.Put(1, "a", second);
+  EXPECT_EQ(cache.Get(0, "a"), first);
+  EXPECT_EQ(cache.Get(1, "a"), second);
+  cache.Erase(0, "a");
+  EXPECT_FALSE(cache.Get(0, "a"));
+  EXPECT_EQ(cache.Get(1, "a"), second);
+}
+
+TEST(PageCache, Shards) {
+  tskv::PageCache cache({.max_bytes_size = 800, .shards_num = 4});
+  for (char page_id = 'a'; page_id <= 'z'; ++page_id) {
+    cache.Put(0, std::string(1, page_id), MakeColumn(10));
+  }
+  // every shard keeps at most its part of the budget
+  EXPECT_LE(cache.GetBytesSize(), 800);
+  EXPECT_GT(cache.GetBytesSize(), 0);
+
+  EXPECT_THROW(tskv::PageCache({.max_bytes_size = 800, .shards_num = 0}),
+               std::runtime_error);
+}
@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "model/column.h"
+#include "model/model.h"
+#include "persistent-storage/persistent_storage.h"
+#include "persistent-storage/persistent_storage_manager.h"
+
+namespace {
+
+// counts how pages are fetched
+class CountingStorage : public tskv::IPersistentStorage {
+ public:
+  Metadata GetMetadata() const override { return {}; }
+  tskv::PageId CreatePage() override {
+    auto page_id = std::to_string(pages_.size());
+    pages_[page_id];
+    return page_id;
+  }
+  tskv::CompressedBytes Read(const tskv::PageId& page_id) override {
+    ++reads_num;
+    return pages_.at(page_id);
+  }
+  void Write(const tskv::PageId& page_id,
+             const tskv::CompressedBytes& bytes) override {
+    pages_.at(page_id) = bytes;
+  }
+  void DeletePage(const tskv::PageId& page_id) override {
+    pages_.erase(page_id);
+  }
+  tskv::PageView ReadView(const tskv::PageId& page_id) override {
+    ++views_num;
+    const auto& bytes = pages_.at(page_id);
+    return {nullptr, bytes};
+  }
+  tskv::CompressedBytes ReadRange(const tskv::PageId& page_id, size_t offset,
+                                  size_t size) override {
+    ++ranged_reads_num;
+    const auto& bytes = pages_.at(page_id);
+    return {bytes.begin() + offset, bytes.begin() + offset + size};
+  }
+
+  size_t reads_num{0};
+  size_t views_num{0};
+  size_t ranged_reads_num{0};
+
+ private:
+  std::map<tskv::PageId, tskv::CompressedBytes> pages_;
+};
+
+}  // namespace
+
+TEST(PersistentStorageManager, FetchPages) {
+  auto storage = std::make_shared<CountingStorage>();
+  tskv::PersistentStorageManager manager({
+      .levels = {{
+          .bucket_interval = 10,
+          .level_duration = 100000,
+      }},
+      .storage = storage,
+  });
+  for (tskv::TimePoint start : {0, 100}) {
+    manager.Write({std::make_shared<tskv::SumColumn>(
+        std::vector<double>(10, 1), start, 10)});
+  }
+
+  // whole pages are fetched as views in one batch
+  auto sum = manager.Read({0, 200}, tskv::StoredAggregationType::kSum);
+  EXPECT_EQ(sum->GetValues(), std::vector<double>(20, 1));
+  EXPECT_EQ(storage->views_num, 2);
+  EXPECT_EQ(storage->ranged_reads_num, 0);
+
+  // a part of the second page is read by the level
+  sum = manager.Read({0, 150}, tskv::StoredAggregationType::kSum);
+  EXPECT_EQ(sum->GetValues(), std::vector<double>(15, 1));
+  EXPECT_EQ(storage->views_num, 3);
+  EXPECT_EQ(storage->ranged_reads_num, 1);
+  EXPECT_EQ(storage->reads_num, 0);
+}
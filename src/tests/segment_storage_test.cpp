@@ -0,0 +1,257 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "executor/background_executor.h"
+#include "model/column.h"
+#include "persistent-storage/io_ring.h"
+#include "persistent-storage/segment_storage.h"
+
+namespace {
+
+std::string MakeTempDir(const std::string& name) {
+  auto path = std::filesystem::temp_directory_path() / name;
+  std::filesystem::remove_all(path);
+  return path;
+}
+
+// copies of the viewed pages, so that they can be compared
+std::vector<tskv::CompressedBytes> ToBytes(
+    const std::vector<tskv::PageView>& page_views) {
+  std::vector<tskv::CompressedBytes> pages;
+  for (const auto& page_view : page_views) {
+    pages.emplace_back(page_view.bytes.begin(), page_view.bytes.end());
+  }
+  return pages;
+}
+
+size_t FilesNum(const std::string& path) {
+  auto it = std::filesystem::directory_iterator(path);
+  return std::distance(begin(it), end(it));
+}
+
+}  // namespace
+
+TEST(SegmentStorage, ReadWrite) {
+  auto path = MakeTempDir("tskv_segment_storage_test");
+  tskv::SegmentStorage storage({.path = path});
+  std::vector<tskv::PageId> page_ids;
+  for (uint8_t i = 0; i < 100; ++i) {
+    auto page_id = storage.CreatePage();
+    storage.Write(page_id, tskv::CompressedBytes{i, 1, 2, 3, 4});
+    page_ids.push_back(page_id);
+  }
+  // pages share one segment and one table log
+  EXPECT_EQ(storage.SegmentsNum(), 1);
+  EXPECT_EQ(FilesNum(path), 2);
+  for (uint8_t i = 0; i < 100; ++i) {
+    EXPECT_EQ(storage.Read(page_ids[i]),
+              tskv::CompressedBytes({i, 1, 2, 3, 4}));
+  }
+
+  EXPECT_EQ(storage.ReadRange(page_ids[5], 1, 3),
+            tskv::CompressedBytes({1, 2, 3}));
+  EXPECT_THROW(storage.ReadRange(page_ids[5], 3, 3), std::runtime_error);
+  storage.Write(page_ids[5], tskv::CompressedBytes{7});
+  EXPECT_EQ(storage.Read(page_ids[5]), tskv::CompressedBytes({7}));
+  EXPECT_TRUE(storage.Read(storage.CreatePage()).empty());
+  storage.DeletePage(page_ids[5]);
+  EXPECT_THROW(storage.Read(page_ids[5]), std::runtime_error);
+  std::filesystem::remove_all(path);
+}
+
+TEST(SegmentStorage, Reopen) {
+  auto path = MakeTempDir("tskv_segment_storage_reopen_test");
+  tskv::PageId page_id;
+  tskv::PageId deleted_page_id;
+  {
+    tskv::SegmentStorage storage({.path = path, .max_segment_size = 4});
+    page_id = storage.CreatePage();
+    deleted_page_id = storage.CreatePage();
+    storage.Write(page_id, tskv::CompressedBytes{1, 2, 3, 4});
+    storage.Write(deleted_page_id, tskv::CompressedBytes{5, 6, 7, 8});
+    storage.Write(page_id, tskv::CompressedBytes{1, 2, 3});
+    storage.Sync();
+    storage.DeletePage(deleted_page_id);
+    storage.Sync();
+  }
+
+  tskv::SegmentStorage storage({.path = path, .max_segment_size = 4});
+  EXPECT_EQ(storage.Read(page_id), tskv::CompressedBytes({1, 2, 3}));
+  EXPECT_THROW(storage.Read(deleted_page_id), std::runtime_error);
+  // new pages don't reuse ids of old ones
+  auto new_page_id = storage.CreatePage();
+  EXPECT_NE(new_page_id, page_id);
+  EXPECT_NE(new_page_id, deleted_page_id);
+  std::filesystem::remove_all(path);
+}
+
+TEST(SegmentStorage, ReopenTornSegments) {
+  auto path = MakeTempDir("tskv_segment_storage_torn_test");
+  tskv::PageId page_id;
+  tskv::PageId lost_page_id;
+  tskv::PageId new_page_id;
+  {
+    tskv::SegmentStorage storage({.path = path, .max_segment_size = 4});
+    page_id = storage.CreatePage();
+    lost_page_id = storage.CreatePage();
+    storage.Write(page_id, tskv::CompressedBytes{1, 2, 3, 4});
+    storage.Write(page_id, tskv::CompressedBytes{5, 6, 7, 8});
+    storage.Write(lost_page_id, tskv::CompressedBytes{9, 10});
+  }
+  // the log reached the disk before bytes of the last two writes, the
+  // second segment is cut and the third one is lost
+  std::filesystem::resize_file(std::filesystem::path(path) / "2.seg", 2);
+  std::filesystem::remove(std::filesystem::path(path) / "3.seg");
+
+  {
+    tskv::SegmentStorage storage({.path = path, .max_segment_size = 4});
+    EXPECT_EQ(storage.Read(page_id), tskv::CompressedBytes({1, 2, 3, 4}));
+    EXPECT_THROW(storage.Read(lost_page_id), std::runtime_error);
+    // the new segment doesn't take the id of the lost one
+    new_page_id = storage.CreatePage();
+    storage.Write(new_page_id, tskv::CompressedBytes{11, 12});
+  }
+  tskv::SegmentStorage storage({.path = path, .max_segment_size = 4});
+  EXPECT_EQ(storage.Read(page_id), tskv::CompressedBytes({1, 2, 3, 4}));
+  EXPECT_THROW(storage.Read(lost_page_id), std::runtime_error);
+  EXPECT_EQ(storage.Read(new_page_id), tskv::CompressedBytes({11, 12}));
+  std::filesystem::remove_all(path);
+}
+
+TEST(SegmentStorage, Reclaim) {
+  auto path = MakeTempDir("tskv_segment_storage_reclaim_test");
+  tskv::SegmentStorage storage({.path = path, .max_segment_size = 40});
+  std::vector<tskv::PageId> page_ids;
+  for (uint8_t i = 0; i < 100; ++i) {
+    auto page_id = storage.CreatePage();
+    storage.Write(page_id, tskv::CompressedBytes(10, i));
+    page_ids.push_back(page_id);
+  }
+  EXPECT_EQ(storage.SegmentsNum(), 25);
+
+  // three of every four pages are deleted, live pages of sealed segments
+  // are packed together
+  for (uint8_t i = 0; i < 100; ++i) {
+    if (i % 4 != 0) {
+      storage.DeletePage(page_ids[i]);
+    }
+  }
+  EXPECT_LE(storage.SegmentsNum(), 9);
+  for (uint8_t i = 0; i < 100; i += 4) {
+    EXPECT_EQ(storage.Read(page_ids[i]), tskv::CompressedBytes(10, i));
+  }
+  std::filesystem::remove_all(path);
+}
+
+TEST(SegmentStorage, BackgroundReclaim) {
+  auto path = MakeTempDir("tskv_segment_storage_background_test");
+  auto executor = std::make_shared<tskv::BackgroundExecutor>();
+  std::vector<tskv::PageId> page_ids;
+  {
+    tskv::SegmentStorage storage({
+        .path = path,
+        .max_segment_size = 40,
+        .reclaim_executor = executor,
+    });
+    for (uint8_t i = 0; i < 100; ++i) {
+      auto page_id = storage.CreatePage();
+      storage.Write(page_id, tskv::CompressedBytes(10, i));
+      page_ids.push_back(page_id);
+    }
+    for (uint8_t i = 0; i < 100; ++i) {
+      if (i % 2 != 0) {
+        storage.DeletePage(page_ids[i]);
+      } else {
+        EXPECT_EQ(storage.Read(page_ids[i]), tskv::CompressedBytes(10, i));
+      }
+    }
+    executor->Wait();
+    EXPECT_LE(storage.SegmentsNum(), 14);
+  }
+
+  // moved pages are found after reopening
+  tskv::SegmentStorage storage({.path = path, .max_segment_size = 40});
+  for (uint8_t i = 0; i < 100; i += 2) {
+    EXPECT_EQ(storage.Read(page_ids[i]), tskv::CompressedBytes(10, i));
+  }
+  std::filesystem::remove_all(path);
+}
+
+TEST(SegmentStorage, ConcurrentWrites) {
+  constexpr size_t kThreads = 4;
+  constexpr uint8_t kPagesPerThread = 50;
+  auto path = MakeTempDir("tskv_segment_storage_concurrent_test");
+  auto executor = std::make_shared<tskv::BackgroundExecutor>();
+  std::vector<std::vector<tskv::PageId>> page_ids(kThreads);
+  {
+    tskv::SegmentStorage storage({
+        .path = path,
+        .max_segment_size = 100,
+        .reclaim_executor = executor,
+    });
+    // segments of pending writes are sealed by other threads meanwhile, they
+    // must not be reclaimed before the writes are logged
+    std::vector<std::thread> threads;
+    for (size_t thread_idx = 0; thread_idx < kThreads; ++thread_idx) {
+      threads.emplace_back([&, thread_idx] {
+        auto& thread_page_ids = page_ids[thread_idx];
+        for (uint8_t i = 0; i < kPagesPerThread; ++i) {
+          auto page_id = storage.CreatePage();
+          storage.Write(page_id, tskv::CompressedBytes(10, i));
+          // the first write is dead, so its segment is reclaimed
+          storage.Write(page_id, tskv::CompressedBytes(20, i));
+          thread_page_ids.push_back(page_id);
+          // deletes schedule the reclamation
+          auto deleted_page_id = storage.CreatePage();
+          storage.Write(deleted_page_id, tskv::CompressedBytes(10, i));
+          storage.DeletePage(deleted_page_id);
+          ASSERT_EQ(storage.Read(page_id), tskv::CompressedBytes(20, i));
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    executor->Wait();
+  }
+
+  tskv::SegmentStorage storage({.path = path, .max_segment_size = 100});
+  for (const auto& thread_page_ids : page_ids) {
+    for (uint8_t i = 0; i < kPagesPerThread; ++i) {
+      EXPECT_EQ(storage.Read(thread_page_ids[i]),
+                tskv::CompressedBytes(20, i));
+    }
+  }
+  std::filesystem::remove_all(path);
+}
+
+TEST(SegmentStorage, ReadWriteMany) {
+  auto path = MakeTempDir("tskv_segment_storage_many_test");
+  std::vector<tskv::PageId> page_ids;
+  std::vector<tskv::CompressedBytes> pages;
+  {
+    tskv::SegmentStorage storage({
+        .path = path,
+        .max_segment_size = 10,
+        .io_ring = std::make_shared<tskv::IoRing>(2),
+    });
+    for (uint8_t i = 0; i < 5; ++i) {
+      page_ids.push_back(storage.CreatePage());
+      pages.push_back(tskv::CompressedBytes(i * 3, i));
+    }
+    storage.WriteMany(page_ids, pages);
+    EXPECT_EQ(ToBytes(storage.ReadMany(page_ids)), pages);
+    EXPECT_EQ(storage.Read(page_ids[4]), pages[4]);
+  }
+
+  tskv::SegmentStorage storage({.path = path, .max_segment_size = 10});
+  EXPECT_EQ(ToBytes(storage.ReadMany(page_ids)), pages);
+  storage.DeletePage(page_ids[3]);
+  EXPECT_THROW(storage.ReadMany(page_ids), std::runtime_error);
+  std::filesystem::remove_all(path);
+}
@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "model/column.h"
+#include "model/shared_vector.h"
+
+TEST(SharedVector, Slice) {
+  tskv::SharedVector<int> values(std::vector<int>{1, 2, 3, 4, 5});
+  EXPECT_FALSE(values.IsShared());
+  auto slice = values.Slice(1, 4);
+  EXPECT_EQ(slice.Size(), 3);
+  EXPECT_EQ(slice.Data(), values.Data() + 1);
+  EXPECT_EQ(slice.ToVector(), (std::vector<int>{2, 3, 4}));
+  EXPECT_TRUE(values.IsShared());
+  EXPECT_TRUE(slice.IsShared());
+  EXPECT_TRUE(values.Slice(2, 2).Empty());
+}
+
+TEST(SharedVector, CopyOnWrite) {
+  tskv::SharedVector<int> values(std::vector<int>{1, 2, 3, 4, 5});
+  auto slice = values.Slice(1, 4);
+  auto* data = values.Data();
+
+  values.PushBack(6);
+  EXPECT_NE(values.Data(), data);
+  EXPECT_EQ(values.ToVector(), (std::vector<int>{1, 2, 3, 4, 5, 6}));
+  EXPECT_EQ(slice.ToVector(), (std::vector<int>{2, 3, 4}));
+
+  slice.MutableData()[0] = 42;
+  EXPECT_FALSE(slice.IsShared());
+  EXPECT_EQ(slice.ToVector(), (std::vector<int>{42, 3, 4}));
+  EXPECT_EQ(values.ToVector(), (std::vector<int>{1, 2, 3, 4, 5, 6}));
+
+  // not shared anymore, so no more copies
+  EXPECT_FALSE(values.IsShared());
+  data = values.Data();
+  values.MutableData()[0] = 0;
+  EXPECT_EQ(values.Data(), data);
+}
+
+TEST(SharedVector, Move) {
+  tskv::SharedVector<int> values(std::vector<int>{1, 2, 3});
+  auto moved = std::move(values);
+  EXPECT_EQ(moved.Size(), 3);
+  EXPECT_TRUE(values.Empty());
+  values.PushBack(1);
+  EXPECT_EQ(values.ToVector(), std::vector<int>{1});
+}
+
+TEST(SharedVector, ColumnRead) {
+  tskv::SumColumn column(std::vector<double>{1, 2, 3, 4, 5},
+                         tskv::TimePoint(0), 1);
+  auto read = std::static_pointer_cast<tskv::SumColumn>(
+      column.Read(tskv::TimeRange(1, 4)));
+  EXPECT_EQ(read->GetValues(), (std::vector<double>{2, 3, 4}));
+
+  column.Write({{2, 10}, {6, 1}});
+  EXPECT_EQ(column.GetValues(), (std::vector<double>{1, 2, 13, 4, 5, 0, 1}));
+  EXPECT_EQ(read->GetValues(), (std::vector<double>{2, 3, 4}));
+
+  read->ScaleBuckets(2);
+  EXPECT_EQ(read->GetValues(), (std::vector<double>{2, 7}));
+  EXPECT_EQ(column.GetValues(), (std::vector<double>{1, 2, 13, 4, 5, 0, 1}));
+}
+
+TEST(SharedVector, RawColumnRead) {
+  auto timestamps = std::make_shared<tskv::RawTimestampsColumn>(
+      std::vector<tskv::TimePoint>{1, 3, 4, 8, 9});
+  auto values = std::make_shared<tskv::RawValuesColumn>(
+      std::vector<tskv::Value>{1, 2, 3, 4, 5});
+  tskv::ReadRawColumn column(timestamps, values);
+  auto read = std::static_pointer_cast<tskv::ReadRawColumn>(
+      column.Read(tskv::TimeRange(2, 9)));
+  EXPECT_EQ(read->GetValues(), (std::vector<double>{2, 3, 4}));
+
+  column.Write({{10, 6}});
+  read->Merge(column.Read(tskv::TimeRange(9, 11)));
+  EXPECT_EQ(read->GetValues(), (std::vector<double>{2, 3, 4, 5, 6}));
+  EXPECT_EQ(read->GetTimestamps(),
+            (std::vector<tskv::TimePoint>{3, 4, 8, 9, 10}));
+  EXPECT_EQ(column.GetValues(), (std::vector<double>{1, 2, 3, 4, 5, 6}));
+}
@@ -0,0 +1,466 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "model/column.h"
+#include "model/model.h"
+#include "persistent-storage/compaction_scheduler.h"
+#include "persistent-storage/page_cache.h"
+#include "persistent-storage/persistent_storage.h"
+#include "executor/background_executor.h"
+#include "storage/storage.h"
+#include "wal/write_ahead_log.h"
+
+namespace {
+
+class MemoryStorage : public tskv::IPersistentStorage {
+ public:
+  Metadata GetMetadata() const override { return {}; }
+  tskv::PageId CreatePage() override {
+    std::lock_guard lock(mutex_);
+    auto page_id = std::to_string(next_page_id_++);
+    pages_[page_id];
+    return page_id;
+  }
+  tskv::CompressedBytes Read(const tskv::PageId& page_id) override {
+    std::lock_guard lock(mutex_);
+    return pages_.at(page_id);
+  }
+  void Write(const tskv::PageId& page_id,
+             const tskv::CompressedBytes& bytes) override {
+    std::lock_guard lock(mutex_);
+    pages_.at(page_id) = bytes;
+  }
+  void DeletePage(const tskv::PageId& page_id) override {
+    std::lock_guard lock(mutex_);
+    pages_.erase(page_id);
+  }
+  size_t PagesNum() {
+    std::lock_guard lock(mutex_);
+    return pages_.size();
+  }
+  size_t CreatedPagesNum() {
+    std::lock_guard lock(mutex_);
+    return next_page_id_;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::map<tskv::PageId, tskv::CompressedBytes> pages_;
+  size_t next_page_id_{0};
+};
+
+// holds page writes until it's released
+class BlockingStorage : public MemoryStorage {
+ public:
+  void Write(const tskv::PageId& page_id,
+             const tskv::CompressedBytes& bytes) override {
+    {
+      std::unique_lock lock(gate_mutex_);
+      writing_ = true;
+      gate_.notify_all();
+      gate_.wait(lock, [this] { return released_; });
+    }
+    MemoryStorage::Write(page_id, bytes);
+  }
+  bool WaitWriting(std::chrono::milliseconds timeout) {
+    std::unique_lock lock(gate_mutex_);
+    return gate_.wait_for(lock, timeout, [this] { return writing_; });
+  }
+  void Release() {
+    std::lock_guard lock(gate_mutex_);
+    released_ = true;
+    gate_.notify_all();
+  }
+
+ private:
+  std::mutex gate_mutex_;
+  std::condition_variable gate_;
+  bool writing_{false};
+  bool released_{false};
+};
+
+// fails page writes while fail is set
+class FailingStorage : public MemoryStorage {
+ public:
+  void Write(const tskv::PageId& page_id,
+             const tskv::CompressedBytes& bytes) override {
+    if (fail) {
+      throw std::runtime_error("Page write failed");
+    }
+    MemoryStorage::Write(page_id, bytes);
+  }
+
+  std::atomic<bool> fail{false};
+};
+
+// remembers how many log files were left on every sync
+class SyncingStorage : public MemoryStorage {
+ public:
+  explicit SyncingStorage(std::shared_ptr<tskv::WriteAheadLog> wal)
+      : wal_(std::move(wal)) {}
+  void Sync() override {
+    std::lock_guard lock(sync_mutex_);
+    synced_files_nums_.push_back(wal_->FilesNum());
+  }
+  std::vector<size_t> SyncedFilesNums() {
+    std::lock_guard lock(sync_mutex_);
+    return synced_files_nums_;
+  }
+
+ private:
+  std::shared_ptr<tskv::WriteAheadLog> wal_;
+  std::mutex sync_mutex_;
+  std::vector<size_t> synced_files_nums_;
+};
+
+tskv::MetricStorage::Options MakeOptions() {
+  return {
+      tskv::MetricOptions{{tskv::StoredAggregationType::kSum,
+                           tskv::StoredAggregationType::kCount}},
+      tskv::Memtable::Options{
+          .bucket_interval = 10,
+          .max_bytes_size = 1000,
+          .store_raw = true,
+      },
+      tskv::PersistentStorageManager::Options{
+          .levels = {{
+              .bucket_interval = 10,
+              .level_duration = 1000,
+              .store_raw = true,
+          }},
+          .storage = std::make_shared<MemoryStorage>(),
+      },
+  };
+}
+
+}  // namespace
+
+TEST(Storage, WriteBatch) {
+  tskv::Storage storage;
+  auto first = storage.InitMetric(MakeOptions());
+  auto second = storage.InitMetric(MakeOptions());
+
+  tskv::InputBatch batch;
+  for (tskv::TimePoint timestamp = 0; timestamp < 100; timestamp += 5) {
+    batch.Add(first, timestamp, 1);
+    batch.Add(second, timestamp, 2);
+  }
+  storage.WriteBatch(batch);
+
+  auto sum = storage.Read(second, {0, 100}, tskv::AggregationType::kSum);
+  EXPECT_EQ(sum->GetValues(), std::vector<double>(10, 4));
+  auto raw = storage.Read(first, {0, 12}, tskv::AggregationType::kNone);
+  EXPECT_EQ(raw->GetValues(), std::vector<double>({1, 1, 1}));
+
+  batch.Clear();
+  batch.Add(2, 0, 1);
+  EXPECT_THROW(storage.WriteBatch(batch), std::runtime_error);
+}
+
+TEST(Storage, ShardedWriteBatch) {
+  tskv::Storage storage(3);
+  std::vector<tskv::MetricId> ids;
+  for (size_t i = 0; i < 5; ++i) {
+    ids.push_back(storage.InitMetric(MakeOptions()));
+  }
+
+  // records of different metrics and shards are interleaved, every metric
+  // gets its records in order
+  tskv::InputBatch batch;
+  for (tskv::TimePoint timestamp = 0; timestamp < 3; ++timestamp) {
+    for (auto it = ids.rbegin(); it != ids.rend(); ++it) {
+      batch.Add(*it, timestamp, *it * 10 + timestamp);
+    }
+  }
+  storage.WriteBatch(batch);
+  for (auto id : ids) {
+    auto raw = storage.Read(id, {0, 3}, tskv::AggregationType::kNone);
+    EXPECT_EQ(raw->GetValues(),
+              std::vector<double>({id * 10.0, id * 10.0 + 1, id * 10.0 + 2}));
+  }
+}
+
+TEST(Storage, LateRecordsWaitForFlush) {
+  auto storage_backend = std::make_shared<MemoryStorage>();
+  auto options = MakeOptions();
+  options.persistent_storage_manager_options.storage = storage_backend;
+  tskv::Storage storage;
+  auto metric_id = storage.InitMetric(options);
+  for (tskv::TimePoint timestamp = 100; timestamp < 110; ++timestamp) {
+    storage.Write(metric_id, {{timestamp, 1}});
+  }
+  storage.Flush();
+
+  // late records are readable before the flush, which stores them in a page
+  // per column
+  auto pages_num = storage_backend->CreatedPagesNum();
+  for (tskv::TimePoint timestamp = 0; timestamp < 50; ++timestamp) {
+    storage.Write(metric_id, {{timestamp, 1}});
+  }
+  EXPECT_EQ(storage_backend->CreatedPagesNum(), pages_num);
+  auto count =
+      storage.Read(metric_id, {0, 110}, tskv::AggregationType::kCount);
+  auto values = count->GetValues();
+  EXPECT_EQ(std::accumulate(values.begin(), values.end(), 0.0), 60);
+  storage.Flush();
+  EXPECT_EQ(storage_backend->CreatedPagesNum(), pages_num + 4);
+  count = storage.Read(metric_id, {0, 110}, tskv::AggregationType::kCount);
+  values = count->GetValues();
+  EXPECT_EQ(std::accumulate(values.begin(), values.end(), 0.0), 60);
+}
+
+TEST(Storage, ConcurrentWrites) {
+  constexpr size_t kThreads = 4;
+  constexpr size_t kMetricsPerThread = 8;
+  constexpr tskv::TimePoint kRecords = 500;
+  tskv::Storage storage(3);
+  std::vector<tskv::MetricId> metric_ids;
+  for (size_t i = 0; i < kThreads * kMetricsPerThread; ++i) {
+    metric_ids.push_back(storage.InitMetric(MakeOptions()));
+  }
+
+  std::vector<std::thread> threads;
+  for (size_t thread_idx = 0; thread_idx < kThreads; ++thread_idx) {
+    threads.emplace_back([&, thread_idx] {
+      for (tskv::TimePoint timestamp = 0; timestamp < kRecords; ++timestamp) {
+        tskv::InputBatch batch;
+        for (size_t i = 0; i < kMetricsPerThread; ++i) {
+          batch.Add(metric_ids[thread_idx * kMetricsPerThread + i], timestamp,
+                    1);
+        }
+        storage.WriteBatch(batch);
+        // reads of other metrics of the same shards go in parallel
+        storage.Read(metric_ids[(thread_idx + 1) % metric_ids.size()],
+                     {0, kRecords}, tskv::AggregationType::kCount);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  for (auto metric_id : metric_ids) {
+    auto count =
+        storage.Read(metric_id, {0, kRecords}, tskv::AggregationType::kCount);
+    ASSERT_TRUE(count);
+    auto values = count->GetValues();
+    EXPECT_EQ(std::accumulate(values.begin(), values.end(), 0.0), kRecords);
+  }
+}
+
+TEST(Storage, BackgroundFlush) {
+  constexpr tskv::TimePoint kRecords = 1000;
+  auto executor = std::make_shared<tskv::BackgroundExecutor>(2);
+  auto options = MakeOptions();
+  options.flush_executor = executor;
+  options.memtable_options.max_lateness = 20;
+  tskv::Storage storage;
+  auto metric_id = storage.InitMetric(options);
+
+  for (tskv::TimePoint timestamp = 0; timestamp < kRecords; ++timestamp) {
+    // every tenth record is behind the lateness window
+    auto record_time = timestamp % 10 == 0 && timestamp >= 100
+                           ? timestamp - 100
+                           : timestamp;
+    storage.Write(metric_id, {{record_time, 1}});
+    auto count = storage.Read(metric_id, {0, kRecords},
+                              tskv::AggregationType::kCount);
+    ASSERT_TRUE(count);
+    auto values = count->GetValues();
+    // each record is read exactly once, wherever it is
+    ASSERT_EQ(std::accumulate(values.begin(), values.end(), 0.0),
+              timestamp + 1);
+  }
+  executor->Wait();
+  auto raw = storage.Read(metric_id, {0, 20}, tskv::AggregationType::kNone);
+  EXPECT_EQ(raw->GetValues().size(), 22);
+}
+
+TEST(Storage, ReadsDuringFlush) {
+  auto executor = std::make_shared<tskv::BackgroundExecutor>(1);
+  auto storage_backend = std::make_shared<BlockingStorage>();
+  auto options = MakeOptions();
+  options.flush_executor = executor;
+  options.persistent_storage_manager_options.storage = storage_backend;
+  tskv::Storage storage;
+  auto metric_id = storage.InitMetric(options);
+  tskv::TimePoint timestamp = 0;
+  while (!storage_backend->WaitWriting(std::chrono::milliseconds(1))) {
+    storage.Write(metric_id, {{timestamp++, 1}});
+  }
+
+  // pages of the frozen memtable are being stored, reads don't wait for them
+  auto read = std::async(std::launch::async, [&] {
+    return storage.Read(metric_id, {0, timestamp},
+                        tskv::AggregationType::kCount);
+  });
+  EXPECT_EQ(read.wait_for(std::chrono::seconds(10)),
+            std::future_status::ready);
+  storage_backend->Release();
+  auto values = read.get()->GetValues();
+  EXPECT_EQ(std::accumulate(values.begin(), values.end(), 0.0), timestamp);
+  executor->Wait();
+}
+
+TEST(Storage, BackgroundFlushError) {
+  auto executor = std::make_shared<tskv::BackgroundExecutor>(1);
+  auto storage_backend = std::make_shared<FailingStorage>();
+  storage_backend->fail = true;
+  auto options = MakeOptions();
+  options.flush_executor = executor;
+  options.persistent_storage_manager_options.storage = storage_backend;
+  tskv::Storage storage;
+  auto metric_id = storage.InitMetric(options);
+  tskv::TimePoint timestamp = 0;
+  while (storage_backend->CreatedPagesNum() == 0) {
+    storage.Write(metric_id, {{timestamp++, 1}});
+    executor->Wait();
+  }
+
+  // the memtable doesn't need a flush, but the write still sees the error
+  EXPECT_THROW(storage.Write(metric_id, {{timestamp, 1}}),
+               std::runtime_error);
+  storage_backend->fail = false;
+  storage.Flush();
+  storage.Write(metric_id, {{timestamp++, 1}});
+  auto count =
+      storage.Read(metric_id, {0, timestamp}, tskv::AggregationType::kCount);
+  auto values = count->GetValues();
+  EXPECT_EQ(std::accumulate(values.begin(), values.end(), 0.0), timestamp);
+}
+
+TEST(Storage, BackgroundCompaction) {
+  constexpr tskv::TimePoint kRecords = 2000;
+  auto scheduler = std::make_shared<tskv::CompactionScheduler>(
+      tskv::CompactionScheduler::Options{.threads_num = 2});
+  auto storage_backend = std::make_shared<MemoryStorage>();
+  auto options = MakeOptions();
+  options.persistent_storage_manager_options = {
+      .levels = {{
+                     .bucket_interval = 10,
+                     .level_duration = 100,
+                     .store_raw = true,
+                 },
+                 {
+                     .bucket_interval = 50,
+                     .level_duration = 400,
+                 },
+                 {
+                     .bucket_interval = 100,
+                     .level_duration = 100000,
+                 }},
+      .storage = storage_backend,
+      .compaction_scheduler = scheduler,
+      .page_cache = std::make_shared<tskv::PageCache>(
+          tskv::PageCache::Options{.max_bytes_size = 10000}),
+  };
+  tskv::Storage storage;
+  auto metric_id = storage.InitMetric(options);
+
+  for (tskv::TimePoint timestamp = 0; timestamp < kRecords; ++timestamp) {
+    storage.Write(metric_id, {{timestamp, 1}});
+    // pages are moved between levels meanwhile
+    auto count = storage.Read(metric_id, {0, kRecords},
+                              tskv::AggregationType::kCount);
+    ASSERT_TRUE(count);
+    auto values = count->GetValues();
+    ASSERT_EQ(std::accumulate(values.begin(), values.end(), 0.0),
+              timestamp + 1);
+  }
+  scheduler->Wait();
+
+  auto sum =
+      storage.Read(metric_id, {0, kRecords}, tskv::AggregationType::kSum);
+  auto values = sum->GetValues();
+  EXPECT_EQ(std::accumulate(values.begin(), values.end(), 0.0), kRecords);
+  // old records were moved to the levels without raw values
+  auto raw = storage.Read(metric_id, {0, 1000}, tskv::AggregationType::kNone);
+  EXPECT_TRUE(!raw || raw->GetValues().empty());
+  // pages of moved levels are deleted, only segments of the last moves
+  // remain
+  EXPECT_LT(storage_backend->PagesNum() * 4,
+            storage_backend->CreatedPagesNum());
+}
+
+TEST(Storage, WalReplay) {
+  auto path = std::filesystem::temp_directory_path() / "tskv_storage_wal_test";
+  std::filesystem::remove_all(path);
+  tskv::WriteAheadLog::Options wal_options{
+      .path = path,
+      // every batch starts a new file
+      .max_file_size = 1,
+  };
+  {
+    auto wal = std::make_shared<tskv::WriteAheadLog>(wal_options);
+    tskv::Storage storage(2, wal);
+    auto first = storage.InitMetric(MakeOptions());
+    auto second = storage.InitMetric(MakeOptions());
+    for (tskv::TimePoint timestamp = 0; timestamp < 20; ++timestamp) {
+      storage.Write(first, {{timestamp, 1}});
+      tskv::InputBatch batch;
+      batch.Add(second, timestamp, 2);
+      storage.WriteBatch(batch);
+    }
+    // nothing is flushed, so the whole log is kept
+    auto count = storage.Read(second, {0, 20}, tskv::AggregationType::kCount);
+    EXPECT_EQ(count->GetValues(), std::vector<double>({10, 10}));
+  }
+
+  auto wal = std::make_shared<tskv::WriteAheadLog>(wal_options);
+  EXPECT_GT(wal->FilesNum(), 40);
+  tskv::Storage storage(2, wal);
+  auto first = storage.InitMetric(MakeOptions());
+  auto second = storage.InitMetric(MakeOptions());
+  storage.ReplayWal();
+  auto sum = storage.Read(first, {0, 20}, tskv::AggregationType::kSum);
+  EXPECT_EQ(sum->GetValues(), std::vector<double>({10, 10}));
+  sum = storage.Read(second, {0, 20}, tskv::AggregationType::kSum);
+  EXPECT_EQ(sum->GetValues(), std::vector<double>({20, 20}));
+
+  // flushed writes are not needed anymore
+  storage.Flush();
+  EXPECT_EQ(wal->FilesNum(), 1);
+  std::filesystem::remove_all(path);
+}
+
+TEST(Storage, SyncBeforeWalTruncation) {
+  auto path =
+      std::filesystem::temp_directory_path() / "tskv_storage_wal_sync_test";
+  std::filesystem::remove_all(path);
+  auto wal = std::make_shared<tskv::WriteAheadLog>(
+      tskv::WriteAheadLog::Options{.path = path, .max_file_size = 1});
+  auto storage_backend = std::make_shared<SyncingStorage>(wal);
+  auto options = MakeOptions();
+  options.persistent_storage_manager_options.storage = storage_backend;
+  tskv::Storage storage(2, wal);
+  auto first = storage.InitMetric(options);
+  auto second = storage.InitMetric(options);
+  for (tskv::TimePoint timestamp = 0; timestamp < 20; ++timestamp) {
+    storage.Write(first, {{timestamp, 1}});
+    storage.Write(second, {{timestamp, 2}});
+  }
+
+  // the shared storage is synced once, before the flushed files are deleted
+  auto files_num = wal->FilesNum();
+  EXPECT_GT(files_num, 1);
+  auto syncs_num = storage_backend->SyncedFilesNums().size();
+  storage.Flush();
+  auto synced_files_nums = storage_backend->SyncedFilesNums();
+  ASSERT_EQ(synced_files_nums.size(), syncs_num + 1);
+  EXPECT_EQ(synced_files_nums.back(), files_num);
+  EXPECT_EQ(wal->FilesNum(), 1);
+  std::filesystem::remove_all(path);
+}
@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "model/column.h"
+#include "model/timestamp_runs.h"
+
+TEST(TimestampRuns, Regular) {
+  tskv::TimestampRuns timestamps;
+  for (uint64_t i = 0; i < 1000; ++i) {
+    timestamps.PushBack(100 + i * 10);
+  }
+  EXPECT_TRUE(timestamps.IsRegular());
+  EXPECT_EQ(timestamps.GetRuns().size(), 1);
+  EXPECT_EQ(timestamps.Size(), 1000);
+  EXPECT_EQ(timestamps.Front(), 100);
+  EXPECT_EQ(timestamps.Back(), 10090);
+  EXPECT_EQ(timestamps[15], 250);
+
+  EXPECT_EQ(timestamps.LowerBound(0), 0);
+  EXPECT_EQ(timestamps.LowerBound(100), 0);
+  EXPECT_EQ(timestamps.LowerBound(101), 1);
+  EXPECT_EQ(timestamps.LowerBound(110), 1);
+  EXPECT_EQ(timestamps.LowerBound(10090), 999);
+  EXPECT_EQ(timestamps.LowerBound(10091), 1000);
+  EXPECT_EQ(timestamps.UpperBound(99), 0);
+  EXPECT_EQ(timestamps.UpperBound(100), 1);
+  EXPECT_EQ(timestamps.UpperBound(109), 1);
+  EXPECT_EQ(timestamps.UpperBound(10090), 1000);
+
+  auto slice = timestamps.Slice(10, 20);
+  EXPECT_EQ(slice.Size(), 10);
+  EXPECT_EQ(slice.Front(), 200);
+  EXPECT_EQ(slice.Back(), 290);
+  EXPECT_EQ(slice.GetRuns().size(), 1);
+}
+
+TEST(TimestampRuns, Duplicates) {
+  std::vector<uint64_t> expected = {1, 2, 2, 3, 3, 4, 4, 4, 5, 6, 6};
+  tskv::TimestampRuns timestamps(expected);
+  EXPECT_TRUE(timestamps.IsRegular());
+  EXPECT_EQ(timestamps.Materialize(), expected);
+  for (uint64_t ts = 0; ts < 8; ++ts) {
+    EXPECT_EQ(timestamps.LowerBound(ts),
+              std::ranges::lower_bound(expected, ts) - expected.begin());
+    EXPECT_EQ(timestamps.UpperBound(ts),
+              std::ranges::upper_bound(expected, ts) - expected.begin());
+  }
+}
+
+TEST(TimestampRuns, Irregular) {
+  std::mt19937_64 gen(42);
+  std::uniform_int_distribution<uint64_t> dis(0, 1000);
+  std::vector<uint64_t> expected;
+  tskv::TimestampRuns timestamps;
+  uint64_t last = 0;
+  for (int i = 0; i < 500; ++i) {
+    last += dis(gen);
+    expected.push_back(last);
+    timestamps.PushBack(last);
+  }
+  EXPECT_FALSE(timestamps.IsRegular());
+  EXPECT_EQ(timestamps.Materialize(), expected);
+  EXPECT_EQ(timestamps.GetBytesSize(), expected.size() * sizeof(uint64_t));
+  EXPECT_EQ(timestamps.LowerBound(expected[100]), 100);
+  EXPECT_EQ(timestamps.Slice(3, 5).Materialize(),
+            std::vector<uint64_t>(expected.begin() + 3, expected.begin() + 5));
+}
+
+TEST(TimestampRuns, Mixed) {
+  std::vector<uint64_t> expected;
+  for (uint64_t i = 0; i < 100; ++i) {
+    expected.push_back(i * 10);
+  }
+  expected.push_back(995);
+  for (uint64_t i = 0; i < 100; ++i) {
+    expected.push_back(1000 + i * 7);
+  }
+  tskv::TimestampRuns first(
+      std::vector<uint64_t>(expected.begin(), expected.begin() + 50));
+  tskv::TimestampRuns second(
+      std::vector<uint64_t>(expected.begin() + 50, expected.end()));
+  first.Append(second);
+  EXPECT_TRUE(first.IsRegular());
+  EXPECT_LE(first.GetRuns().size(), 3);
+  EXPECT_EQ(first.Materialize(), expected);
+  for (uint64_t ts = 0; ts < 2000; ts += 3) {
+    EXPECT_EQ(first.LowerBound(ts),
+              std::ranges::lower_bound(expected, ts) - expected.begin());
+    EXPECT_EQ(first.UpperBound(ts),
+              std::ranges::upper_bound(expected, ts) - expected.begin());
+  }
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(first[i], expected[i]);
+  }
+  EXPECT_EQ(first.Slice(95, 110).Materialize(),
+            std::vector<uint64_t>(expected.begin() + 95,
+                                  expected.begin() + 110));
+}
+
+TEST(TimestampRuns, ToBytes) {
+  std::vector<uint64_t> expected;
+  for (uint64_t i = 0; i < 86400; ++i) {
+    expected.push_back(1'000'000 * i);
+  }
+  tskv::RawTimestampsColumn column(expected);
+  EXPECT_LT(column.GetBytesSize(), 100);
+  auto bytes = column.ToBytes(tskv::RawTimestampsEncoding::kRuns);
+  EXPECT_LT(bytes.size(), 100);
+  auto result = std::static_pointer_cast<tskv::RawTimestampsColumn>(
+      tskv::FromBytes(bytes, tskv::ColumnType::kRawTimestamps));
+  EXPECT_EQ(result->TimestampsNum(), expected.size());
+  EXPECT_EQ(result->GetTimeRange(),
+            tskv::TimeRange(0, expected.back() + 1));
+  EXPECT_LT(result->GetBytesSize(), 100);
+
+  std::vector<uint64_t> decoded;
+  tskv::DecodeRawTimestamps(bytes, decoded);
+  EXPECT_EQ(decoded, expected);
+}
+
+TEST(TimestampRuns, ToBytesIrregular) {
+  std::vector<uint64_t> expected;
+  uint64_t last = 0;
+  for (uint64_t i = 0; i < 1000; ++i) {
+    last += i % 13;
+    expected.push_back(last);
+  }
+  auto bytes =
+      tskv::EncodeRawTimestamps(expected, tskv::RawTimestampsEncoding::kRuns);
+  EXPECT_FALSE(tskv::IsTimestampRunsPage(bytes));
+  std::vector<uint64_t> decoded;
+  tskv::DecodeRawTimestamps(bytes, decoded);
+  EXPECT_EQ(decoded, expected);
+}
@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "storage/storage.h"
+#include "wal/write_ahead_log.h"
+
+namespace {
+
+std::string MakeTempDir(const std::string& name) {
+  auto path = std::filesystem::temp_directory_path() / name;
+  std::filesystem::remove_all(path);
+  return path;
+}
+
+tskv::InputBatch MakeBatch(tskv::TimePoint timestamp) {
+  tskv::InputBatch batch;
+  batch.Add(0, timestamp, 1);
+  batch.Add(1, timestamp, 2);
+  return batch;
+}
+
+std::vector<uint64_t> ReplayLsns(const tskv::WriteAheadLog& wal) {
+  std::vector<uint64_t> lsns;
+  wal.Replay([&lsns](uint64_t lsn, const tskv::InputBatch& batch) {
+    EXPECT_EQ(batch.timestamps, std::vector<tskv::TimePoint>(2, lsn * 10));
+    EXPECT_EQ(batch.values, std::vector<tskv::Value>({1, 2}));
+    lsns.push_back(lsn);
+  });
+  return lsns;
+}
+
+}  // namespace
+
+TEST(WriteAheadLog, AppendReplay) {
+  auto path = MakeTempDir("tskv_wal_test");
+  {
+    tskv::WriteAheadLog wal({.path = path});
+    for (uint64_t i = 0; i < 5; ++i) {
+      EXPECT_EQ(wal.Append(MakeBatch(i * 10)), i);
+    }
+    EXPECT_EQ(ReplayLsns(wal), std::vector<uint64_t>({0, 1, 2, 3, 4}));
+  }
+
+  // appends after the restart go to a new file and continue lsns
+  tskv::WriteAheadLog wal({.path = path});
+  EXPECT_EQ(wal.GetNextLsn(), 5);
+  EXPECT_EQ(wal.FilesNum(), 2);
+  EXPECT_EQ(wal.Append(MakeBatch(50)), 5);
+  EXPECT_EQ(ReplayLsns(wal), std::vector<uint64_t>({0, 1, 2, 3, 4, 5}));
+  std::filesystem::remove_all(path);
+}
+
+TEST(WriteAheadLog, TornRecord) {
+  auto path = MakeTempDir("tskv_wal_torn_test");
+  {
+    tskv::WriteAheadLog wal({.path = path});
+    wal.Append(MakeBatch(0));
+    wal.Append(MakeBatch(10));
+  }
+  // the crash cut the last record
+  auto file_path = std::filesystem::path(path) / "0.wal";
+  std::filesystem::resize_file(file_path,
+                               std::filesystem::file_size(file_path) - 1);
+
+  tskv::WriteAheadLog wal({.path = path});
+  EXPECT_EQ(ReplayLsns(wal), std::vector<uint64_t>({0}));
+  EXPECT_EQ(wal.Append(MakeBatch(10)), 1);
+  EXPECT_EQ(ReplayLsns(wal), std::vector<uint64_t>({0, 1}));
+  std::filesystem::remove_all(path);
+}
+
+TEST(WriteAheadLog, Truncate) {
+  auto path = MakeTempDir("tskv_wal_truncate_test");
+  tskv::WriteAheadLog wal({.path = path, .max_file_size = 1});
+  for (uint64_t i = 0; i < 5; ++i) {
+    wal.Append(MakeBatch(i * 10));
+  }
+  EXPECT_EQ(wal.FilesNum(), 5);
+  wal.Truncate(3);
+  EXPECT_EQ(ReplayLsns(wal), std::vector<uint64_t>({3, 4}));
+  // the active file is kept
+  wal.Truncate(10);
+  EXPECT_EQ(wal.FilesNum(), 1);
+  EXPECT_EQ(ReplayLsns(wal), std::vector<uint64_t>({4}));
+  std::filesystem::remove_all(path);
+}
+
+TEST(WriteAheadLog, GroupCommit) {
+  constexpr size_t kThreads = 8;
+  constexpr size_t kAppendsPerThread = 50;
+  auto path = MakeTempDir("tskv_wal_group_commit_test");
+  // every append is synced, syncs by bytes and by time, and syncs of full
+  // files
+  std::vector<tskv::WriteAheadLog::Options> options_list{
+      {.path = path},
+      {
+          .path = path,
+          .sync_interval = std::chrono::milliseconds(1),
+          .sync_bytes_size = 1000,
+      },
+      {.path = path, .max_file_size = 500},
+  };
+  for (const auto& options : options_list) {
+    std::filesystem::remove_all(path);
+    {
+      tskv::WriteAheadLog wal(options);
+      std::vector<std::thread> threads;
+      for (size_t i = 0; i < kThreads; ++i) {
+        threads.emplace_back([&wal] {
+          for (size_t j = 0; j < kAppendsPerThread; ++j) {
+            wal.Append(MakeBatch(0));
+          }
+        });
+      }
+      for (auto& thread : threads) {
+        thread.join();
+      }
+      wal.Sync();
+    }
+
+    tskv::WriteAheadLog wal({.path = path});
+    uint64_t next_lsn = 0;
+    wal.Replay([&next_lsn](uint64_t lsn, const tskv::InputBatch& batch) {
+      EXPECT_EQ(lsn, next_lsn++);
+      EXPECT_EQ(batch.values, std::vector<tskv::Value>({1, 2}));
+    });
+    EXPECT_EQ(next_lsn, kThreads * kAppendsPerThread);
+  }
+  std::filesystem::remove_all(path);
+}
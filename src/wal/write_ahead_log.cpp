@@ -0,0 +1,293 @@
+#include "write_ahead_log.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+#include "model/column.h"
+#include "storage/storage.h"
+
+namespace tskv {
+
+namespace {
+
+constexpr const char* kFileExtension = ".wal";
+// [payload size][checksum][lsn], checksum covers lsn and payload
+constexpr size_t kHeaderSize =
+    sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint64_t);
+
+// FNV-1a, it only has to catch torn and partially synced records
+uint64_t GetChecksum(uint64_t lsn, BytesView payload) {
+  uint64_t hash = 14695981039346656037ULL;
+  auto add = [&hash](uint8_t byte) {
+    hash ^= byte;
+    hash *= 1099511628211ULL;
+  };
+  for (size_t i = 0; i < sizeof(lsn); ++i) {
+    add(static_cast<uint8_t>(lsn >> (8 * i)));
+  }
+  for (auto byte : payload) {
+    add(byte);
+  }
+  return hash;
+}
+
+// [records num][metric ids][timestamps][values]
+CompressedBytes EncodeBatch(const InputBatch& batch) {
+  CompressedBytes bytes;
+  bytes.reserve(sizeof(uint64_t) +
+                batch.Size() *
+                    (sizeof(MetricId) + sizeof(TimePoint) + sizeof(Value)));
+  Append(bytes, static_cast<uint64_t>(batch.Size()));
+  Append(bytes, batch.metric_ids.data(), batch.Size());
+  Append(bytes, batch.timestamps.data(), batch.Size());
+  Append(bytes, batch.values.data(), batch.Size());
+  return bytes;
+}
+
+bool DecodeBatch(BytesView bytes, InputBatch& batch) {
+  if (bytes.size() < sizeof(uint64_t)) {
+    return false;
+  }
+  CompressedBytesReader reader(bytes);
+  auto size = reader.Read<uint64_t>();
+  if (reader.Remaining() !=
+      size * (sizeof(MetricId) + sizeof(TimePoint) + sizeof(Value))) {
+    return false;
+  }
+  batch.metric_ids = reader.Read<MetricId>(size);
+  batch.timestamps = reader.Read<TimePoint>(size);
+  batch.values = reader.Read<Value>(size);
+  return true;
+}
+
+CompressedBytes MakeRecord(uint64_t lsn, const CompressedBytes& payload) {
+  CompressedBytes record;
+  record.reserve(kHeaderSize + payload.size());
+  Append(record, static_cast<uint32_t>(payload.size()));
+  Append(record, GetChecksum(lsn, payload));
+  Append(record, lsn);
+  record.insert(record.end(), payload.begin(), payload.end());
+  return record;
+}
+
+void WriteFully(int fd, const CompressedBytes& bytes) {
+  size_t written = 0;
+  while (written < bytes.size()) {
+    auto res = write(fd, bytes.data() + written, bytes.size() - written);
+    if (res <= 0) {
+      throw std::runtime_error("failed to write log");
+    }
+    written += res;
+  }
+}
+
+}  // namespace
+
+WriteAheadLog::WriteAheadLog(const Options& options)
+    : path_(options.path),
+      max_file_size_(options.max_file_size),
+      sync_interval_(options.sync_interval),
+      sync_bytes_size_(options.sync_bytes_size) {
+  if (!std::filesystem::exists(path_)) {
+    std::filesystem::create_directories(path_);
+  }
+  for (const auto& entry : std::filesystem::directory_iterator(path_)) {
+    if (entry.path().extension() == kFileExtension) {
+      files_.push_back(std::stoull(entry.path().stem().string()));
+    }
+  }
+  std::ranges::sort(files_);
+  if (!files_.empty()) {
+    next_lsn_ = ReadFile(files_.back(), nullptr);
+  }
+  synced_lsn_ = next_lsn_;
+  // appends never go after a torn record, they start a new file
+  OpenFile();
+  if (sync_interval_.count() != 0) {
+    sync_thread_ = std::thread([this] { SyncPeriodically(); });
+  }
+}
+
+WriteAheadLog::~WriteAheadLog() {
+  {
+    std::lock_guard lock(mutex_);
+    stopped_ = true;
+  }
+  stop_.notify_all();
+  if (sync_thread_.joinable()) {
+    sync_thread_.join();
+  }
+  fdatasync(fd_);
+  close(fd_);
+}
+
+uint64_t WriteAheadLog::Append(const InputBatch& batch) {
+  auto payload = EncodeBatch(batch);
+  std::unique_lock lock(mutex_);
+  while (file_size_ >= max_file_size_) {
+    // batches of the full file are synced before it's closed, another append
+    // may start the new file meanwhile
+    SyncUntil(lock, next_lsn_);
+    sync_finished_.wait(lock, [this] { return !syncing_; });
+    if (file_size_ >= max_file_size_) {
+      close(fd_);
+      OpenFile();
+    }
+  }
+  auto lsn = next_lsn_++;
+  auto record = MakeRecord(lsn, payload);
+  try {
+    WriteFully(fd_, record);
+  } catch (...) {
+    // the file may end with a part of the record, so the next append starts
+    // a new one
+    file_size_ = max_file_size_;
+    throw;
+  }
+  file_size_ += record.size();
+  appended_bytes_size_ += record.size();
+
+  bool sync_every_append =
+      sync_interval_.count() == 0 && sync_bytes_size_ == 0;
+  if (sync_every_append ||
+      (sync_bytes_size_ != 0 &&
+       appended_bytes_size_ - synced_bytes_size_ >= sync_bytes_size_)) {
+    SyncUntil(lock, lsn + 1);
+  }
+  return lsn;
+}
+
+void WriteAheadLog::Replay(const ReplayCallback& callback) const {
+  std::vector<uint64_t> files;
+  {
+    std::lock_guard lock(mutex_);
+    files = files_;
+  }
+  for (auto first_lsn : files) {
+    ReadFile(first_lsn, callback);
+  }
+}
+
+void WriteAheadLog::Truncate(uint64_t lsn) {
+  std::lock_guard lock(mutex_);
+  size_t removed_num = 0;
+  // batches of a file are older than the first batch of the next one
+  while (removed_num + 1 < files_.size() && files_[removed_num + 1] <= lsn) {
+    std::filesystem::remove(GetFilePath(files_[removed_num]));
+    ++removed_num;
+  }
+  files_.erase(files_.begin(), files_.begin() + removed_num);
+}
+
+void WriteAheadLog::Sync() {
+  std::unique_lock lock(mutex_);
+  SyncUntil(lock, next_lsn_);
+}
+
+uint64_t WriteAheadLog::GetNextLsn() const {
+  std::lock_guard lock(mutex_);
+  return next_lsn_;
+}
+
+size_t WriteAheadLog::FilesNum() const {
+  std::lock_guard lock(mutex_);
+  return files_.size();
+}
+
+std::filesystem::path WriteAheadLog::GetFilePath(uint64_t first_lsn) const {
+  return path_ / (std::to_string(first_lsn) + kFileExtension);
+}
+
+uint64_t WriteAheadLog::ReadFile(uint64_t first_lsn,
+                                 const ReplayCallback& callback) const {
+  auto path = GetFilePath(first_lsn);
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    throw std::runtime_error("failed to open log");
+  }
+  CompressedBytes bytes(std::filesystem::file_size(path));
+  in.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+
+  CompressedBytesReader reader(bytes);
+  auto next_lsn = first_lsn;
+  InputBatch batch;
+  while (reader.Remaining() >= kHeaderSize) {
+    auto payload_size = reader.Read<uint32_t>();
+    auto checksum = reader.Read<uint64_t>();
+    auto lsn = reader.Read<uint64_t>();
+    if (reader.Remaining() < payload_size) {
+      break;
+    }
+    auto payload = reader.ReadBytes(payload_size);
+    if (lsn != next_lsn || GetChecksum(lsn, payload) != checksum ||
+        !DecodeBatch(payload, batch)) {
+      break;
+    }
+    if (callback) {
+      callback(lsn, batch);
+    }
+    ++next_lsn;
+  }
+  return next_lsn;
+}
+
+void WriteAheadLog::OpenFile() {
+  // a file named by the next lsn has no valid batches
+  fd_ = open(GetFilePath(next_lsn_).c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+             0644);
+  if (fd_ == -1) {
+    throw std::runtime_error("failed to open log");
+  }
+  if (files_.empty() || files_.back() != next_lsn_) {
+    files_.push_back(next_lsn_);
+  }
+  file_size_ = 0;
+  // the new file must be found after a crash
+  int dir_fd = open(path_.c_str(), O_RDONLY | O_DIRECTORY);
+  if (dir_fd != -1) {
+    fsync(dir_fd);
+    close(dir_fd);
+  }
+}
+
+void WriteAheadLog::SyncUntil(std::unique_lock<std::mutex>& lock,
+                              uint64_t lsn) {
+  while (synced_lsn_ < lsn) {
+    if (syncing_) {
+      sync_finished_.wait(lock);
+      continue;
+    }
+    syncing_ = true;
+    auto target_lsn = next_lsn_;
+    auto target_bytes_size = appended_bytes_size_;
+    int fd = fd_;
+    lock.unlock();
+    int res = fdatasync(fd);
+    lock.lock();
+    syncing_ = false;
+    sync_finished_.notify_all();
+    // waiting appends retry the failed sync
+    if (res == -1) {
+      throw std::runtime_error("failed to sync log");
+    }
+    synced_lsn_ = target_lsn;
+    synced_bytes_size_ = target_bytes_size;
+  }
+}
+
+void WriteAheadLog::SyncPeriodically() {
+  std::unique_lock lock(mutex_);
+  while (!stop_.wait_for(lock, sync_interval_, [this] { return stopped_; })) {
+    try {
+      SyncUntil(lock, next_lsn_);
+    } catch (const std::runtime_error&) {
+      // a failed sync is retried on the next tick
+    }
+  }
+}
+
+}  // namespace tskv
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace tskv {
+
+struct InputBatch;
+
+// Log of write batches, so that records of memtables survive a crash. Every
+// batch gets a sequence number (lsn). Batches are appended to files which
+// are named by the lsn of their first batch, a new file is started when the
+// active one is full, and files are deleted once all their batches are
+// flushed. Syncs are shared by appends (group commit): a sync runs without
+// the lock and covers every batch written before it starts, appends which
+// need their batch synced wait for such a sync instead of starting their
+// own, see Options.
+class WriteAheadLog {
+ public:
+  struct Options {
+    std::string path;
+    // a new file is started when the active one reaches this size
+    size_t max_file_size{64 * 1024 * 1024};
+    // if set, a background thread syncs appended batches this often
+    std::chrono::milliseconds sync_interval{0};
+    // if set, the append after which this many bytes are not synced syncs
+    // them. If neither is set, every append is synced before it returns
+    size_t sync_bytes_size{0};
+  };
+
+  using ReplayCallback =
+      std::function<void(uint64_t lsn, const InputBatch& batch)>;
+
+ public:
+  explicit WriteAheadLog(const Options& options);
+  // syncs the log
+  ~WriteAheadLog();
+
+  WriteAheadLog(const WriteAheadLog&) = delete;
+  WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+  // returns lsn of the batch
+  uint64_t Append(const InputBatch& batch);
+  // calls callback for every batch of the log in lsn order. Batches after a
+  // torn or corrupted record of a file are skipped
+  void Replay(const ReplayCallback& callback) const;
+  // deletes files which have only batches older than lsn, the active file
+  // is kept
+  void Truncate(uint64_t lsn);
+  void Sync();
+
+  // lsn of the next appended batch
+  uint64_t GetNextLsn() const;
+  size_t FilesNum() const;
+
+ private:
+  std::filesystem::path GetFilePath(uint64_t first_lsn) const;
+  // lsn after the last valid batch of the file
+  uint64_t ReadFile(uint64_t first_lsn, const ReplayCallback& callback) const;
+  void OpenFile();
+  // returns once batches before lsn are synced, syncing them if no sync is
+  // in progress. The lock is released during the sync
+  void SyncUntil(std::unique_lock<std::mutex>& lock, uint64_t lsn);
+  void SyncPeriodically();
+
+ private:
+  std::filesystem::path path_;
+  size_t max_file_size_;
+  std::chrono::milliseconds sync_interval_;
+  size_t sync_bytes_size_;
+
+  // guards all members below
+  mutable std::mutex mutex_;
+  // first lsns of files in order, the last one is active
+  std::vector<uint64_t> files_;
+  int fd_{-1};
+  size_t file_size_{0};
+  uint64_t next_lsn_{0};
+  // batches before it are synced
+  uint64_t synced_lsn_{0};
+  // bytes appended since the log was opened, and the synced part of them
+  size_t appended_bytes_size_{0};
+  size_t synced_bytes_size_{0};
+  // the active file isn't closed while it's synced
+  bool syncing_{false};
+  std::condition_variable sync_finished_;
+  bool stopped_{false};
+  std::condition_variable stop_;
+  std::thread sync_thread_;
+};
+
+}  // namespace tskv